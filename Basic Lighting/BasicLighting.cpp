@@ -1,10 +1,8 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
+#include "../Common/benchmark.hpp"
+#include "../Common/cube_mesh.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -14,6 +12,8 @@
 
 #include "DiligentTools/TextureLoader/interface/TextureUtilities.h"
 
+#include "../Common/ring_buffer.hpp"
+
 #include "glm/glm.hpp"
 #include <glm/gtc/type_ptr.hpp>
 
@@ -65,10 +65,7 @@ class application {
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        if (app->m_pSwapChain)
-        {
-            app->m_pSwapChain->Resize(width, height);
-        }
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -116,8 +113,8 @@ class application {
     }
 
     void initialize_glfw() {
-        constexpr auto width = 800;
-        constexpr auto height = 600;
+        const auto width = static_cast<int> (m_Options.width);
+        const auto height = static_cast<int> (m_Options.height);
 
         if (auto res = glfwInit(); res == GLFW_FALSE) {
             throw std::runtime_error("GLFW failed to initialize.");
@@ -145,27 +142,37 @@ class application {
 
         EngineVkCreateInfo engine_ci;
 
+        if (m_Benchmark.enabled()) {
+            engine_ci.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+        }
+
         auto vk_factory = Diligent::GetEngineFactoryVk();
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
 
-        auto handle = glfwGetWin32Window(window);
-
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
+        SwapChainDesc SCDesc;
+        SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
+        SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-            SwapChainDesc SCDesc;
-            SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
-            SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
         }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
+        }
+
+        m_PipelineCache.create(m_pDevice, "BasicLighting");
+        m_Benchmark.create(m_pDevice);
 
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
@@ -183,8 +190,8 @@ class application {
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
-        auto pDSV = m_pSwapChain->GetDepthBufferDSV();
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
+        auto pDSV = m_RenderTarget.depth_buffer_dsv();
         m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
         const glm::vec4 ClearColor = { 0.1f, 0.1f, 0.1f, 1.0f };
         m_pImmediateContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
@@ -193,60 +200,61 @@ class application {
         {
             m_pImmediateContext->SetPipelineState(m_pCubePSO);
 
-            Diligent::Uint64 offset = 0;
-            std::array pBuffs = { m_CubeVertexBuffer.RawPtr() };
-            m_pImmediateContext->SetVertexBuffers(0, pBuffs.size(), pBuffs.data(), &offset, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION, Diligent::SET_VERTEX_BUFFERS_FLAG_RESET);
+            m_CubeMesh.bind(m_pImmediateContext);
 
             glm::mat4 light_model(1.0f);
-            light_model = glm::rotate(light_model, static_cast<float> (glfwGetTime()) * glm::radians(20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            light_model = glm::rotate(light_model, static_cast<float> (m_Loop.time()) * glm::radians(20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
             light_model = glm::translate(light_model, glm::vec3(1.2f, 0.7f, 2.0f));
             const glm::vec4 light_pos = (light_model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
-            {
-                Diligent::MapHelper<Colors> CBColors(m_pImmediateContext, m_FSColors, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
 
-                CBColors->object_color = glm::vec3(1.0f, 0.5f, 0.31f);
-                CBColors->light_color = glm::vec3(1.0f, 1.0f, 1.0f);
-                CBColors->light_position = glm::vec3(light_pos.x, light_pos.y, light_pos.z);
-            }
+            m_FrameRing.reset();
 
+            Diligent::Uint32 colors_offset;
             {
-                Diligent::MapHelper<Camera::CB> CBCamera(m_pImmediateContext, m_PSCamera, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-
-                *CBCamera = camera.create_buffer();
+                Colors colors;
+                colors.object_color = glm::vec3(1.0f, 0.5f, 0.31f);
+                colors.light_color = glm::vec3(1.0f, 1.0f, 1.0f);
+                colors.light_position = glm::vec3(light_pos.x, light_pos.y, light_pos.z);
+                colors_offset = m_FrameRing.push(colors);
             }
 
+            const auto camera_offset = m_FrameRing.push(camera.create_buffer());
+
             Constants c;
             {
-                const auto& SwapChainDesc = m_pSwapChain->GetDesc();
+                const auto& SwapChainDesc = m_RenderTarget.desc();
                 const float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
                 c.view = glm::transpose(glm::lookAt(camera.eye, camera.eye + camera.front, camera.up));
                 c.projection = glm::transpose(glm::perspective(glm::radians(static_cast<float> (camera.fov)), aspect, 0.1f, 100.0f));
                 c.model = glm::mat4(1.0f);
                 c.inverse_transpose_model = glm::transpose(glm::inverse(c.model));
-                Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-                *CBConstants = c;
             }
+            const auto cube_constants_offset = m_FrameRing.push(c);
 
-            Diligent::DrawAttribs DrawAttrs;
-            DrawAttrs.NumVertices = 36;
-            DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
+            c.model = glm::transpose(glm::scale(light_model, glm::vec3(0.2f)));
+            c.inverse_transpose_model = glm::transpose(glm::inverse(glm::transpose(c.model)));
+            const auto light_cube_constants_offset = m_FrameRing.push(c);
+
+            m_FrameRing.upload(m_pImmediateContext);
+
+            const auto DrawAttrs = cube_mesh::draw_attribs();
 
+            m_pCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_VERTEX, "Constants")->SetBufferOffset(cube_constants_offset);
+            m_pCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_PIXEL, "Colors")->SetBufferOffset(colors_offset);
+            m_pCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_PIXEL, "Camera")->SetBufferOffset(camera_offset);
             m_pImmediateContext->CommitShaderResources(m_pCubeSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-            m_pImmediateContext->Draw(DrawAttrs);
+            m_pImmediateContext->DrawIndexed(DrawAttrs);
 
 
             m_pImmediateContext->SetPipelineState(m_pLightCubePSO);
-            c.model = glm::transpose(glm::scale(light_model, glm::vec3(0.2f)));
-            c.inverse_transpose_model = glm::transpose(glm::inverse(glm::transpose(c.model)));
-            Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-            *CBConstants = c;
-
+            m_pLightCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_VERTEX, "Constants")->SetBufferOffset(light_cube_constants_offset);
             m_pImmediateContext->CommitShaderResources(m_pLightCubeSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-            m_pImmediateContext->Draw(DrawAttrs);
+            m_pImmediateContext->DrawIndexed(DrawAttrs);
         }
 
+        m_Benchmark.end_frame(m_pImmediateContext);
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
     void create_pipeline_states() {
@@ -256,8 +264,8 @@ class application {
         PSOCreateInfo.PSODesc.Name = "Cube PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
-        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_RenderTarget.desc().DepthBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = true;
         PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_NONE;
@@ -275,7 +283,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Colors vertex shader";
             ShaderCI.FilePath = "colors.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+            m_PipelineCache.create_shader(ShaderCI, &pVS);
         }
 
         RefCntAutoPtr<IShader> pCombinedPS;
@@ -284,31 +292,35 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Colors pixel shader";
             ShaderCI.FilePath = "colors.psh";
-            m_pDevice->CreateShader(ShaderCI, &pCombinedPS);
+            m_PipelineCache.create_shader(ShaderCI, &pCombinedPS);
         }
 
-        std::array LayoutElems =
-        {
-            LayoutElement{0, 0, 3, VT_FLOAT32, False},
-            LayoutElement{1, 0, 3, VT_FLOAT32, False}
-        };
-
-        PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = LayoutElems.data();
-        PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = LayoutElems.size();
+        PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = packed_vertex::layout.data();
+        PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = packed_vertex::layout.size();
 
         PSOCreateInfo.pVS = pVS;
         PSOCreateInfo.pPS = pCombinedPS;
 
         PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pCubePSO);
+        std::array CubeVars =
+        {
+            ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Constants", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Colors", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Camera", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+        };
+
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables = CubeVars.data();
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = CubeVars.size();
+
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pCubePSO);
 
         RefCntAutoPtr<IShader> pLightCubeVS;
         {
             ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
             ShaderCI.Desc.Name = "Light Cube vertex shader";
             ShaderCI.FilePath = "light_cube.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubeVS);
+            m_PipelineCache.create_shader(ShaderCI, &pLightCubeVS);
         }
 
         RefCntAutoPtr<IShader> pLightCubePS;
@@ -316,117 +328,49 @@ class application {
             ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
             ShaderCI.Desc.Name = "Light Cube pixel shader";
             ShaderCI.FilePath = "light_cube.psh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubePS);
+            m_PipelineCache.create_shader(ShaderCI, &pLightCubePS);
         }
 
+        std::array LightCubeVars =
+        {
+            ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Constants", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+        };
+
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables = LightCubeVars.data();
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = LightCubeVars.size();
+
         PSOCreateInfo.PSODesc.Name = "Light Cube PSO";
         PSOCreateInfo.pVS = pLightCubeVS;
         PSOCreateInfo.pPS = pLightCubePS;
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pLightCubePSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pLightCubePSO);
 
         create_uniform_buffers();
 
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Colors")->Set(m_FSColors);
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Camera")->Set(m_PSCamera);
-
-        m_pLightCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
-
         m_pCubePSO->CreateShaderResourceBinding(&m_pCubeSRB, true);
         m_pLightCubePSO->CreateShaderResourceBinding(&m_pLightCubeSRB, true);
 
-    }
-
-    void create_uniform_buffers() {
-        using namespace Diligent;
-
-        BufferDesc CBDesc;
-        CBDesc.Usage = USAGE_DYNAMIC;
-        CBDesc.BindFlags = BIND_UNIFORM_BUFFER;
-        CBDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
-
-        CBDesc.Name = "VS constants CB";
-        CBDesc.Size = sizeof(Constants);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_VSConstants);
+        m_FrameRing.bind<Constants>(*m_pCubeSRB, SHADER_TYPE_VERTEX, "Constants");
+        m_FrameRing.bind<Colors>(*m_pCubeSRB, SHADER_TYPE_PIXEL, "Colors");
+        m_FrameRing.bind<Camera::CB>(*m_pCubeSRB, SHADER_TYPE_PIXEL, "Camera");
 
-        CBDesc.Name = "PS Colors CB";
-        CBDesc.Size = sizeof(Colors);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_FSColors);
+        m_FrameRing.bind<Constants>(*m_pLightCubeSRB, SHADER_TYPE_VERTEX, "Constants");
 
-        CBDesc.Name = "PS Camera CB";
-        CBDesc.Size = sizeof(Camera::CB);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSCamera);
+    }
 
+    void create_uniform_buffers() {
+        m_FrameRing.create(*m_pDevice, 64 << 10, "Frame constants ring");
     }
 
     void create_cube_buffer() {
-
-        struct cube_vertex {
-            glm::vec3 pos;
-            glm::vec3 normal;
-        };
-
-        std::array vertices = {
-            //face front
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-            //face back                                                                  
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-            //face right
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f,  0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f, -0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f,  0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f,  0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-            //face left
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f, -0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f, -0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f, -0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f,  0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-            //face top                                                                   
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-            //face bottom                                                                
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)}
-        };
-
-        using namespace Diligent;
-        BufferDesc VertBuffDesc;
-        VertBuffDesc.Name = "Cube vertex buffer";
-        VertBuffDesc.Usage = USAGE_IMMUTABLE;
-        VertBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
-        VertBuffDesc.Size = vertices.size() * sizeof(decltype(vertices)::value_type);
-        BufferData VBData;
-        VBData.pData = vertices.data();
-        VBData.DataSize = vertices.size() * sizeof(decltype(vertices)::value_type);
-        m_pDevice->CreateBuffer(VertBuffDesc, &VBData, &m_CubeVertexBuffer);
-
+        m_CubeMesh.create(m_pDevice);
     }
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options)
+        , m_Benchmark(Options) {
         init();
     }
 
@@ -436,43 +380,57 @@ public:
 
     void run() {
         create_pipeline_states();
+        m_PipelineCache.save();
         create_cube_buffer();
 
         float delta_time = 0.0f;	// Time between current frame and last frame
         float last_frame = 0.0f; // Time of last frame
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
+            m_Benchmark.begin_frame(m_pImmediateContext);
 
-            float current_frame = glfwGetTime();
+            float current_frame = m_Loop.time();
             delta_time = current_frame - last_frame;
             last_frame = current_frame;
 
-            glfwPollEvents();
-            process_input(delta_time);
+            if (!m_Options.headless) {
+                glfwPollEvents();
+                if (!m_Benchmark.enabled()) {
+                    process_input(delta_time);
+                }
+            }
+            if (m_Benchmark.enabled()) {
+                frame_benchmark::place_camera(camera, m_Loop.time());
+            }
 
             render();
         }
+
+        m_Benchmark.finish("BasicLighting", m_Options, m_pImmediateContext);
     }
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+    frame_benchmark m_Benchmark;
+
+    GLFWwindow* window = nullptr;
 
     Camera camera;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
 
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_CubeVertexBuffer;
+    cube_mesh                                                 m_CubeMesh;
 
     Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pCubePSO;
     Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pCubeSRB;
 
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_VSConstants;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_FSColors;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSCamera;
+    frame_ring_buffer                                         m_FrameRing;
 
     Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pLightCubePSO;
     Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pLightCubeSRB;
@@ -485,10 +443,10 @@ private:
     camera_mode mode = camera_mode::rotating;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
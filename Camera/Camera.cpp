@@ -1,10 +1,8 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
+#include "../Common/baked_texture.hpp"
+#include "../Common/frustum_culling.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -22,6 +20,7 @@
 #include <array>
 #include <iostream>
 #include <optional>
+#include <vector>
 //used in 
 struct Constants
 {
@@ -51,10 +50,7 @@ class application {
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        if (app->m_pSwapChain)
-        {
-            app->m_pSwapChain->Resize(width, height);
-        }
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -121,8 +117,8 @@ class application {
     }
 
     void initialize_glfw() {
-        constexpr auto width = 800;
-        constexpr auto height = 600;
+        const auto width = static_cast<int> (m_Options.width);
+        const auto height = static_cast<int> (m_Options.height);
 
         if (auto res = glfwInit(); res == GLFW_FALSE) {
             throw std::runtime_error("GLFW failed to initialize.");
@@ -156,23 +152,28 @@ class application {
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
 
-        auto handle = glfwGetWin32Window(window);
-
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
+        SwapChainDesc SCDesc;
+        SCDesc.ColorBufferFormat = TEX_FORMAT_BGRA8_UNORM_SRGB;
+        SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-            SwapChainDesc SCDesc;
-            SCDesc.ColorBufferFormat = TEX_FORMAT_BGRA8_UNORM_SRGB;
-            SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
         }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
+        }
+
+        m_PipelineCache.create(m_pDevice, "Camera");
 
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
@@ -193,8 +194,8 @@ class application {
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
-        auto pDSV = m_pSwapChain->GetDepthBufferDSV();
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
+        auto pDSV = m_RenderTarget.depth_buffer_dsv();
         m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
         const glm::vec4 ClearColor = { 0.2f, 0.3f, 0.3f, 1.0f };
         m_pImmediateContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
@@ -209,31 +210,36 @@ class application {
 
         {
             Constants c;
+            glm::mat4 view;
+            glm::mat4 projection;
 
-            const auto& SwapChainDesc = m_pSwapChain->GetDesc();
+            const auto& SwapChainDesc = m_RenderTarget.desc();
             const float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
 
             switch (mode)
             {
             case camera_mode::rotating:
             {
-                c.projection = glm::transpose(glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f));
+                projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
 
                 const float radius = 10.0f;
-                float camX = std::sin(glfwGetTime()) * radius;
-                float camZ = std::cos(glfwGetTime()) * radius;
+                float camX = std::sin(m_Loop.time()) * radius;
+                float camZ = std::cos(m_Loop.time()) * radius;
                 camera.eye = glm::vec3(camX, 0.0f, camZ);
 
-                c.view = glm::transpose(glm::lookAt(camera.eye, camera.target, camera.up));
+                view = glm::lookAt(camera.eye, camera.target, camera.up);
             }
                 break;
             case camera_mode::fly_cam:
 
-                c.view = glm::transpose(glm::lookAt(camera.eye, camera.eye + camera.front, camera.up));
-                c.projection = glm::transpose(glm::perspective(glm::radians(static_cast<float> (camera.fov)), aspect, 0.1f, 100.0f));
+                view = glm::lookAt(camera.eye, camera.eye + camera.front, camera.up);
+                projection = glm::perspective(glm::radians(static_cast<float> (camera.fov)), aspect, 0.1f, 100.0f);
 
                 break;
             }
+
+            c.view = glm::transpose(view);
+            c.projection = glm::transpose(projection);
            
             std::array cube_positions = {
                 glm::vec3(0.0f,  0.0f,  0.0f),
@@ -248,17 +254,24 @@ class application {
                 glm::vec3(-1.3f,  1.0f, -1.5f)
             };
 
-            int i = 0;
+            std::array<glm::mat4, std::tuple_size_v<decltype(cube_positions)>> models;
+            m_CubeBounds.clear();
+            for (size_t i = 0; i < cube_positions.size(); ++i)
+            {
+                const float angle = 20.0f * i;
+                models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), cube_positions[i]), glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+                m_CubeBounds.add(models[i], glm::vec3(0.5f));
+            }
+
+            m_CubeBounds.cull(frustum::from_matrix(projection * view), m_VisibleCubes);
 
             Diligent::DrawAttribs DrawAttrs;
             DrawAttrs.NumVertices = 36;
             DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
 
-            for (const auto& cube_position : cube_positions)
+            for (const auto index : m_VisibleCubes)
             {
-                c.model = glm::translate(glm::mat4(1.0f), cube_position);
-                float angle = 20.0f * i++;
-                c.model = glm::transpose(glm::rotate(c.model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f)));
+                c.model = glm::transpose(models[index]);
 
                 Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
                 *CBConstants = c;
@@ -268,7 +281,7 @@ class application {
         }
 
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
     void create_pipeline_state() {
@@ -278,8 +291,8 @@ class application {
         PSOCreateInfo.PSODesc.Name = "Texture PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
-        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_RenderTarget.desc().DepthBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = true;
 
@@ -296,7 +309,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Coordinate systems vertex shader";
             ShaderCI.FilePath = "coordinate_systems.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+            m_PipelineCache.create_shader(ShaderCI, &pVS);
 
             BufferDesc CBDesc;
             CBDesc.Name = "VS constants CB";
@@ -313,7 +326,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Combined Texture pixel shader";
             ShaderCI.FilePath = "combined_texture.psh";
-            m_pDevice->CreateShader(ShaderCI, &pCombinedPS);
+            m_PipelineCache.create_shader(ShaderCI, &pCombinedPS);
         }
 
         std::array LayoutElems =
@@ -353,7 +366,7 @@ class application {
         PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers = CombinedImtblSamplers.data();
         PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = CombinedImtblSamplers.size();
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pCombinedPSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pCombinedPSO);
 
         m_pCombinedPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
 
@@ -433,7 +446,7 @@ class application {
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB = true;
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\container.jpg)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("container.jpg"), loadInfo, m_pDevice, &Tex);
 
         m_ContainerTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -446,7 +459,7 @@ class application {
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB = true;
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\awesomeface.png)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("awesomeface.png"), loadInfo, m_pDevice, &Tex);
 
         m_FaceTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -460,7 +473,9 @@ class application {
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options) {
         init();
     }
 
@@ -470,20 +485,23 @@ public:
 
     void run() {
         create_pipeline_state();
+        m_PipelineCache.save();
         create_cube_buffer();
         load_textures();
 
         float delta_time = 0.0f;	// Time between current frame and last frame
         float last_frame = 0.0f; // Time of last frame
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
 
-            float current_frame = glfwGetTime();
+            float current_frame = m_Loop.time();
             delta_time = current_frame - last_frame;
             last_frame = current_frame;
 
-            glfwPollEvents();
-            process_input(delta_time);
+            if (!m_Options.headless) {
+                glfwPollEvents();
+                process_input(delta_time);
+            }
 
             render();
         }
@@ -491,14 +509,18 @@ public:
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+
+    GLFWwindow* window = nullptr;
 
     Camera camera;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
 
     Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_ContainerTextureSRV;
     Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_FaceTextureSRV;
@@ -509,6 +531,9 @@ private:
     Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pCombinedSRB;
     Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_VSConstants;
 
+    aabb_culler                                               m_CubeBounds;
+    std::vector<Diligent::Uint32>                             m_VisibleCubes;
+
     enum class camera_mode {
         rotating,
         fly_cam
@@ -517,10 +542,10 @@ private:
     camera_mode mode = camera_mode::rotating;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
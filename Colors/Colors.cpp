@@ -1,10 +1,7 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
+#include "../Common/benchmark.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -57,10 +54,7 @@ class application {
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        if (app->m_pSwapChain)
-        {
-            app->m_pSwapChain->Resize(width, height);
-        }
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -108,8 +102,8 @@ class application {
     }
 
     void initialize_glfw() {
-        constexpr auto width = 800;
-        constexpr auto height = 600;
+        const auto width = static_cast<int> (m_Options.width);
+        const auto height = static_cast<int> (m_Options.height);
 
         if (auto res = glfwInit(); res == GLFW_FALSE) {
             throw std::runtime_error("GLFW failed to initialize.");
@@ -137,27 +131,37 @@ class application {
 
         EngineVkCreateInfo engine_ci;
 
+        if (m_Benchmark.enabled()) {
+            engine_ci.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+        }
+
         auto vk_factory = Diligent::GetEngineFactoryVk();
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
 
-        auto handle = glfwGetWin32Window(window);
+        SwapChainDesc SCDesc;
+        SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
+        SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
-
-            SwapChainDesc SCDesc;
-            SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
-            SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
+        }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
         }
 
+        m_PipelineCache.create(m_pDevice, "Colors");
+        m_Benchmark.create(m_pDevice);
+
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
@@ -175,8 +179,8 @@ class application {
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
-        auto pDSV = m_pSwapChain->GetDepthBufferDSV();
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
+        auto pDSV = m_RenderTarget.depth_buffer_dsv();
         m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
         const glm::vec4 ClearColor = { 0.1f, 0.1f, 0.1f, 1.0f };
         m_pImmediateContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
@@ -200,7 +204,7 @@ class application {
 
             Constants c;
             {
-                const auto& SwapChainDesc = m_pSwapChain->GetDesc();
+                const auto& SwapChainDesc = m_RenderTarget.desc();
                 const float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
                 c.view = glm::transpose(glm::lookAt(camera.eye, camera.eye + camera.front, camera.up));
                 c.projection = glm::transpose(glm::perspective(glm::radians(static_cast<float> (camera.fov)), aspect, 0.1f, 100.0f));
@@ -229,8 +233,9 @@ class application {
             m_pImmediateContext->Draw(DrawAttrs);
         }
 
+        m_Benchmark.end_frame(m_pImmediateContext);
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
     void create_pipeline_states() {
@@ -240,8 +245,8 @@ class application {
         PSOCreateInfo.PSODesc.Name = "Cube PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
-        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_RenderTarget.desc().DepthBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = true;
 
@@ -258,7 +263,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Colors vertex shader";
             ShaderCI.FilePath = "colors.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+            m_PipelineCache.create_shader(ShaderCI, &pVS);
 
             BufferDesc CBDesc;
             CBDesc.Name = "VS constants CB";
@@ -275,7 +280,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Colors pixel shader";
             ShaderCI.FilePath = "colors.psh";
-            m_pDevice->CreateShader(ShaderCI, &pCombinedPS);
+            m_PipelineCache.create_shader(ShaderCI, &pCombinedPS);
 
             BufferDesc LBDesc;
             LBDesc.Name = "FS Colors CB";
@@ -299,7 +304,7 @@ class application {
 
         PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pCubePSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pCubePSO);
 
         m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
         m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Colors")->Set(m_FSColors);
@@ -311,7 +316,7 @@ class application {
             ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
             ShaderCI.Desc.Name = "Light Cube vertex shader";
             ShaderCI.FilePath = "light_cube.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubeVS);
+            m_PipelineCache.create_shader(ShaderCI, &pLightCubeVS);
         }
 
         RefCntAutoPtr<IShader> pLightCubePS;
@@ -319,13 +324,13 @@ class application {
             ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
             ShaderCI.Desc.Name = "Light Cube pixel shader";
             ShaderCI.FilePath = "light_cube.psh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubePS);
+            m_PipelineCache.create_shader(ShaderCI, &pLightCubePS);
         }
 
         PSOCreateInfo.PSODesc.Name = "Light Cube PSO";
         PSOCreateInfo.pVS = pLightCubeVS;
         PSOCreateInfo.pPS = pLightCubePS;
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pLightCubePSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pLightCubePSO);
 
         m_pLightCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
         m_pLightCubePSO->CreateShaderResourceBinding(&m_pLightCubeSRB, true);
@@ -398,7 +403,10 @@ class application {
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options)
+        , m_Benchmark(Options) {
         init();
     }
 
@@ -408,34 +416,50 @@ public:
 
     void run() {
         create_pipeline_states();
+        m_PipelineCache.save();
         create_cube_buffer();
 
         float delta_time = 0.0f;	// Time between current frame and last frame
         float last_frame = 0.0f; // Time of last frame
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
+            m_Benchmark.begin_frame(m_pImmediateContext);
 
-            float current_frame = glfwGetTime();
+            float current_frame = m_Loop.time();
             delta_time = current_frame - last_frame;
             last_frame = current_frame;
 
-            glfwPollEvents();
-            process_input(delta_time);
+            if (!m_Options.headless) {
+                glfwPollEvents();
+                if (!m_Benchmark.enabled()) {
+                    process_input(delta_time);
+                }
+            }
+            if (m_Benchmark.enabled()) {
+                frame_benchmark::place_camera(camera, m_Loop.time());
+            }
 
             render();
         }
+
+        m_Benchmark.finish("Colors", m_Options, m_pImmediateContext);
     }
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+    frame_benchmark m_Benchmark;
+
+    GLFWwindow* window = nullptr;
 
     Camera camera;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
 
     Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_CubeVertexBuffer;
 
@@ -456,10 +480,10 @@ private:
     camera_mode mode = camera_mode::rotating;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include "DiligentTools/TextureLoader/interface/TextureUtilities.h"
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Textures baked by the TextureBaker tool are plain DDS files with a DX10 header holding a full,
+// BCn-compressed mip chain. They live in a baked folder next to the source image:
+//
+//   Assets/container2.png -> Assets/baked/container2.dds
+//
+// The loader maps the file and hands pointers into the mapping straight to CreateTexture, so
+// startup does no decoding, no mip generation and no intermediate copies.
+namespace dds {
+    constexpr Diligent::Uint32 magic = 0x20534444; // "DDS "
+    constexpr Diligent::Uint32 four_cc_dx10 = 0x30315844; // "DX10"
+
+    constexpr Diligent::Uint32 flags_texture = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // CAPS, HEIGHT, WIDTH, PIXELFORMAT, MIPMAPCOUNT, LINEARSIZE
+    constexpr Diligent::Uint32 pixel_format_four_cc = 0x4;
+    constexpr Diligent::Uint32 caps_mipmapped_texture = 0x1000 | 0x400000 | 0x8; // TEXTURE, MIPMAP, COMPLEX
+    constexpr Diligent::Uint32 dimension_texture_2d = 3;
+
+    struct pixel_format {
+        Diligent::Uint32 size = sizeof(pixel_format);
+        Diligent::Uint32 flags = pixel_format_four_cc;
+        Diligent::Uint32 four_cc = four_cc_dx10;
+        Diligent::Uint32 rgb_bit_count = 0;
+        Diligent::Uint32 r_mask = 0;
+        Diligent::Uint32 g_mask = 0;
+        Diligent::Uint32 b_mask = 0;
+        Diligent::Uint32 a_mask = 0;
+    };
+
+    struct header {
+        Diligent::Uint32 size = sizeof(header);
+        Diligent::Uint32 flags = flags_texture;
+        Diligent::Uint32 height = 0;
+        Diligent::Uint32 width = 0;
+        Diligent::Uint32 linear_size = 0;
+        Diligent::Uint32 depth = 0;
+        Diligent::Uint32 mip_map_count = 0;
+        Diligent::Uint32 reserved1[11] = {};
+        pixel_format     format;
+        Diligent::Uint32 caps = caps_mipmapped_texture;
+        Diligent::Uint32 caps2 = 0;
+        Diligent::Uint32 caps3 = 0;
+        Diligent::Uint32 caps4 = 0;
+        Diligent::Uint32 reserved2 = 0;
+    };
+
+    struct header_dx10 {
+        Diligent::Uint32 dxgi_format = 0;
+        Diligent::Uint32 resource_dimension = dimension_texture_2d;
+        Diligent::Uint32 misc_flag = 0;
+        Diligent::Uint32 array_size = 1;
+        Diligent::Uint32 misc_flags2 = 0;
+    };
+
+    static_assert(sizeof(header) == 124 && sizeof(header_dx10) == 20, "DDS headers must match the file layout.");
+
+    struct format_info {
+        Diligent::TEXTURE_FORMAT format;
+        Diligent::Uint32         dxgi_format;
+        Diligent::Uint32         block_bytes; // per 4x4 block, or per texel for uncompressed formats
+        bool                     compressed;
+        bool                     srgb;
+    };
+
+    inline constexpr format_info formats[] = {
+        { Diligent::TEX_FORMAT_BC1_UNORM,       71,  8, true,  false },
+        { Diligent::TEX_FORMAT_BC1_UNORM_SRGB,  72,  8, true,  true  },
+        { Diligent::TEX_FORMAT_BC3_UNORM,       77, 16, true,  false },
+        { Diligent::TEX_FORMAT_BC3_UNORM_SRGB,  78, 16, true,  true  },
+        { Diligent::TEX_FORMAT_BC4_UNORM,       80,  8, true,  false },
+        { Diligent::TEX_FORMAT_BC5_UNORM,       83, 16, true,  false },
+        { Diligent::TEX_FORMAT_BC7_UNORM,       98, 16, true,  false },
+        { Diligent::TEX_FORMAT_BC7_UNORM_SRGB,  99, 16, true,  true  },
+        { Diligent::TEX_FORMAT_RGBA8_UNORM,     28,  4, false, false },
+        { Diligent::TEX_FORMAT_RGBA8_UNORM_SRGB, 29,  4, false, true  },
+    };
+
+    inline const format_info* find_format(Diligent::Uint32 DxgiFormat) {
+        for (const auto& Info : formats) {
+            if (Info.dxgi_format == DxgiFormat) {
+                return &Info;
+            }
+        }
+        return nullptr;
+    }
+
+    inline const format_info* find_format(Diligent::TEXTURE_FORMAT Format) {
+        for (const auto& Info : formats) {
+            if (Info.format == Format) {
+                return &Info;
+            }
+        }
+        return nullptr;
+    }
+
+    // Row pitch and row count of one mip; compressed rows are rows of 4x4 blocks.
+    inline Diligent::Uint32 row_pitch(const format_info& Info, Diligent::Uint32 Width) {
+        return Info.compressed ? std::max(1u, (Width + 3) / 4) * Info.block_bytes : Width * Info.block_bytes;
+    }
+
+    inline Diligent::Uint32 row_count(const format_info& Info, Diligent::Uint32 Height) {
+        return Info.compressed ? std::max(1u, (Height + 3) / 4) : Height;
+    }
+}
+
+// Read-only memory mapping of a whole file.
+class mapped_file {
+public:
+    explicit mapped_file(const std::filesystem::path& Path) {
+#if defined(_WIN32)
+        m_File = CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_File == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open " + Path.string() + ".");
+        }
+
+        LARGE_INTEGER Size;
+        GetFileSizeEx(m_File, &Size);
+        m_Size = static_cast<size_t> (Size.QuadPart);
+
+        m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_pData = m_Mapping ? MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+        m_File = open(Path.c_str(), O_RDONLY);
+        if (m_File < 0) {
+            throw std::runtime_error("Failed to open " + Path.string() + ".");
+        }
+
+        struct stat Stat;
+        fstat(m_File, &Stat);
+        m_Size = static_cast<size_t> (Stat.st_size);
+
+        m_pData = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+        if (m_pData == MAP_FAILED) {
+            m_pData = nullptr;
+        }
+#endif
+        if (m_pData == nullptr) {
+            unmap();
+            throw std::runtime_error("Failed to map " + Path.string() + ".");
+        }
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file() {
+        unmap();
+    }
+
+    const Diligent::Uint8* data() const {
+        return static_cast<const Diligent::Uint8*> (m_pData);
+    }
+
+    size_t size() const {
+        return m_Size;
+    }
+
+private:
+    void unmap() {
+#if defined(_WIN32)
+        if (m_pData) UnmapViewOfFile(m_pData);
+        if (m_Mapping) CloseHandle(m_Mapping);
+        if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+#else
+        if (m_pData) munmap(m_pData, m_Size);
+        if (m_File >= 0) close(m_File);
+#endif
+    }
+
+#if defined(_WIN32)
+    HANDLE m_File = INVALID_HANDLE_VALUE;
+    HANDLE m_Mapping = nullptr;
+#else
+    int    m_File = -1;
+#endif
+    void*  m_pData = nullptr;
+    size_t m_Size = 0;
+};
+
+inline std::filesystem::path baked_texture_path(const std::filesystem::path& ImagePath) {
+    return ImagePath.parent_path() / "baked" / ImagePath.filename().replace_extension(".dds");
+}
+
+// Images named with one of these suffixes hold data rather than color, such as specular masks.
+// They are filtered and baked as linear UNORM, and have to be loaded with IsSRGB off. Everything
+// else is sRGB color.
+inline bool is_linear_texture(const std::filesystem::path& ImagePath) {
+    constexpr std::string_view suffixes[] = { "_specular", "_normal" };
+    const auto Stem = ImagePath.stem().string();
+    return std::any_of(std::begin(suffixes), std::end(suffixes), [&](std::string_view Suffix) { return Stem.ends_with(Suffix); });
+}
+
+// The mips of a baked file were filtered in the color space it was baked for, so LoadInfo.IsSRGB
+// has to match its format; reading the blocks the other way would give wrong mips.
+inline void create_baked_texture(Diligent::IRenderDevice* pDevice, const std::filesystem::path& Path, const Diligent::TextureLoadInfo& LoadInfo, Diligent::ITexture** ppTexture) {
+    using namespace Diligent;
+
+    const mapped_file File(Path);
+    const auto* pData = File.data();
+
+    const auto Invalid = [&]() {
+        return std::runtime_error(Path.string() + " is not a baked texture.");
+    };
+
+    constexpr size_t HeadersSize = sizeof(Uint32) + sizeof(dds::header) + sizeof(dds::header_dx10);
+    if (File.size() < HeadersSize) {
+        throw Invalid();
+    }
+
+    Uint32 Magic;
+    dds::header Header;
+    dds::header_dx10 HeaderDX10;
+    std::memcpy(&Magic, pData, sizeof(Magic));
+    std::memcpy(&Header, pData + sizeof(Magic), sizeof(Header));
+    std::memcpy(&HeaderDX10, pData + sizeof(Magic) + sizeof(Header), sizeof(HeaderDX10));
+
+    const auto* pFormat = dds::find_format(HeaderDX10.dxgi_format);
+    if (Magic != dds::magic || Header.size != sizeof(dds::header) || Header.format.four_cc != dds::four_cc_dx10 ||
+        HeaderDX10.resource_dimension != dds::dimension_texture_2d || HeaderDX10.array_size != 1 || pFormat == nullptr) {
+        throw Invalid();
+    }
+
+    if (pFormat->srgb != LoadInfo.IsSRGB) {
+        throw std::runtime_error(Path.string() + " is baked as " + (pFormat->srgb ? "sRGB" : "linear") + " data but was loaded with IsSRGB " + (LoadInfo.IsSRGB ? "on" : "off") + ".");
+    }
+
+    TextureDesc Desc;
+    Desc.Name = "Baked texture";
+    Desc.Type = RESOURCE_DIM_TEX_2D;
+    Desc.Width = Header.width;
+    Desc.Height = Header.height;
+    Desc.MipLevels = std::max(1u, Header.mip_map_count);
+    Desc.Format = pFormat->format;
+    Desc.Usage = USAGE_IMMUTABLE;
+    Desc.BindFlags = BIND_SHADER_RESOURCE;
+
+    std::vector<TextureSubResData> Mips(Desc.MipLevels);
+    size_t Offset = HeadersSize;
+    for (Uint32 Mip = 0; Mip < Desc.MipLevels; ++Mip) {
+        const auto Pitch = dds::row_pitch(*pFormat, std::max(1u, Desc.Width >> Mip));
+        const auto MipSize = size_t{ Pitch } * dds::row_count(*pFormat, std::max(1u, Desc.Height >> Mip));
+        if (Offset + MipSize > File.size()) {
+            throw Invalid();
+        }
+
+        Mips[Mip].pData = pData + Offset;
+        Mips[Mip].Stride = Pitch;
+        Offset += MipSize;
+    }
+
+    // The device copies the data into its upload heap here, so the mapping can go right after.
+    TextureData InitData{ Mips.data(), static_cast<Uint32> (Mips.size()) };
+    pDevice->CreateTexture(Desc, &InitData, ppTexture);
+    if (*ppTexture == nullptr) {
+        throw std::runtime_error("Failed to create a texture from " + Path.string() + ".");
+    }
+}
+
+// A file in the repository's Assets folder, which samples run one directory below. Built from
+// components rather than a literal, so the separator is right on every platform.
+inline std::filesystem::path asset_path(const char* Name) {
+    return std::filesystem::path("..") / "Assets" / Name;
+}
+
+// Loads the baked version of an image when it is present and up to date, and decodes the image
+// itself otherwise, so samples still run before the assets have been baked.
+inline void load_texture(const std::filesystem::path& ImagePath, const Diligent::TextureLoadInfo& LoadInfo, Diligent::IRenderDevice* pDevice, Diligent::ITexture** ppTexture) {
+    const auto BakedPath = baked_texture_path(ImagePath);
+
+    std::error_code Error;
+    const auto BakedTime = std::filesystem::last_write_time(BakedPath, Error);
+    if (!Error && BakedTime >= std::filesystem::last_write_time(ImagePath, Error) && !Error) {
+        create_baked_texture(pDevice, BakedPath, LoadInfo, ppTexture);
+        return;
+    }
+
+    Diligent::CreateTextureFromFile(ImagePath.string().c_str(), LoadInfo, pDevice, ppTexture);
+    if (*ppTexture == nullptr) {
+        throw std::runtime_error("Failed to load " + ImagePath.string() + ".");
+    }
+}
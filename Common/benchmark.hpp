@@ -0,0 +1,266 @@
+#pragma once
+
+#include "headless.hpp"
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/Query.h"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Times every frame of a --benchmark run and writes the statistics as JSON.
+//
+// A benchmark run replaces input with a scripted camera path and, like a headless run, steps the
+// frame clock by a fixed 1/60 s, so every run renders the same frames in the same order and only
+// the timings differ between builds and machines. Per frame it records:
+//
+//   frame  wall time from the start of one frame to the start of the next, present included
+//   cpu    wall time from the start of the frame to its submission
+//   gpu    time between timestamps written at the start and end of the frame's commands, where
+//          the device supports timestamp queries
+//
+// The first warmup frames are left out of the statistics, which skips pipeline creation, first
+// uploads and driver warmup.
+class frame_benchmark {
+public:
+    static constexpr Diligent::Uint32 readback_latency = 8;
+
+    using clock = std::chrono::steady_clock;
+
+    explicit frame_benchmark(const launch_options& Options)
+        : m_Path(Options.benchmark_path)
+        , m_Warmup(Options.benchmark_warmup) {
+    }
+
+    bool enabled() const {
+        return !m_Path.empty();
+    }
+
+    void create(Diligent::IRenderDevice* pDevice) {
+        using namespace Diligent;
+
+        if (!enabled()) {
+            return;
+        }
+
+        m_Adapter = pDevice->GetAdapterInfo().Description;
+        if (!pDevice->GetDeviceInfo().Features.TimestampQueries) {
+            return;
+        }
+
+        QueryDesc Desc;
+        Desc.Name = "Benchmark timestamp";
+        Desc.Type = QUERY_TYPE_TIMESTAMP;
+        for (auto& Slot : m_Slots) {
+            pDevice->CreateQuery(Desc, &Slot.begin);
+            pDevice->CreateQuery(Desc, &Slot.end);
+        }
+    }
+
+    // The scripted camera: an orbit around the middle of the scenes with a slow dolly and bob,
+    // looking a little below the orbit's center. One lap takes 12 s of frame clock.
+    template <typename Camera>
+    static void place_camera(Camera& C, double Time) {
+        const float Angle = static_cast<float> (Time * 2.0 * 3.14159265358979 / 12.0);
+        const float Radius = 7.0f + 2.0f * std::sin(0.5f * Angle);
+        const glm::vec3 Center(0.0f, 0.0f, -3.0f);
+
+        C.eye = Center + glm::vec3(Radius * std::sin(Angle), 1.5f + std::sin(2.0f * Angle), Radius * std::cos(Angle));
+        C.front = glm::normalize(Center - glm::vec3(0.0f, 0.5f, 0.0f) - C.eye);
+    }
+
+    void begin_frame(Diligent::IDeviceContext* pContext) {
+        if (!enabled()) {
+            return;
+        }
+
+        const auto Now = clock::now();
+        if (!m_Frames.empty()) {
+            m_Frames.back().frame_ms = milliseconds(Now - m_FrameStart);
+        }
+        m_FrameStart = Now;
+        m_Frames.emplace_back();
+
+        if (timestamps()) {
+            // Reads back the frame that last used this slot, readback_latency frames ago.
+            const auto Frame = m_Frames.size() - 1;
+            if (Frame >= readback_latency) {
+                resolve(Frame - readback_latency);
+            }
+            pContext->EndQuery(m_Slots[Frame % readback_latency].begin);
+        }
+    }
+
+    // Call right before the frame's Flush.
+    void end_frame(Diligent::IDeviceContext* pContext) {
+        if (!enabled()) {
+            return;
+        }
+
+        m_Frames.back().cpu_ms = milliseconds(clock::now() - m_FrameStart);
+        if (timestamps()) {
+            pContext->EndQuery(m_Slots[(m_Frames.size() - 1) % readback_latency].end);
+        }
+    }
+
+    // Call once the frame loop is done. Waits for the GPU, writes the JSON report to the
+    // --benchmark path and prints a summary.
+    void finish(const char* Sample, const launch_options& Options, Diligent::IDeviceContext* pContext) {
+        if (!enabled() || m_Frames.empty()) {
+            return;
+        }
+
+        m_Frames.back().frame_ms = milliseconds(clock::now() - m_FrameStart);
+
+        if (timestamps()) {
+            pContext->WaitForIdle();
+            const auto Count = m_Frames.size();
+            for (size_t Frame = Count > readback_latency ? Count - readback_latency : 0; Frame < Count; ++Frame) {
+                resolve(Frame);
+            }
+        }
+
+        const auto Frame = stats(&frame_record::frame_ms);
+        const auto Cpu = stats(&frame_record::cpu_ms);
+        const auto Gpu = stats(&frame_record::gpu_ms);
+
+        std::ofstream Report(m_Path);
+        if (!Report) {
+            throw std::runtime_error("Failed to open " + m_Path + " for writing.");
+        }
+
+        Report << "{\n"
+               << "  \"sample\": \"" << escaped(Sample) << "\",\n"
+               << "  \"adapter\": \"" << escaped(m_Adapter) << "\",\n"
+               << "  \"width\": " << Options.width << ",\n"
+               << "  \"height\": " << Options.height << ",\n"
+               << "  \"headless\": " << (Options.headless ? "true" : "false") << ",\n"
+               << "  \"present_mode\": \"" << present_mode_name(Options.present) << "\",\n"
+               << "  \"frames_in_flight\": " << Options.frames_in_flight << ",\n"
+               << "  \"frames\": " << Frame.count << ",\n"
+               << "  \"warmup\": " << std::min<size_t>(m_Warmup, m_Frames.size()) << ",\n"
+               << "  \"frame_ms\": " << json(Frame) << ",\n"
+               << "  \"cpu_ms\": " << json(Cpu) << ",\n"
+               << "  \"gpu_ms\": " << json(Gpu) << "\n"
+               << "}\n";
+
+        std::cout << Sample << ": " << Frame.count << " frames, avg " << Frame.avg << " ms, p99 " << Frame.p99
+                  << " ms (cpu avg " << Cpu.avg << " ms, gpu avg " << Gpu.avg << " ms), written to " << m_Path << "\n";
+    }
+
+private:
+    struct frame_record {
+        double frame_ms = std::numeric_limits<double>::quiet_NaN();
+        double cpu_ms = std::numeric_limits<double>::quiet_NaN();
+        double gpu_ms = std::numeric_limits<double>::quiet_NaN();
+    };
+
+    struct timestamp_slot {
+        Diligent::RefCntAutoPtr<Diligent::IQuery> begin;
+        Diligent::RefCntAutoPtr<Diligent::IQuery> end;
+    };
+
+    struct summary {
+        size_t count = 0;
+        double min = 0.0;
+        double avg = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    static double milliseconds(clock::duration Duration) {
+        return std::chrono::duration<double, std::milli>(Duration).count();
+    }
+
+    bool timestamps() const {
+        return m_Slots.front().begin.RawPtr() != nullptr;
+    }
+
+    // A frame whose timestamps aren't ready by the time its slot comes around again keeps no GPU
+    // time rather than stalling the frame loop.
+    void resolve(size_t Frame) {
+        auto& Slot = m_Slots[Frame % readback_latency];
+        Diligent::QueryDataTimestamp Begin, End;
+        if (Slot.begin->GetData(&Begin, sizeof(Begin)) && Slot.end->GetData(&End, sizeof(End))) {
+            m_Frames[Frame].gpu_ms = (End.Counter - Begin.Counter) * 1000.0 / static_cast<double> (Begin.Frequency);
+        }
+    }
+
+    // Nearest-rank percentiles over the frames after the warmup, skipping frames without a value.
+    summary stats(double frame_record::*Field) const {
+        std::vector<double> Values;
+        for (size_t i = std::min<size_t>(m_Warmup, m_Frames.size()); i < m_Frames.size(); ++i) {
+            const double Value = m_Frames[i].*Field;
+            if (!std::isnan(Value)) {
+                Values.push_back(Value);
+            }
+        }
+
+        summary Summary;
+        Summary.count = Values.size();
+        if (Values.empty()) {
+            return Summary;
+        }
+
+        std::sort(Values.begin(), Values.end());
+        const auto percentile = [&](double P) {
+            const auto Rank = static_cast<size_t> (std::ceil(P / 100.0 * Values.size()));
+            return Values[std::clamp<size_t>(Rank, 1, Values.size()) - 1];
+        };
+
+        double Total = 0.0;
+        for (const double Value : Values) {
+            Total += Value;
+        }
+
+        Summary.min = Values.front();
+        Summary.avg = Total / Values.size();
+        Summary.p50 = percentile(50.0);
+        Summary.p95 = percentile(95.0);
+        Summary.p99 = percentile(99.0);
+        Summary.max = Values.back();
+        return Summary;
+    }
+
+    static std::string json(const summary& Summary) {
+        if (Summary.count == 0) {
+            return "null";
+        }
+
+        char Text[256];
+        std::snprintf(Text, sizeof(Text), "{ \"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            Summary.min, Summary.avg, Summary.p50, Summary.p95, Summary.p99, Summary.max);
+        return Text;
+    }
+
+    static std::string escaped(const std::string& Text) {
+        std::string Escaped;
+        for (const char c : Text) {
+            if (c == '"' || c == '\\') {
+                Escaped += '\\';
+            }
+            if (static_cast<unsigned char> (c) >= 0x20) {
+                Escaped += c;
+            }
+        }
+        return Escaped;
+    }
+
+    std::string                                   m_Path;
+    Diligent::Uint32                              m_Warmup;
+    std::string                                   m_Adapter;
+    std::array<timestamp_slot, readback_latency>  m_Slots;
+    std::vector<frame_record>                     m_Frames;
+    clock::time_point                             m_FrameStart;
+};
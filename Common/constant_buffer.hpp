@@ -0,0 +1,77 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/PipelineState.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/ShaderResourceBinding.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// A constant buffer for data that changes per frame or per pass rather than per draw.
+//
+// frame_ring_buffer suits per-draw data, but dynamic buffers lose their contents at the end of the
+// frame, so everything in the ring is uploaded again every frame, changed or not, and again with
+// every batch. This is a USAGE_DEFAULT buffer instead: it keeps its contents, and update() copies
+// only when the data differs bytewise from the last upload. Shader variables are bound to it once,
+// as static or mutable variables, and every draw of the frame reads the same copy.
+template <typename Data>
+class constant_buffer {
+public:
+    void create(Diligent::IRenderDevice& Device, const char* Name) {
+        using namespace Diligent;
+
+        BufferDesc CBDesc;
+        CBDesc.Name = Name;
+        CBDesc.Usage = USAGE_DEFAULT;
+        CBDesc.BindFlags = BIND_UNIFORM_BUFFER;
+        CBDesc.Size = sizeof(Data);
+        Device.CreateBuffer(CBDesc, nullptr, &m_Buffer);
+        if (!m_Buffer) {
+            throw std::runtime_error(std::string("Failed to create ") + Name + ".");
+        }
+        m_Uploaded = false;
+    }
+
+    // Returns whether the data was uploaded. Call outside of deferred recording; the buffer is left
+    // in the constant buffer state, so deferred contexts can verify instead of transition it.
+    bool update(Diligent::IDeviceContext* pContext, const Data& New) {
+        using namespace Diligent;
+
+        if (m_Uploaded && std::memcmp(&m_Data, &New, sizeof(Data)) == 0) {
+            return false;
+        }
+        std::memcpy(&m_Data, &New, sizeof(Data));
+        m_Uploaded = true;
+
+        pContext->UpdateBuffer(m_Buffer, 0, sizeof(Data), &m_Data, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        const StateTransitionDesc Barrier{ m_Buffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE };
+        pContext->TransitionResourceStates(1, &Barrier);
+        return true;
+    }
+
+    void bind(Diligent::IShaderResourceBinding& SRB, Diligent::SHADER_TYPE ShaderType, const char* Name) const {
+        SRB.GetVariableByName(ShaderType, Name)->Set(m_Buffer);
+    }
+
+    // For static variables. Call before creating the pipeline's SRBs.
+    void bind(Diligent::IPipelineState& PSO, Diligent::SHADER_TYPE ShaderType, const char* Name) const {
+        PSO.GetStaticVariableByName(ShaderType, Name)->Set(m_Buffer);
+    }
+
+    const Data& data() const {
+        return m_Data;
+    }
+
+    Diligent::IBuffer* buffer() const {
+        return m_Buffer;
+    }
+
+private:
+    Diligent::RefCntAutoPtr<Diligent::IBuffer> m_Buffer;
+    Data                                       m_Data{};
+    bool                                       m_Uploaded = false;
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/InputLayout.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+// Vertex format shared by the lit cube samples, 16 bytes instead of 32:
+//
+//   ATTRIB0  position  snorm16 x4  position / packed_position_scale, w unused
+//   ATTRIB1  normal    snorm16 x2  octahedral encoding
+//   ATTRIB2  uv        unorm16 x2
+//
+// Shaders decode it with the functions in packed_vertex.fxh.
+struct packed_vertex {
+    Diligent::Int16  position[4];
+    Diligent::Int16  normal[2];
+    Diligent::Uint16 uv[2];
+
+    static constexpr float position_scale = 0.5f;
+
+    static inline const std::array<Diligent::LayoutElement, 3> layout = {
+        Diligent::LayoutElement{0, 0, 4, Diligent::VT_INT16,  Diligent::True},
+        Diligent::LayoutElement{1, 0, 2, Diligent::VT_INT16,  Diligent::True},
+        Diligent::LayoutElement{2, 0, 2, Diligent::VT_UINT16, Diligent::True}
+    };
+
+    static Diligent::Int16 snorm16(float Value) {
+        return static_cast<Diligent::Int16> (std::lround(std::clamp(Value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    static Diligent::Uint16 unorm16(float Value) {
+        return static_cast<Diligent::Uint16> (std::lround(std::clamp(Value, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    static packed_vertex pack(const std::array<float, 3>& Position, const std::array<float, 3>& Normal, const std::array<float, 2>& UV) {
+        // Project the normal onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one.
+        const float L1 = std::abs(Normal[0]) + std::abs(Normal[1]) + std::abs(Normal[2]);
+        float x = Normal[0] / L1;
+        float y = Normal[1] / L1;
+        if (Normal[2] < 0.0f) {
+            const float FoldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            const float FoldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = FoldedX;
+            y = FoldedY;
+        }
+
+        return packed_vertex{
+            { snorm16(Position[0] / position_scale), snorm16(Position[1] / position_scale), snorm16(Position[2] / position_scale), 0 },
+            { snorm16(x), snorm16(y) },
+            { unorm16(UV[0]), unorm16(UV[1]) }
+        };
+    }
+};
+
+static_assert(sizeof(packed_vertex) == 16, "packed_vertex must stay 16 bytes.");
+
+// Unit cube as 24 packed vertices (four per face, so every face keeps its own normal and UVs)
+// and 36 16-bit indices. Each face reuses two of its vertices, which the post-transform cache
+// picks up instead of shading all six corners of its two triangles.
+class cube_mesh {
+public:
+    static constexpr Diligent::Uint32 vertex_count = 24;
+    static constexpr Diligent::Uint32 index_count = 36;
+
+    void create(Diligent::IRenderDevice* pDevice) {
+        using namespace Diligent;
+
+        struct face {
+            std::array<float, 3>                normal;
+            std::array<std::array<float, 3>, 4> positions;
+            std::array<std::array<float, 2>, 4> uvs;
+        };
+
+        static constexpr std::array<face, 6> faces = { {
+            { { 0.0f,  0.0f, -1.0f}, {{ {-0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f} }}, {{ {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} }} },
+            { { 0.0f,  0.0f,  1.0f}, {{ {-0.5f, -0.5f,  0.5f}, { 0.5f, -0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f} }}, {{ {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} }} },
+            { {-1.0f,  0.0f,  0.0f}, {{ {-0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f, -0.5f}, {-0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f,  0.5f} }}, {{ {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}, {0.0f, 0.0f} }} },
+            { { 1.0f,  0.0f,  0.0f}, {{ { 0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f,  0.5f} }}, {{ {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}, {0.0f, 0.0f} }} },
+            { { 0.0f, -1.0f,  0.0f}, {{ {-0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f,  0.5f}, {-0.5f, -0.5f,  0.5f} }}, {{ {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f}, {0.0f, 0.0f} }} },
+            { { 0.0f,  1.0f,  0.0f}, {{ {-0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f} }}, {{ {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f}, {0.0f, 0.0f} }} },
+        } };
+
+        std::array<packed_vertex, vertex_count> Vertices;
+        std::array<Uint16, index_count> Indices;
+        for (Uint32 Face = 0; Face < faces.size(); ++Face) {
+            for (Uint32 Corner = 0; Corner < 4; ++Corner) {
+                Vertices[Face * 4 + Corner] = packed_vertex::pack(faces[Face].positions[Corner], faces[Face].normal, faces[Face].uvs[Corner]);
+            }
+
+            const Uint16 Base = static_cast<Uint16> (Face * 4);
+            const std::array<Uint16, 6> FaceIndices = { Base, Uint16(Base + 1), Uint16(Base + 2), Uint16(Base + 2), Uint16(Base + 3), Base };
+            std::copy(FaceIndices.begin(), FaceIndices.end(), Indices.begin() + Face * 6);
+        }
+
+        BufferDesc VertBuffDesc;
+        VertBuffDesc.Name = "Cube vertex buffer";
+        VertBuffDesc.Usage = USAGE_IMMUTABLE;
+        VertBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
+        VertBuffDesc.Size = sizeof(Vertices);
+        BufferData VBData{ Vertices.data(), sizeof(Vertices) };
+        pDevice->CreateBuffer(VertBuffDesc, &VBData, &m_pVertexBuffer);
+
+        BufferDesc IndBuffDesc;
+        IndBuffDesc.Name = "Cube index buffer";
+        IndBuffDesc.Usage = USAGE_IMMUTABLE;
+        IndBuffDesc.BindFlags = BIND_INDEX_BUFFER;
+        IndBuffDesc.Size = sizeof(Indices);
+        BufferData IBData{ Indices.data(), sizeof(Indices) };
+        pDevice->CreateBuffer(IndBuffDesc, &IBData, &m_pIndexBuffer);
+
+        if (!m_pVertexBuffer || !m_pIndexBuffer) {
+            throw std::runtime_error("Failed to create the cube buffers.");
+        }
+    }
+
+    // Deferred contexts pass RESOURCE_STATE_TRANSITION_MODE_VERIFY: the buffers are shared between
+    // them, so the transition has to happen on the immediate context first.
+    void bind(Diligent::IDeviceContext* pContext, Diligent::RESOURCE_STATE_TRANSITION_MODE Mode = Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION) const {
+        using namespace Diligent;
+
+        const Uint64 Offset = 0;
+        IBuffer* pBuffs[] = { m_pVertexBuffer };
+        pContext->SetVertexBuffers(0, 1, pBuffs, &Offset, Mode, SET_VERTEX_BUFFERS_FLAG_RESET);
+        pContext->SetIndexBuffer(m_pIndexBuffer, 0, Mode);
+    }
+
+    Diligent::IBuffer* vertex_buffer() const {
+        return m_pVertexBuffer;
+    }
+
+    Diligent::IBuffer* index_buffer() const {
+        return m_pIndexBuffer;
+    }
+
+    static Diligent::DrawIndexedAttribs draw_attribs(Diligent::Uint32 NumInstances = 1) {
+        Diligent::DrawIndexedAttribs DrawAttrs;
+        DrawAttrs.NumIndices = index_count;
+        DrawAttrs.IndexType = Diligent::VT_UINT16;
+        DrawAttrs.NumInstances = NumInstances;
+        DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
+        return DrawAttrs;
+    }
+
+    // The arguments of an indexed indirect draw of the cube with no instances yet, for a GPU pass
+    // to count the instances into: NumIndices, NumInstances, FirstIndexLocation, BaseVertex,
+    // FirstInstanceLocation.
+    static std::array<Diligent::Uint32, 5> indirect_args() {
+        return { index_count, 0, 0, 0, 0 };
+    }
+
+    // ArgsOffset is the byte offset of the arguments in pArgsBuffer.
+    static Diligent::DrawIndexedIndirectAttribs indirect_draw_attribs(Diligent::IBuffer* pArgsBuffer, Diligent::RESOURCE_STATE_TRANSITION_MODE Mode, Diligent::Uint64 ArgsOffset = 0) {
+        Diligent::DrawIndexedIndirectAttribs DrawAttrs;
+        DrawAttrs.pAttribsBuffer = pArgsBuffer;
+        DrawAttrs.DrawArgsOffset = ArgsOffset;
+        DrawAttrs.IndexType = Diligent::VT_UINT16;
+        DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
+        DrawAttrs.AttribsBufferStateTransitionMode = Mode;
+        return DrawAttrs;
+    }
+
+private:
+    Diligent::RefCntAutoPtr<Diligent::IBuffer> m_pVertexBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer> m_pIndexBuffer;
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "DiligentCore/Primitives/interface/BasicTypes.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// The draws of a frame as packets of a 64-bit sort key and an index into the sample's own object
+// arrays. Objects submit their packets in any order, and sort() puts them in key order, so draws
+// that need the same pipeline and resources end up next to each other and opaque objects of the
+// same state are drawn front to back. The key, most significant field first:
+//
+//   pass      4 bits   passes in the order they run
+//   pipeline 10 bits   pipeline state
+//   binding  14 bits   shader resource binding
+//   material 16 bits
+//   depth    20 bits   view depth between the near and far plane, nearest first
+//
+// Pipeline, binding and material ids are whatever the sample assigns, as long as they fit. The
+// sort is an LSD radix sort over bytes, linear in the packet count and stable. Bytes that are the
+// same in every key are skipped, which in practice leaves two or three passes over the list.
+class draw_list {
+public:
+    struct packet {
+        Diligent::Uint64 key;
+        Diligent::Uint32 index;
+    };
+
+    static constexpr Diligent::Uint32 pass_bits = 4;
+    static constexpr Diligent::Uint32 pipeline_bits = 10;
+    static constexpr Diligent::Uint32 binding_bits = 14;
+    static constexpr Diligent::Uint32 material_bits = 16;
+    static constexpr Diligent::Uint32 depth_bits = 20;
+
+    static_assert(pass_bits + pipeline_bits + binding_bits + material_bits + depth_bits == 64, "The key fields must fill 64 bits.");
+
+    static Diligent::Uint64 make_key(Diligent::Uint32 Pass, Diligent::Uint32 Pipeline, Diligent::Uint32 Binding, Diligent::Uint32 Material, Diligent::Uint32 Depth) {
+        using Diligent::Uint64;
+
+        Uint64 Key = field(Pass, pass_bits);
+        Key = (Key << pipeline_bits) | field(Pipeline, pipeline_bits);
+        Key = (Key << binding_bits) | field(Binding, binding_bits);
+        Key = (Key << material_bits) | field(Material, material_bits);
+        Key = (Key << depth_bits) | field(Depth, depth_bits);
+        return Key;
+    }
+
+    // ViewDepth is the distance along the view direction. Objects in front of Near or behind Far
+    // clamp to the nearest or farthest value.
+    static Diligent::Uint32 quantize_depth(float ViewDepth, float Near, float Far) {
+        const float Normalized = std::clamp((ViewDepth - Near) / (Far - Near), 0.0f, 1.0f);
+        return static_cast<Diligent::Uint32> (Normalized * static_cast<float> (max_value(depth_bits)));
+    }
+
+    static Diligent::Uint32 pass(Diligent::Uint64 Key) {
+        return static_cast<Diligent::Uint32> (Key >> (pipeline_bits + binding_bits + material_bits + depth_bits));
+    }
+
+    static Diligent::Uint32 pipeline(Diligent::Uint64 Key) {
+        return static_cast<Diligent::Uint32> ((Key >> (binding_bits + material_bits + depth_bits)) & max_value(pipeline_bits));
+    }
+
+    static Diligent::Uint32 binding(Diligent::Uint64 Key) {
+        return static_cast<Diligent::Uint32> ((Key >> (material_bits + depth_bits)) & max_value(binding_bits));
+    }
+
+    static Diligent::Uint32 material(Diligent::Uint64 Key) {
+        return static_cast<Diligent::Uint32> ((Key >> depth_bits) & max_value(material_bits));
+    }
+
+    void clear() {
+        m_Packets.clear();
+    }
+
+    void reserve(size_t Count) {
+        m_Packets.reserve(Count);
+    }
+
+    void submit(Diligent::Uint64 Key, Diligent::Uint32 Index) {
+        m_Packets.push_back({ Key, Index });
+    }
+
+    void sort() {
+        using namespace Diligent;
+
+        constexpr size_t digit_count = sizeof(Uint64);
+
+        // One read of the keys counts all eight digits.
+        std::array<std::array<Uint32, 256>, digit_count> Counts{};
+        for (const auto& Packet : m_Packets) {
+            for (size_t Digit = 0; Digit < digit_count; ++Digit) {
+                ++Counts[Digit][(Packet.key >> (Digit * 8)) & 0xFF];
+            }
+        }
+
+        m_Scratch.resize(m_Packets.size());
+        for (size_t Digit = 0; Digit < digit_count; ++Digit) {
+            auto& Count = Counts[Digit];
+            if (std::find(Count.begin(), Count.end(), static_cast<Uint32> (m_Packets.size())) != Count.end()) {
+                continue;
+            }
+
+            Uint32 Offset = 0;
+            for (auto& Bucket : Count) {
+                const Uint32 Size = Bucket;
+                Bucket = Offset;
+                Offset += Size;
+            }
+            for (const auto& Packet : m_Packets) {
+                m_Scratch[Count[(Packet.key >> (Digit * 8)) & 0xFF]++] = Packet;
+            }
+            m_Packets.swap(m_Scratch);
+        }
+    }
+
+    // Calls Func(Key, First, Last) for every run of sorted packets [First, Last) that share their
+    // pass, pipeline and binding, so the pipeline and bindings are set once per run.
+    template <typename Func>
+    void for_each_run(Func&& Fn) const {
+        const Diligent::Uint32 state_shift = material_bits + depth_bits;
+
+        size_t First = 0;
+        while (First < m_Packets.size()) {
+            const auto State = m_Packets[First].key >> state_shift;
+            size_t Last = First + 1;
+            while (Last < m_Packets.size() && (m_Packets[Last].key >> state_shift) == State) {
+                ++Last;
+            }
+            Fn(m_Packets[First].key, First, Last);
+            First = Last;
+        }
+    }
+
+    const packet& operator[](size_t Index) const {
+        return m_Packets[Index];
+    }
+
+    size_t size() const {
+        return m_Packets.size();
+    }
+
+private:
+    static constexpr Diligent::Uint64 max_value(Diligent::Uint32 Bits) {
+        return (Diligent::Uint64{ 1 } << Bits) - 1;
+    }
+
+    static Diligent::Uint64 field(Diligent::Uint32 Value, Diligent::Uint32 Bits) {
+        return std::min<Diligent::Uint64>(Value, max_value(Bits));
+    }
+
+    std::vector<packet> m_Packets;
+    std::vector<packet> m_Scratch;
+};
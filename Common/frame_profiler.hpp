@@ -0,0 +1,249 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/Query.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Records CPU and GPU timings while capturing and writes them as Chrome trace JSON, which opens
+// in chrome://tracing and ui.perfetto.dev.
+//
+// CPU scopes are RAII objects and may be opened from any thread; every thread gets its own track.
+// GPU scopes put a timestamp query on each side of a block of commands. The queries are read back
+// readback_latency frames later, once the GPU is done with them, and land on a separate "GPU"
+// track. GPU timestamps run on their own clock, so each frame's GPU events are anchored to the
+// CPU time the frame was submitted: durations are exact, the offset to the CPU track is not.
+class frame_profiler {
+public:
+    static constexpr Diligent::Uint32 readback_latency = 4;
+
+    class cpu_scope {
+    public:
+        cpu_scope(frame_profiler& Profiler, const char* Name)
+            : m_Profiler(Profiler.capturing() ? &Profiler : nullptr)
+            , m_Name(Name)
+            , m_Start(m_Profiler ? m_Profiler->now_us() : 0.0) {
+        }
+
+        cpu_scope(const cpu_scope&) = delete;
+        cpu_scope& operator=(const cpu_scope&) = delete;
+
+        ~cpu_scope() {
+            if (m_Profiler) {
+                m_Profiler->add_event(m_Name, thread_track(), m_Start, m_Profiler->now_us() - m_Start);
+            }
+        }
+
+    private:
+        frame_profiler* m_Profiler;
+        const char*     m_Name;
+        double          m_Start;
+    };
+
+    class gpu_scope {
+    public:
+        gpu_scope(frame_profiler& Profiler, Diligent::IDeviceContext* pContext, const char* Name)
+            : m_Profiler(Profiler.capturing() && Profiler.m_pDevice ? &Profiler : nullptr)
+            , m_pContext(pContext) {
+            if (m_Profiler) {
+                m_Scope = m_Profiler->begin_gpu_scope(pContext, Name);
+            }
+        }
+
+        gpu_scope(const gpu_scope&) = delete;
+        gpu_scope& operator=(const gpu_scope&) = delete;
+
+        ~gpu_scope() {
+            if (m_Profiler) {
+                m_Profiler->end_gpu_scope(m_pContext, m_Scope);
+            }
+        }
+
+    private:
+        frame_profiler*           m_Profiler;
+        Diligent::IDeviceContext* m_pContext;
+        size_t                    m_Scope = 0;
+    };
+
+    // GPU scopes need the TimestampQueries device feature; without it only CPU scopes are recorded.
+    void create(Diligent::IRenderDevice* pDevice) {
+        if (pDevice->GetDeviceInfo().Features.TimestampQueries) {
+            m_pDevice = pDevice;
+        }
+    }
+
+    void set_capturing(bool Capturing) {
+        m_Capturing = Capturing;
+    }
+
+    bool capturing() const {
+        return m_Capturing;
+    }
+
+    cpu_scope cpu(const char* Name) {
+        return cpu_scope{ *this, Name };
+    }
+
+    gpu_scope gpu(Diligent::IDeviceContext* pContext, const char* Name) {
+        return gpu_scope{ *this, pContext, Name };
+    }
+
+    // Starts a frame and reads back the GPU scopes of the frame that last used this slot.
+    void begin_frame() {
+        m_Frame = (m_Frame + 1) % readback_latency;
+        auto& Slot = m_Slots[m_Frame];
+
+        resolve(Slot);
+
+        Slot.scopes.clear();
+        Slot.used_queries = 0;
+    }
+
+    // Marks the point the frame's commands were submitted, right after Flush().
+    void end_frame() {
+        m_Slots[m_Frame].submit_us = now_us();
+    }
+
+    void write_chrome_trace(const std::string& Path) const {
+        std::ofstream Trace(Path);
+        if (!Trace) {
+            throw std::runtime_error("Failed to open " + Path + " for writing.");
+        }
+
+        std::lock_guard Lock(m_EventsMutex);
+
+        Trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        Trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpu_track << ",\"args\":{\"name\":\"GPU\"}}";
+        for (Diligent::Uint32 Track = 1; Track < next_track(); ++Track) {
+            Trace << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << Track << ",\"args\":{\"name\":\"" << (Track == 1 ? "Main thread" : "Thread " + std::to_string(Track)) << "\"}}";
+        }
+        for (const auto& Event : m_Events) {
+            Trace << ",\n{\"name\":\"" << Event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << Event.track
+                  << ",\"ts\":" << Event.start_us << ",\"dur\":" << Event.duration_us << "}";
+        }
+        Trace << "\n]}\n";
+    }
+
+    void clear() {
+        std::lock_guard Lock(m_EventsMutex);
+        m_Events.clear();
+    }
+
+private:
+    static constexpr Diligent::Uint32 gpu_track = 0;
+
+    struct trace_event {
+        const char*      name;
+        Diligent::Uint32 track;
+        double           start_us;
+        double           duration_us;
+    };
+
+    struct pending_gpu_scope {
+        const char*      name;
+        Diligent::Uint32 begin_query;
+        Diligent::Uint32 end_query;
+    };
+
+    struct frame_slot {
+        std::vector<Diligent::RefCntAutoPtr<Diligent::IQuery>> queries;
+        std::vector<pending_gpu_scope>                         scopes;
+        Diligent::Uint32                                       used_queries = 0;
+        double                                                 submit_us = 0.0;
+    };
+
+    static std::atomic<Diligent::Uint32>& track_counter() {
+        static std::atomic<Diligent::Uint32> Counter{ 1 };
+        return Counter;
+    }
+
+    static Diligent::Uint32 next_track() {
+        return track_counter().load();
+    }
+
+    static Diligent::Uint32 thread_track() {
+        thread_local const Diligent::Uint32 Track = track_counter()++;
+        return Track;
+    }
+
+    double now_us() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_Epoch).count();
+    }
+
+    void add_event(const char* Name, Diligent::Uint32 Track, double Start, double Duration) {
+        std::lock_guard Lock(m_EventsMutex);
+        m_Events.push_back({ Name, Track, Start, Duration });
+    }
+
+    Diligent::Uint32 next_query(Diligent::IDeviceContext* pContext) {
+        auto& Slot = m_Slots[m_Frame];
+        if (Slot.used_queries == Slot.queries.size()) {
+            Diligent::QueryDesc Desc;
+            Desc.Name = "Profiler timestamp";
+            Desc.Type = Diligent::QUERY_TYPE_TIMESTAMP;
+            m_pDevice->CreateQuery(Desc, &Slot.queries.emplace_back());
+        }
+
+        const auto Index = Slot.used_queries++;
+        pContext->EndQuery(Slot.queries[Index]);
+        return Index;
+    }
+
+    size_t begin_gpu_scope(Diligent::IDeviceContext* pContext, const char* Name) {
+        auto& Slot = m_Slots[m_Frame];
+        Slot.scopes.push_back({ Name, next_query(pContext), 0 });
+        return Slot.scopes.size() - 1;
+    }
+
+    void end_gpu_scope(Diligent::IDeviceContext* pContext, size_t Scope) {
+        m_Slots[m_Frame].scopes[Scope].end_query = next_query(pContext);
+    }
+
+    void resolve(frame_slot& Slot) {
+        if (Slot.scopes.empty()) {
+            return;
+        }
+
+        std::vector<Diligent::QueryDataTimestamp> Timestamps(Slot.used_queries);
+        for (Diligent::Uint32 i = 0; i < Slot.used_queries; ++i) {
+            if (!Slot.queries[i]->GetData(&Timestamps[i], sizeof(Diligent::QueryDataTimestamp))) {
+                // Still in flight after readback_latency frames, drop the frame rather than stall.
+                return;
+            }
+        }
+
+        Diligent::Uint64 FrameStart = Timestamps[Slot.scopes.front().begin_query].Counter;
+        for (const auto& Scope : Slot.scopes) {
+            FrameStart = std::min(FrameStart, Timestamps[Scope.begin_query].Counter);
+        }
+
+        for (const auto& Scope : Slot.scopes) {
+            const auto& Begin = Timestamps[Scope.begin_query];
+            const auto& End = Timestamps[Scope.end_query];
+            const double TicksToUs = 1e6 / static_cast<double> (Begin.Frequency);
+
+            add_event(Scope.name, gpu_track, Slot.submit_us + (Begin.Counter - FrameStart) * TicksToUs, (End.Counter - Begin.Counter) * TicksToUs);
+        }
+    }
+
+    Diligent::RefCntAutoPtr<Diligent::IRenderDevice>  m_pDevice;
+    std::array<frame_slot, readback_latency>          m_Slots;
+    Diligent::Uint32                                  m_Frame = 0;
+
+    std::atomic<bool>                                 m_Capturing{ false };
+    std::chrono::steady_clock::time_point             m_Epoch = std::chrono::steady_clock::now();
+
+    mutable std::mutex                                m_EventsMutex;
+    std::vector<trace_event>                          m_Events;
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "DiligentCore/Primitives/interface/BasicTypes.h"
+
+#include "glm/glm.hpp"
+
+#if defined(__AVX__)
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define FRUSTUM_CULLING_SSE2 1
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+// View frustum as six inward facing planes (xyz normal, w distance), extracted from a
+// projection * view matrix the way Gribb and Hartmann describe. Works for glm's default -1..1
+// clip depth and is slightly conservative at the near plane for 0..1 depth.
+struct frustum {
+    std::array<glm::vec4, 6> planes;
+
+    static frustum from_matrix(const glm::mat4& ViewProjection) {
+        const glm::mat4 m = glm::transpose(ViewProjection); // rows of the column major glm matrix
+
+        frustum Result;
+        Result.planes = {
+            m[3] + m[0], // left
+            m[3] - m[0], // right
+            m[3] + m[1], // bottom
+            m[3] - m[1], // top
+            m[3] + m[2], // near
+            m[3] - m[2]  // far
+        };
+        for (auto& Plane : Result.planes) {
+            Plane /= glm::length(glm::vec3(Plane));
+        }
+        return Result;
+    }
+};
+
+// World space bounding boxes stored as structure of arrays, culled against a frustum 8 (AVX) or
+// 4 (SSE2) boxes at a time. A box is visible unless it lies entirely behind one of the planes:
+// for each plane the test is dot(n, center) + dot(|n|, extent) + d < 0 for all lanes at once.
+class aabb_culler {
+public:
+#if defined(__AVX__)
+    static constexpr size_t lane_count = 8;
+#elif FRUSTUM_CULLING_SSE2
+    static constexpr size_t lane_count = 4;
+#else
+    static constexpr size_t lane_count = 1;
+#endif
+
+    void clear() {
+        m_Count = 0;
+    }
+
+    void reserve(size_t Count) {
+        // Whole 32 byte blocks, as aligned_alloc wants and the widest loads read.
+        const size_t Padded = (Count + 7) / 8 * 8;
+        if (Padded <= m_Capacity) {
+            return;
+        }
+
+        auto Grow = [&](aligned_floats& Data) {
+            aligned_floats New{ static_cast<float*> (allocate(Padded)) };
+            std::copy(Data.get(), Data.get() + m_Count, New.get());
+            Data = std::move(New);
+        };
+        for (auto* Data : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ }) {
+            Grow(*Data);
+        }
+        m_Capacity = Padded;
+    }
+
+    void add(const glm::vec3& Center, const glm::vec3& Extent) {
+        if (m_Count == m_Capacity) {
+            reserve(std::max<size_t>(64, m_Capacity * 2));
+        }
+
+        m_CenterX.get()[m_Count] = Center.x;
+        m_CenterY.get()[m_Count] = Center.y;
+        m_CenterZ.get()[m_Count] = Center.z;
+        m_ExtentX.get()[m_Count] = Extent.x;
+        m_ExtentY.get()[m_Count] = Extent.y;
+        m_ExtentZ.get()[m_Count] = Extent.z;
+        ++m_Count;
+    }
+
+    // Adds the world space box around a local box of the given half size transformed by Model.
+    void add(const glm::mat4& Model, const glm::vec3& LocalExtent) {
+        const glm::mat3 Abs = glm::mat3(glm::abs(glm::vec3(Model[0])), glm::abs(glm::vec3(Model[1])), glm::abs(glm::vec3(Model[2])));
+        add(glm::vec3(Model[3]), Abs * LocalExtent);
+    }
+
+    size_t size() const {
+        return m_Count;
+    }
+
+    glm::vec3 center(size_t Index) const {
+        return glm::vec3(m_CenterX.get()[Index], m_CenterY.get()[Index], m_CenterZ.get()[Index]);
+    }
+
+    glm::vec3 extent(size_t Index) const {
+        return glm::vec3(m_ExtentX.get()[Index], m_ExtentY.get()[Index], m_ExtentZ.get()[Index]);
+    }
+
+    // Writes the indices of the boxes that intersect the frustum, in ascending order.
+    void cull(const frustum& Frustum, std::vector<Diligent::Uint32>& Visible) const {
+        Visible.clear();
+        if (m_Count == 0) {
+            return;
+        }
+
+        // The tail of the last batch holds stale boxes, whose lanes are dropped below.
+        const size_t Batches = (m_Count + lane_count - 1) / lane_count;
+        for (size_t Batch = 0; Batch < Batches; ++Batch) {
+            const size_t First = Batch * lane_count;
+            unsigned Mask = cull_batch(Frustum, First);
+            while (Mask != 0) {
+                const unsigned Lane = lowest_bit(Mask);
+                Mask &= Mask - 1;
+                if (First + Lane < m_Count) {
+                    Visible.push_back(static_cast<Diligent::Uint32> (First + Lane));
+                }
+            }
+        }
+    }
+
+private:
+    struct aligned_delete {
+        void operator()(float* p) const {
+#if defined(_MSC_VER)
+            _aligned_free(p);
+#else
+            std::free(p);
+#endif
+        }
+    };
+    using aligned_floats = std::unique_ptr<float[], aligned_delete>;
+
+    static void* allocate(size_t Count) {
+#if defined(_MSC_VER)
+        return _aligned_malloc(Count * sizeof(float), 32);
+#else
+        return std::aligned_alloc(32, Count * sizeof(float));
+#endif
+    }
+
+    static unsigned lowest_bit(unsigned Mask) {
+        unsigned Bit = 0;
+        while ((Mask & 1u) == 0) {
+            Mask >>= 1;
+            ++Bit;
+        }
+        return Bit;
+    }
+
+    // Returns a bit per lane, set when the box in that lane is visible.
+    unsigned cull_batch(const frustum& Frustum, size_t First) const {
+#if defined(__AVX__)
+        const __m256 cx = _mm256_load_ps(m_CenterX.get() + First);
+        const __m256 cy = _mm256_load_ps(m_CenterY.get() + First);
+        const __m256 cz = _mm256_load_ps(m_CenterZ.get() + First);
+        const __m256 ex = _mm256_load_ps(m_ExtentX.get() + First);
+        const __m256 ey = _mm256_load_ps(m_ExtentY.get() + First);
+        const __m256 ez = _mm256_load_ps(m_ExtentZ.get() + First);
+
+        __m256 Outside = _mm256_setzero_ps();
+        for (const auto& Plane : Frustum.planes) {
+            __m256 Distance = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(Plane.x)), _mm256_set1_ps(Plane.w));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(cy, _mm256_set1_ps(Plane.y)));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(cz, _mm256_set1_ps(Plane.z)));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(ex, _mm256_set1_ps(std::abs(Plane.x))));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(ey, _mm256_set1_ps(std::abs(Plane.y))));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(ez, _mm256_set1_ps(std::abs(Plane.z))));
+            Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(Distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        return ~static_cast<unsigned> (_mm256_movemask_ps(Outside)) & 0xFFu;
+#elif FRUSTUM_CULLING_SSE2
+        const __m128 cx = _mm_load_ps(m_CenterX.get() + First);
+        const __m128 cy = _mm_load_ps(m_CenterY.get() + First);
+        const __m128 cz = _mm_load_ps(m_CenterZ.get() + First);
+        const __m128 ex = _mm_load_ps(m_ExtentX.get() + First);
+        const __m128 ey = _mm_load_ps(m_ExtentY.get() + First);
+        const __m128 ez = _mm_load_ps(m_ExtentZ.get() + First);
+
+        __m128 Outside = _mm_setzero_ps();
+        for (const auto& Plane : Frustum.planes) {
+            __m128 Distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(Plane.x)), _mm_set1_ps(Plane.w));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(cy, _mm_set1_ps(Plane.y)));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(cz, _mm_set1_ps(Plane.z)));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(ex, _mm_set1_ps(std::abs(Plane.x))));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(ey, _mm_set1_ps(std::abs(Plane.y))));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(ez, _mm_set1_ps(std::abs(Plane.z))));
+            Outside = _mm_or_ps(Outside, _mm_cmplt_ps(Distance, _mm_setzero_ps()));
+        }
+        return ~static_cast<unsigned> (_mm_movemask_ps(Outside)) & 0xFu;
+#else
+        for (const auto& Plane : Frustum.planes) {
+            const float Distance = m_CenterX.get()[First] * Plane.x + m_CenterY.get()[First] * Plane.y + m_CenterZ.get()[First] * Plane.z + Plane.w +
+                m_ExtentX.get()[First] * std::abs(Plane.x) + m_ExtentY.get()[First] * std::abs(Plane.y) + m_ExtentZ.get()[First] * std::abs(Plane.z);
+            if (Distance < 0.0f) {
+                return 0u;
+            }
+        }
+        return 1u;
+#endif
+    }
+
+    aligned_floats m_CenterX;
+    aligned_floats m_CenterY;
+    aligned_floats m_CenterZ;
+    aligned_floats m_ExtentX;
+    aligned_floats m_ExtentY;
+    aligned_floats m_ExtentZ;
+    size_t         m_Count = 0;
+    size_t         m_Capacity = 0;
+};
@@ -0,0 +1,749 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include "baked_texture.hpp"
+#include "cube_mesh.hpp"
+#include "json.hpp"
+#include "mesh_optimizer.hpp"
+#include "thread_pool.hpp"
+
+#include "glm/glm.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The triangle meshes of a glTF 2.0 file (.gltf with external or embedded buffers, or .glb) in
+// one packed_vertex buffer and one 32-bit index buffer, with a draw per primitive and an
+// instance per primitive of every node in the default scene. Materials, skins, morph targets and
+// animations are not loaded.
+//
+// load() works in stages on a thread pool, writing straight into the arrays create() hands to
+// the device:
+//
+//   1. Buffers: external files are mapped, data URIs base64 decoded, one task per buffer.
+//   2. Indices: one task per primitive decodes them into its slice of the index array, orders
+//      the triangles for the post-transform cache and for overdraw, then renumbers the vertices
+//      in first use order, dropping the unused ones.
+//   3. Vertices: one task per primitive packs them into their new slots of the vertex array.
+//
+// packed_vertex stores positions as snorm16, so each glTF mesh is quantized within its own
+// bounds and the instance transforms scale and offset them back. UVs are unorm16, which would
+// clamp the tiling UVs of real assets to 0..1, so each primitive's UVs are quantized within
+// their own bounds too and primitive::uv_transform maps them back.
+class gltf_model {
+public:
+    // A slice of the vertex and index buffers; the indices count from base_vertex.
+    struct primitive {
+        Diligent::Uint32 first_index = 0;
+        Diligent::Uint32 index_count = 0;
+        Diligent::Uint32 base_vertex = 0;
+        Diligent::Uint32 vertex_count = 0;
+
+        // Decoded UVs * xy + zw gives the file's UVs.
+        glm::vec4        uv_transform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+    };
+
+    // Places a primitive in the world. The transform takes the decoded vertex positions, which
+    // span -0.5..0.5 like cube_mesh's, to world space. Not transposed.
+    struct instance {
+        glm::mat4        transform = glm::mat4(1.0f);
+        Diligent::Uint32 primitive = 0;
+    };
+
+    void load(const std::filesystem::path& Path, thread_pool& Pool) {
+        using namespace Diligent;
+
+        const mapped_file File(Path);
+        std::string_view Text(reinterpret_cast<const char*> (File.data()), File.size());
+        std::vector<buffer> Buffers;
+        const Uint8* pBinaryChunk = nullptr;
+        size_t BinaryChunkSize = 0;
+
+        if (File.size() >= 12 && read<Uint32>(File.data()) == glb_magic) {
+            if (read<Uint32>(File.data() + 4) != 2 || read<Uint32>(File.data() + 8) > File.size()) {
+                throw std::runtime_error(Path.string() + " is not a glTF 2.0 binary.");
+            }
+
+            // A JSON chunk, optionally followed by a binary one that the first buffer refers to.
+            const size_t Length = read<Uint32>(File.data() + 8);
+            size_t Offset = 12;
+            Text = {};
+            while (Offset + 8 <= Length) {
+                const size_t ChunkLength = read<Uint32>(File.data() + Offset);
+                const Uint32 ChunkType = read<Uint32>(File.data() + Offset + 4);
+                if (Offset + 8 + ChunkLength > Length) {
+                    throw std::runtime_error(Path.string() + " has a truncated chunk.");
+                }
+
+                const auto* pChunk = File.data() + Offset + 8;
+                if (ChunkType == glb_json_chunk && Text.empty()) {
+                    Text = std::string_view(reinterpret_cast<const char*> (pChunk), ChunkLength);
+                }
+                else if (ChunkType == glb_binary_chunk && pBinaryChunk == nullptr) {
+                    pBinaryChunk = pChunk;
+                    BinaryChunkSize = ChunkLength;
+                }
+                Offset += 8 + ChunkLength;
+            }
+        }
+
+        const auto Root = json_value::parse(Text);
+        check_version(Root, Path);
+
+        // Stage 1.
+        if (const auto* pBuffers = Root.find("buffers")) {
+            Buffers.resize(pBuffers->size());
+            Pool.run(Buffers.size(), [&](size_t Index) {
+                Buffers[Index] = load_buffer((*pBuffers)[Index], Index, Path, pBinaryChunk, BinaryChunkSize);
+            });
+        }
+
+        const auto Views = parse_buffer_views(Root, Buffers);
+        const auto Accessors = parse_accessors(Root, Views);
+
+        // The triangle list primitives of every mesh and each mesh's bounds, which all of its
+        // primitives are quantized within.
+        std::vector<primitive_source> Sources;
+        std::vector<std::vector<Uint32>> MeshPrimitives;
+        std::vector<glm::mat4> MeshDequantize;
+        if (const auto* pMeshes = Root.find("meshes")) {
+            for (size_t MeshIndex = 0; MeshIndex < pMeshes->size(); ++MeshIndex) {
+                MeshPrimitives.emplace_back();
+                glm::vec3 Min(std::numeric_limits<float>::max());
+                glm::vec3 Max(std::numeric_limits<float>::lowest());
+
+                for (const auto& Primitive : (*pMeshes)[MeshIndex]["primitives"].values()) {
+                    if (Primitive.index_or("mode", triangles_mode) != triangles_mode) {
+                        continue;
+                    }
+
+                    const auto& Attributes = Primitive["attributes"];
+                    primitive_source Source;
+                    Source.positions = &Accessors.at(Attributes["POSITION"].index());
+                    if (const auto* pNormals = Attributes.find("NORMAL")) {
+                        Source.normals = &Accessors.at(pNormals->index());
+                    }
+                    if (const auto* pUVs = Attributes.find("TEXCOORD_0")) {
+                        Source.uvs = &Accessors.at(pUVs->index());
+                    }
+                    if (const auto* pIndices = Primitive.find("indices")) {
+                        Source.indices = &Accessors.at(pIndices->index());
+                    }
+                    Source.mesh = MeshIndex;
+
+                    const size_t VertexCount = Source.positions->count;
+                    const size_t IndexCount = Source.indices != nullptr ? Source.indices->count : VertexCount;
+                    if (Source.positions->components != 3 || !Source.positions->has_bounds ||
+                        (Source.normals != nullptr && (Source.normals->components != 3 || Source.normals->count != VertexCount)) ||
+                        (Source.uvs != nullptr && (Source.uvs->components != 2 || Source.uvs->count != VertexCount)) ||
+                        (Source.indices != nullptr && Source.indices->components != 1) || IndexCount % 3 != 0) {
+                        throw std::runtime_error(Path.string() + " has a malformed primitive in mesh " + std::to_string(MeshIndex) + ".");
+                    }
+                    if (IndexCount == 0) {
+                        continue;
+                    }
+
+                    Min = glm::min(Min, Source.positions->min);
+                    Max = glm::max(Max, Source.positions->max);
+                    MeshPrimitives.back().push_back(static_cast<Uint32> (Sources.size()));
+                    Sources.push_back(Source);
+                }
+
+                // Positions become (p - center) / half_size in -1..1, which the vertex shader
+                // decodes to half that.
+                const glm::vec3 Center = MeshPrimitives.back().empty() ? glm::vec3(0.0f) : (Min + Max) * 0.5f;
+                const float HalfSize = MeshPrimitives.back().empty() ? 1.0f : std::max({ (Max - Min).x, (Max - Min).y, (Max - Min).z, 1e-6f }) * 0.5f;
+                MeshDequantize.push_back(glm::scale(glm::translate(glm::mat4(1.0f), Center), glm::vec3(HalfSize / packed_vertex::position_scale)));
+                for (const auto SourceIndex : MeshPrimitives.back()) {
+                    Sources[SourceIndex].center = Center;
+                    Sources[SourceIndex].inverse_half_size = 1.0f / HalfSize;
+                }
+            }
+        }
+
+        if (Sources.empty()) {
+            throw std::runtime_error(Path.string() + " has no triangles.");
+        }
+
+        m_Primitives.resize(Sources.size());
+        size_t IndexTotal = 0;
+        for (size_t i = 0; i < Sources.size(); ++i) {
+            m_Primitives[i].first_index = static_cast<Uint32> (IndexTotal);
+            m_Primitives[i].index_count = static_cast<Uint32> (Sources[i].indices != nullptr ? Sources[i].indices->count : Sources[i].positions->count);
+            IndexTotal += m_Primitives[i].index_count;
+        }
+        if (IndexTotal > std::numeric_limits<Uint32>::max()) {
+            throw std::runtime_error(Path.string() + " has too many indices.");
+        }
+
+        // Stage 2.
+        m_Indices.resize(IndexTotal);
+        Pool.run(Sources.size(), [&](size_t Index) {
+            auto& Source = Sources[Index];
+            auto& Primitive = m_Primitives[Index];
+            Uint32* pIndices = m_Indices.data() + Primitive.first_index;
+            const size_t VertexCount = Source.positions->count;
+
+            for (Uint32 i = 0; i < Primitive.index_count; ++i) {
+                pIndices[i] = Source.indices != nullptr ? Source.indices->index(i) : i;
+                if (pIndices[i] >= VertexCount) {
+                    throw std::runtime_error(Path.string() + " has an index out of range.");
+                }
+            }
+
+            mesh_optimizer::optimize_vertex_cache(pIndices, Primitive.index_count, VertexCount);
+            mesh_optimizer::optimize_overdraw(pIndices, Primitive.index_count, VertexCount, [&](Uint32 Vertex) {
+                return Source.positions->vec<3>(Vertex);
+            });
+
+            std::vector<Uint32> Remap;
+            Primitive.vertex_count = static_cast<Uint32> (mesh_optimizer::optimize_vertex_fetch_remap(pIndices, Primitive.index_count, VertexCount, Remap));
+            Source.vertices.resize(Primitive.vertex_count);
+            for (size_t Old = 0; Old < VertexCount; ++Old) {
+                if (Remap[Old] != ~0u) {
+                    Source.vertices[Remap[Old]] = static_cast<Uint32> (Old);
+                }
+            }
+
+            // The UV bounds of the vertices kept; accessor min/max are optional for UVs.
+            if (Source.uvs != nullptr && Primitive.vertex_count > 0) {
+                std::array<float, 2> Min = Source.uvs->vec<2>(Source.vertices[0]);
+                std::array<float, 2> Max = Min;
+                for (const auto Old : Source.vertices) {
+                    const auto UV = Source.uvs->vec<2>(Old);
+                    for (size_t k = 0; k < 2; ++k) {
+                        Min[k] = std::min(Min[k], UV[k]);
+                        Max[k] = std::max(Max[k], UV[k]);
+                    }
+                }
+                Primitive.uv_transform = glm::vec4(Max[0] > Min[0] ? Max[0] - Min[0] : 1.0f, Max[1] > Min[1] ? Max[1] - Min[1] : 1.0f, Min[0], Min[1]);
+            }
+        });
+
+        size_t VertexTotal = 0;
+        for (auto& Primitive : m_Primitives) {
+            Primitive.base_vertex = static_cast<Uint32> (VertexTotal);
+            VertexTotal += Primitive.vertex_count;
+        }
+        if (VertexTotal > std::numeric_limits<Uint32>::max()) {
+            throw std::runtime_error(Path.string() + " has too many vertices.");
+        }
+
+        // Stage 3.
+        m_Vertices.resize(VertexTotal);
+        Pool.run(Sources.size(), [&](size_t Index) {
+            const auto& Source = Sources[Index];
+            const auto& Primitive = m_Primitives[Index];
+            const Uint32* pIndices = m_Indices.data() + Primitive.first_index;
+
+            // Without normals the mesh is shaded smooth, with area weighted face normals.
+            std::vector<glm::vec3> Normals;
+            if (Source.normals == nullptr) {
+                Normals.assign(Primitive.vertex_count, glm::vec3(0.0f));
+                for (Uint32 i = 0; i < Primitive.index_count; i += 3) {
+                    const auto p0 = Source.position(pIndices[i]);
+                    const auto Normal = glm::cross(Source.position(pIndices[i + 1]) - p0, Source.position(pIndices[i + 2]) - p0);
+                    for (Uint32 k = 0; k < 3; ++k) {
+                        Normals[pIndices[i + k]] += Normal;
+                    }
+                }
+            }
+
+            for (Uint32 Vertex = 0; Vertex < Primitive.vertex_count; ++Vertex) {
+                const Uint32 Old = Source.vertices[Vertex];
+                const glm::vec3 Position = (Source.positions->vec3(Old) - Source.center) * Source.inverse_half_size * packed_vertex::position_scale;
+
+                glm::vec3 Normal = Source.normals != nullptr ? Source.normals->vec3(Old) : Normals[Vertex];
+                const float Length = glm::length(Normal);
+                Normal = Length > 0.0f ? Normal / Length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+                std::array<float, 2> UV = {};
+                if (Source.uvs != nullptr) {
+                    UV = Source.uvs->vec<2>(Old);
+                    UV[0] = (UV[0] - Primitive.uv_transform.z) / Primitive.uv_transform.x;
+                    UV[1] = (UV[1] - Primitive.uv_transform.w) / Primitive.uv_transform.y;
+                }
+                m_Vertices[Primitive.base_vertex + Vertex] = packed_vertex::pack({ Position.x, Position.y, Position.z }, { Normal.x, Normal.y, Normal.z }, UV);
+            }
+        });
+
+        create_instances(Root, MeshPrimitives, MeshDequantize, Path);
+    }
+
+    // The device copies the arrays load() filled, which are released afterwards.
+    void create(Diligent::IRenderDevice* pDevice) {
+        using namespace Diligent;
+
+        BufferDesc VertBuffDesc;
+        VertBuffDesc.Name = "glTF vertex buffer";
+        VertBuffDesc.Usage = USAGE_IMMUTABLE;
+        VertBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
+        VertBuffDesc.Size = m_Vertices.size() * sizeof(packed_vertex);
+        BufferData VBData{ m_Vertices.data(), VertBuffDesc.Size };
+        pDevice->CreateBuffer(VertBuffDesc, &VBData, &m_pVertexBuffer);
+
+        BufferDesc IndBuffDesc;
+        IndBuffDesc.Name = "glTF index buffer";
+        IndBuffDesc.Usage = USAGE_IMMUTABLE;
+        IndBuffDesc.BindFlags = BIND_INDEX_BUFFER;
+        IndBuffDesc.Size = m_Indices.size() * sizeof(Uint32);
+        BufferData IBData{ m_Indices.data(), IndBuffDesc.Size };
+        pDevice->CreateBuffer(IndBuffDesc, &IBData, &m_pIndexBuffer);
+
+        if (!m_pVertexBuffer || !m_pIndexBuffer) {
+            throw std::runtime_error("Failed to create the glTF buffers.");
+        }
+
+        m_Vertices = {};
+        m_Indices = {};
+    }
+
+    // Same transition modes as cube_mesh::bind.
+    void bind(Diligent::IDeviceContext* pContext, Diligent::RESOURCE_STATE_TRANSITION_MODE Mode = Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION) const {
+        using namespace Diligent;
+
+        const Uint64 Offset = 0;
+        IBuffer* pBuffs[] = { m_pVertexBuffer };
+        pContext->SetVertexBuffers(0, 1, pBuffs, &Offset, Mode, SET_VERTEX_BUFFERS_FLAG_RESET);
+        pContext->SetIndexBuffer(m_pIndexBuffer, 0, Mode);
+    }
+
+    Diligent::DrawIndexedAttribs draw_attribs(Diligent::Uint32 Primitive) const {
+        Diligent::DrawIndexedAttribs DrawAttrs;
+        DrawAttrs.NumIndices = m_Primitives[Primitive].index_count;
+        DrawAttrs.IndexType = Diligent::VT_UINT32;
+        DrawAttrs.FirstIndexLocation = m_Primitives[Primitive].first_index;
+        DrawAttrs.BaseVertex = m_Primitives[Primitive].base_vertex;
+        DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
+        return DrawAttrs;
+    }
+
+    const std::vector<primitive>& primitives() const {
+        return m_Primitives;
+    }
+
+    const std::vector<instance>& instances() const {
+        return m_Instances;
+    }
+
+    // Triangles drawn when every instance is.
+    size_t triangle_count() const {
+        size_t Count = 0;
+        for (const auto& Instance : m_Instances) {
+            Count += m_Primitives[Instance.primitive].index_count / 3;
+        }
+        return Count;
+    }
+
+    Diligent::IBuffer* vertex_buffer() const {
+        return m_pVertexBuffer;
+    }
+
+    Diligent::IBuffer* index_buffer() const {
+        return m_pIndexBuffer;
+    }
+
+private:
+    static constexpr Diligent::Uint32 glb_magic = 0x46546C67;        // "glTF"
+    static constexpr Diligent::Uint32 glb_json_chunk = 0x4E4F534A;   // "JSON"
+    static constexpr Diligent::Uint32 glb_binary_chunk = 0x004E4942; // "BIN\0"
+    static constexpr size_t triangles_mode = 4;
+
+    // A file mapping or a decoded data URI.
+    struct buffer {
+        std::unique_ptr<mapped_file>  file;
+        std::vector<Diligent::Uint8>  decoded;
+        const Diligent::Uint8*        data = nullptr;
+        size_t                        size = 0;
+    };
+
+    struct buffer_view {
+        const Diligent::Uint8* data = nullptr;
+        size_t                 size = 0;
+        size_t                 stride = 0;
+    };
+
+    // An accessor resolved to a pointer; one without a buffer view reads as zeros.
+    struct accessor {
+        const Diligent::Uint8* data = nullptr;
+        size_t                 count = 0;
+        size_t                 stride = 0;
+        size_t                 components = 0;
+        Diligent::Uint32       component_type = 0;
+        bool                   normalized = false;
+        bool                   has_bounds = false;
+        glm::vec3              min = glm::vec3(0.0f);
+        glm::vec3              max = glm::vec3(0.0f);
+
+        float component(size_t Element, size_t Component) const {
+            if (data == nullptr) {
+                return 0.0f;
+            }
+
+            const auto* p = data + Element * stride + Component * component_size(component_type);
+            switch (component_type) {
+            case 5120: return normalized ? std::max(read<Diligent::Int8>(p) / 127.0f, -1.0f) : read<Diligent::Int8>(p);
+            case 5121: return normalized ? read<Diligent::Uint8>(p) / 255.0f : read<Diligent::Uint8>(p);
+            case 5122: return normalized ? std::max(read<Diligent::Int16>(p) / 32767.0f, -1.0f) : read<Diligent::Int16>(p);
+            case 5123: return normalized ? read<Diligent::Uint16>(p) / 65535.0f : read<Diligent::Uint16>(p);
+            case 5125: return static_cast<float> (read<Diligent::Uint32>(p));
+            default:   return read<float>(p);
+            }
+        }
+
+        template <size_t Count>
+        std::array<float, Count> vec(size_t Element) const {
+            std::array<float, Count> Result;
+            for (size_t i = 0; i < Count; ++i) {
+                Result[i] = component(Element, i);
+            }
+            return Result;
+        }
+
+        glm::vec3 vec3(size_t Element) const {
+            return glm::vec3(component(Element, 0), component(Element, 1), component(Element, 2));
+        }
+
+        Diligent::Uint32 index(size_t Element) const {
+            if (data == nullptr) {
+                return 0;
+            }
+
+            const auto* p = data + Element * stride;
+            switch (component_type) {
+            case 5121: return read<Diligent::Uint8>(p);
+            case 5123: return read<Diligent::Uint16>(p);
+            default:   return read<Diligent::Uint32>(p);
+            }
+        }
+    };
+
+    // A triangle list primitive as found in the file, and what the stages learn about it.
+    struct primitive_source {
+        const accessor*               positions = nullptr;
+        const accessor*               normals = nullptr;
+        const accessor*               uvs = nullptr;
+        const accessor*               indices = nullptr;
+        size_t                        mesh = 0;
+        glm::vec3                     center = glm::vec3(0.0f);
+        float                         inverse_half_size = 1.0f;
+        std::vector<Diligent::Uint32> vertices; // source vertex of each new vertex
+
+        glm::vec3 position(Diligent::Uint32 Vertex) const {
+            return positions->vec3(vertices[Vertex]);
+        }
+    };
+
+    template <typename Value>
+    static Value read(const Diligent::Uint8* p) {
+        Value Result;
+        std::memcpy(&Result, p, sizeof(Result));
+        return Result;
+    }
+
+    static size_t component_size(Diligent::Uint32 ComponentType) {
+        switch (ComponentType) {
+        case 5120:
+        case 5121: return 1;
+        case 5122:
+        case 5123: return 2;
+        case 5125:
+        case 5126: return 4;
+        default:   return 0;
+        }
+    }
+
+    static size_t component_count(const std::string& Type) {
+        if (Type == "SCALAR") return 1;
+        if (Type == "VEC2")   return 2;
+        if (Type == "VEC3")   return 3;
+        if (Type == "VEC4")   return 4;
+        if (Type == "MAT2")   return 4;
+        if (Type == "MAT3")   return 9;
+        if (Type == "MAT4")   return 16;
+        return 0;
+    }
+
+    static void check_version(const json_value& Root, const std::filesystem::path& Path) {
+        const auto& Version = Root["asset"]["version"].string();
+        if (Version.rfind("2.", 0) != 0) {
+            throw std::runtime_error(Path.string() + " is glTF " + Version + ", not 2.x.");
+        }
+
+        // Compressed geometry (Draco, meshopt) and the like can't be read without the extension.
+        if (const auto* pRequired = Root.find("extensionsRequired"); pRequired != nullptr && pRequired->size() > 0) {
+            throw std::runtime_error(Path.string() + " requires the unsupported extension " + (*pRequired)[0].string() + ".");
+        }
+    }
+
+    static buffer load_buffer(const json_value& Desc, size_t Index, const std::filesystem::path& Path, const Diligent::Uint8* pBinaryChunk, size_t BinaryChunkSize) {
+        buffer Buffer;
+        const size_t Length = Desc["byteLength"].index();
+        const auto* pUri = Desc.find("uri");
+
+        if (pUri == nullptr) {
+            if (Index != 0 || pBinaryChunk == nullptr) {
+                throw std::runtime_error(Path.string() + " has a buffer without data.");
+            }
+            Buffer.data = pBinaryChunk;
+            Buffer.size = BinaryChunkSize;
+        }
+        else if (const auto& Uri = pUri->string(); Uri.rfind("data:", 0) == 0) {
+            const auto Comma = Uri.find(',');
+            if (Comma == std::string::npos || Uri.rfind(";base64", Comma) == std::string::npos) {
+                throw std::runtime_error(Path.string() + " has a data URI that is not base64.");
+            }
+            Buffer.decoded = decode_base64(std::string_view(Uri).substr(Comma + 1));
+            Buffer.data = Buffer.decoded.data();
+            Buffer.size = Buffer.decoded.size();
+        }
+        else {
+            const auto Name = decode_uri(Uri);
+            Buffer.file = std::make_unique<mapped_file>(Path.parent_path() / std::filesystem::path(std::u8string(Name.begin(), Name.end())));
+            Buffer.data = Buffer.file->data();
+            Buffer.size = Buffer.file->size();
+        }
+
+        if (Buffer.size < Length) {
+            throw std::runtime_error(Path.string() + " has a buffer shorter than its byteLength.");
+        }
+        Buffer.size = Length;
+        return Buffer;
+    }
+
+    static std::vector<buffer_view> parse_buffer_views(const json_value& Root, const std::vector<buffer>& Buffers) {
+        std::vector<buffer_view> Views;
+        if (const auto* pViews = Root.find("bufferViews")) {
+            for (const auto& Desc : pViews->values()) {
+                const auto& Buffer = Buffers.at(Desc["buffer"].index());
+                const size_t Offset = Desc.index_or("byteOffset", 0);
+                const size_t Length = Desc["byteLength"].index();
+                if (Offset > Buffer.size || Length > Buffer.size - Offset) {
+                    throw std::runtime_error("glTF buffer view out of range.");
+                }
+                Views.push_back({ Buffer.data + Offset, Length, Desc.index_or("byteStride", 0) });
+            }
+        }
+        return Views;
+    }
+
+    static std::vector<accessor> parse_accessors(const json_value& Root, const std::vector<buffer_view>& Views) {
+        std::vector<accessor> Accessors;
+        if (const auto* pAccessors = Root.find("accessors")) {
+            for (const auto& Desc : pAccessors->values()) {
+                if (Desc.find("sparse") != nullptr) {
+                    throw std::runtime_error("Sparse glTF accessors are not supported.");
+                }
+
+                accessor Accessor;
+                Accessor.count = Desc["count"].index();
+                Accessor.component_type = static_cast<Diligent::Uint32> (Desc["componentType"].index());
+                Accessor.components = component_count(Desc["type"].string());
+                if (const auto* pNormalized = Desc.find("normalized")) {
+                    Accessor.normalized = pNormalized->boolean();
+                }
+
+                const size_t ElementSize = component_size(Accessor.component_type) * Accessor.components;
+                if (ElementSize == 0) {
+                    throw std::runtime_error("glTF accessor of unknown type.");
+                }
+
+                if (const auto* pView = Desc.find("bufferView")) {
+                    const auto& View = Views.at(pView->index());
+                    const size_t Offset = Desc.index_or("byteOffset", 0);
+                    Accessor.stride = View.stride != 0 ? View.stride : ElementSize;
+                    if (Accessor.count > 0 && (Offset > View.size || (Accessor.count - 1) * Accessor.stride + ElementSize > View.size - Offset)) {
+                        throw std::runtime_error("glTF accessor out of range.");
+                    }
+                    Accessor.data = View.data + Offset;
+                }
+
+                const auto* pMin = Desc.find("min");
+                const auto* pMax = Desc.find("max");
+                if (pMin != nullptr && pMax != nullptr && pMin->size() >= 3 && pMax->size() >= 3) {
+                    Accessor.has_bounds = true;
+                    for (glm::length_t i = 0; i < 3; ++i) {
+                        Accessor.min[i] = static_cast<float> ((*pMin)[i].number());
+                        Accessor.max[i] = static_cast<float> ((*pMax)[i].number());
+                    }
+                }
+                Accessors.push_back(Accessor);
+            }
+        }
+        return Accessors;
+    }
+
+    // An instance for each primitive of each node with a mesh, in the default scene or, in a file
+    // without scenes, under every root node. A file without nodes shows each mesh once.
+    void create_instances(const json_value& Root, const std::vector<std::vector<Diligent::Uint32>>& MeshPrimitives, const std::vector<glm::mat4>& MeshDequantize, const std::filesystem::path& Path) {
+        m_Instances.clear();
+
+        const auto add_mesh = [&](size_t Mesh, const glm::mat4& World) {
+            for (const auto Primitive : MeshPrimitives.at(Mesh)) {
+                m_Instances.push_back({ World * MeshDequantize[Mesh], Primitive });
+            }
+        };
+
+        const auto* pNodes = Root.find("nodes");
+        if (pNodes == nullptr) {
+            for (size_t Mesh = 0; Mesh < MeshPrimitives.size(); ++Mesh) {
+                add_mesh(Mesh, glm::mat4(1.0f));
+            }
+            return;
+        }
+
+        std::vector<size_t> Roots;
+        const auto* pScenes = Root.find("scenes");
+        if (pScenes != nullptr && pScenes->size() > 0) {
+            if (const auto* pSceneNodes = (*pScenes)[Root.index_or("scene", 0)].find("nodes")) {
+                for (const auto& Node : pSceneNodes->values()) {
+                    Roots.push_back(Node.index());
+                }
+            }
+        }
+        else {
+            std::vector<bool> IsChild(pNodes->size(), false);
+            for (const auto& Node : pNodes->values()) {
+                if (const auto* pChildren = Node.find("children")) {
+                    for (const auto& Child : pChildren->values()) {
+                        IsChild.at(Child.index()) = true;
+                    }
+                }
+            }
+            for (size_t Node = 0; Node < IsChild.size(); ++Node) {
+                if (!IsChild[Node]) {
+                    Roots.push_back(Node);
+                }
+            }
+        }
+
+        // Nodes form trees, so a node seen twice means a malformed file rather than a shared one.
+        std::vector<bool> Visited(pNodes->size(), false);
+        std::vector<std::pair<size_t, glm::mat4>> Stack;
+        for (const auto Node : Roots) {
+            Stack.emplace_back(Node, glm::mat4(1.0f));
+        }
+        while (!Stack.empty()) {
+            const auto [NodeIndex, Parent] = Stack.back();
+            Stack.pop_back();
+            if (NodeIndex >= pNodes->size() || Visited[NodeIndex]) {
+                throw std::runtime_error(Path.string() + " has a malformed node hierarchy.");
+            }
+            Visited[NodeIndex] = true;
+
+            const auto& Node = (*pNodes)[NodeIndex];
+            const glm::mat4 World = Parent * local_transform(Node);
+            if (const auto* pMesh = Node.find("mesh")) {
+                add_mesh(pMesh->index(), World);
+            }
+            if (const auto* pChildren = Node.find("children")) {
+                for (const auto& Child : pChildren->values()) {
+                    Stack.emplace_back(Child.index(), World);
+                }
+            }
+        }
+    }
+
+    // A column major matrix, or translation * rotation * scale with an xyzw quaternion.
+    static glm::mat4 local_transform(const json_value& Node) {
+        const auto numbers = [](const json_value& Array, float* pOut, size_t Count) {
+            if (Array.size() != Count) {
+                throw std::runtime_error("glTF node transform of the wrong size.");
+            }
+            for (size_t i = 0; i < Count; ++i) {
+                pOut[i] = static_cast<float> (Array[i].number());
+            }
+        };
+
+        if (const auto* pMatrix = Node.find("matrix")) {
+            float Matrix[16];
+            numbers(*pMatrix, Matrix, 16);
+            return glm::make_mat4(Matrix);
+        }
+
+        glm::vec3 Translation(0.0f);
+        glm::vec4 Rotation(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec3 Scale(1.0f);
+        if (const auto* pTranslation = Node.find("translation")) {
+            numbers(*pTranslation, glm::value_ptr(Translation), 3);
+        }
+        if (const auto* pRotation = Node.find("rotation")) {
+            numbers(*pRotation, glm::value_ptr(Rotation), 4);
+        }
+        if (const auto* pScale = Node.find("scale")) {
+            numbers(*pScale, glm::value_ptr(Scale), 3);
+        }
+
+        const glm::quat Orientation(Rotation.w, Rotation.x, Rotation.y, Rotation.z);
+        return glm::scale(glm::translate(glm::mat4(1.0f), Translation) * glm::mat4_cast(Orientation), Scale);
+    }
+
+    static std::vector<Diligent::Uint8> decode_base64(std::string_view Text) {
+        const auto value = [](char c) -> int {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+' || c == '-') return 62;
+            if (c == '/' || c == '_') return 63;
+            return -1;
+        };
+
+        std::vector<Diligent::Uint8> Data;
+        Data.reserve(Text.size() / 4 * 3);
+        Diligent::Uint32 Bits = 0;
+        int BitCount = 0;
+        for (const char c : Text) {
+            if (c == '=') {
+                break;
+            }
+            const int Value = value(c);
+            if (Value < 0) {
+                throw std::runtime_error("Invalid base64 in a glTF data URI.");
+            }
+            Bits = (Bits << 6) | static_cast<Diligent::Uint32> (Value);
+            BitCount += 6;
+            if (BitCount >= 8) {
+                BitCount -= 8;
+                Data.push_back(static_cast<Diligent::Uint8> (Bits >> BitCount));
+            }
+        }
+        return Data;
+    }
+
+    // URIs in glTF are percent encoded; file names with spaces are common.
+    static std::string decode_uri(const std::string& Uri) {
+        std::string Result;
+        for (size_t i = 0; i < Uri.size(); ++i) {
+            if (Uri[i] == '%' && i + 2 < Uri.size()) {
+                Result.push_back(static_cast<char> (std::stoi(Uri.substr(i + 1, 2), nullptr, 16)));
+                i += 2;
+            }
+            else {
+                Result.push_back(Uri[i]);
+            }
+        }
+        return Result;
+    }
+
+    std::vector<packed_vertex>                  m_Vertices;
+    std::vector<Diligent::Uint32>               m_Indices;
+    std::vector<primitive>                      m_Primitives;
+    std::vector<instance>                       m_Instances;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer> m_pVertexBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer> m_pIndexBuffer;
+};
@@ -0,0 +1,424 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/Fence.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// How finished frames reach the screen. Diligent picks the Vulkan present mode from the sync
+// interval passed to Present and offers no way to ask for one directly: 1 is FIFO, and 0 takes
+// mailbox where the surface supports it and immediate otherwise. Those are the only two choices.
+enum class present_mode {
+    fifo,     // wait for vblank, never tear
+    uncapped, // mailbox, which never tears, or immediate, which may, on surfaces without mailbox
+};
+
+inline const char* present_mode_name(present_mode Mode) {
+    switch (Mode) {
+    case present_mode::fifo:     return "fifo";
+    case present_mode::uncapped: return "uncapped";
+    }
+    return "unknown";
+}
+
+inline present_mode parse_present_mode(std::string_view Name) {
+    for (const auto Mode : { present_mode::fifo, present_mode::uncapped }) {
+        if (Name == present_mode_name(Mode)) {
+            return Mode;
+        }
+    }
+    throw std::runtime_error("Unknown present mode " + std::string(Name) + ", expected fifo or uncapped.");
+}
+
+inline present_mode next_present_mode(present_mode Mode) {
+    return Mode == present_mode::fifo ? present_mode::uncapped : present_mode::fifo;
+}
+
+// Command line switches shared by every sample.
+//
+//   --headless            render offscreen without creating a window
+//   --frames N            number of frames to render before exiting in headless mode
+//   --width W             back buffer width
+//   --height H            back buffer height
+//   --trace FILE          profile the whole run and write a Chrome trace to FILE; samples
+//                         without the frame profiler reject it
+//   --present-mode M      fifo (default) or uncapped
+//   --fps-limit N         cap the windowed frame rate at N frames per second, 0 (default) for no cap
+//   --frames-in-flight N  frames the CPU may queue ahead of the GPU, 2 by default
+//   --benchmark FILE      fly a scripted camera on a fixed clock for --frames frames and write
+//                         frame time statistics to FILE, where supported (Common/benchmark.hpp)
+//   --warmup N            frames left out of the benchmark statistics, 60 by default
+//   --draw-mode M         per-draw, instanced or gpu-driven, where supported
+//   --containers N        number of containers to draw, where supported
+//   --no-occlusion-culling  skip the Hi-Z occlusion test of GPU-driven drawing, where supported
+//   --model FILE          draw the meshes of a glTF 2.0 file (.gltf or .glb) as well, where supported
+struct launch_options {
+    bool headless = false;
+    Diligent::Uint32 frame_count = 300;
+    Diligent::Uint32 width = 800;
+    Diligent::Uint32 height = 600;
+    std::string trace_path;
+    present_mode present = present_mode::fifo;
+    Diligent::Uint32 fps_limit = 0;
+    Diligent::Uint32 frames_in_flight = 2;
+    std::string benchmark_path;
+    Diligent::Uint32 benchmark_warmup = 60;
+    std::string draw_mode;
+    Diligent::Uint32 container_count = 0;
+    bool occlusion_culling = true;
+    std::string model_path;
+
+    // HasProfiler is for samples that record with frame_profiler and can honor --trace.
+    static launch_options parse(int argc, char** argv, bool HasProfiler = false) {
+        launch_options Options;
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg = argv[i];
+
+            const auto text = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Missing value for " + std::string(arg) + ".");
+                }
+                return argv[++i];
+            };
+            const auto value = [&]() {
+                return static_cast<Diligent::Uint32> (std::stoul(text()));
+            };
+
+            if (arg == "--headless")
+                Options.headless = true;
+            else if (arg == "--frames")
+                Options.frame_count = value();
+            else if (arg == "--width")
+                Options.width = value();
+            else if (arg == "--height")
+                Options.height = value();
+            else if (arg == "--trace")
+                Options.trace_path = text();
+            else if (arg == "--present-mode")
+                Options.present = parse_present_mode(text());
+            else if (arg == "--fps-limit")
+                Options.fps_limit = value();
+            else if (arg == "--frames-in-flight")
+                Options.frames_in_flight = value();
+            else if (arg == "--benchmark")
+                Options.benchmark_path = text();
+            else if (arg == "--warmup")
+                Options.benchmark_warmup = value();
+            else if (arg == "--draw-mode")
+                Options.draw_mode = text();
+            else if (arg == "--containers")
+                Options.container_count = value();
+            else if (arg == "--no-occlusion-culling")
+                Options.occlusion_culling = false;
+            else if (arg == "--model")
+                Options.model_path = text();
+            else
+                throw std::runtime_error("Unknown argument " + std::string(arg) + ".");
+        }
+
+        if (Options.frames_in_flight == 0) {
+            throw std::runtime_error("--frames-in-flight must be at least 1.");
+        }
+        if (!Options.trace_path.empty() && !HasProfiler) {
+            throw std::runtime_error("--trace isn't supported by this sample, which has no frame profiler; LightCasters has one.");
+        }
+
+        return Options;
+    }
+};
+
+// Where a sample draws its frames: the window swap chain, or an offscreen color/depth texture
+// pair created from the same SwapChainDesc when running headless. Headless needs no surface or
+// present support, so it runs on display-less machines and software ICDs such as lavapipe.
+//
+// Either way a fence signalled at the end of every frame keeps the CPU at most frames_in_flight
+// frames ahead of the GPU; fewer frames in flight trade throughput for input latency.
+class render_target {
+public:
+    void create_swap_chain(Diligent::IEngineFactoryVk& Factory, Diligent::IRenderDevice* pDevice, Diligent::IDeviceContext* pContext, const Diligent::SwapChainDesc& Desc, const Diligent::NativeWindow& Window, const launch_options& Options) {
+        // Room for every frame in flight plus the one on screen, so an uncapped (mailbox) swap chain
+        // always has a queued image to replace.
+        auto SCDesc = Desc;
+        SCDesc.BufferCount = std::max(SCDesc.BufferCount, Options.frames_in_flight + 1);
+        if (m_ReadableDepth) {
+            SCDesc.DepthBufferFormat = Diligent::TEX_FORMAT_UNKNOWN;
+        }
+
+        Factory.CreateSwapChainVk(pDevice, pContext, SCDesc, Window, &m_pSwapChain);
+        if (!m_pSwapChain) {
+            throw std::runtime_error("Failed to create the swap chain.");
+        }
+
+        create_frame_fence(pDevice, pContext, Options);
+        if (m_ReadableDepth) {
+            m_Desc = m_pSwapChain->GetDesc();
+            m_Desc.DepthBufferFormat = Desc.DepthBufferFormat;
+            create_depth_texture();
+        }
+    }
+
+    void create_offscreen(Diligent::IRenderDevice* pDevice, Diligent::IDeviceContext* pContext, const Diligent::SwapChainDesc& Desc, const launch_options& Options) {
+        m_Desc = Desc;
+        create_frame_fence(pDevice, pContext, Options);
+        create_offscreen_textures();
+    }
+
+    // The swap chain's own depth buffer only binds as a depth target. With this set before
+    // create_swap_chain() or create_offscreen(), the depth buffer is a texture of the render
+    // target's own in both cases, which shaders can also read through depth_buffer_srv().
+    void set_readable_depth(bool Readable) {
+        m_ReadableDepth = Readable;
+    }
+
+    void resize(Diligent::Uint32 Width, Diligent::Uint32 Height) {
+        if (m_pSwapChain) {
+            m_pSwapChain->Resize(Width, Height);
+            if (m_pDepth) {
+                const auto DepthFormat = m_Desc.DepthBufferFormat;
+                m_Desc = m_pSwapChain->GetDesc();
+                m_Desc.DepthBufferFormat = DepthFormat;
+                const auto& DepthDesc = m_pDepth->GetDesc();
+                if (DepthDesc.Width != m_Desc.Width || DepthDesc.Height != m_Desc.Height) {
+                    create_depth_texture();
+                }
+            }
+        }
+        else if (m_pColor && (Width != m_Desc.Width || Height != m_Desc.Height)) {
+            m_Desc.Width = Width;
+            m_Desc.Height = Height;
+            create_offscreen_textures();
+        }
+    }
+
+    Diligent::ITextureView* back_buffer_rtv() const {
+        return m_pSwapChain ? m_pSwapChain->GetCurrentBackBufferRTV() : m_pColor->GetDefaultView(Diligent::TEXTURE_VIEW_RENDER_TARGET);
+    }
+
+    Diligent::ITextureView* depth_buffer_dsv() const {
+        return m_pDepth ? m_pDepth->GetDefaultView(Diligent::TEXTURE_VIEW_DEPTH_STENCIL) : m_pSwapChain->GetDepthBufferDSV();
+    }
+
+    // Null unless set_readable_depth() was called.
+    Diligent::ITextureView* depth_buffer_srv() const {
+        return m_ReadableDepth ? m_pDepth->GetDefaultView(Diligent::TEXTURE_VIEW_SHADER_RESOURCE) : nullptr;
+    }
+
+    // With a depth texture of its own, the swap chain's description with that texture's format.
+    const Diligent::SwapChainDesc& desc() const {
+        return m_pSwapChain && !m_pDepth ? m_pSwapChain->GetDesc() : m_Desc;
+    }
+
+    // Offscreen there is no Present to end the frame, so this does the part of it that matters:
+    // submit and let the engine recycle per-frame memory. Then waits until no more than
+    // frames_in_flight frames are queued on the GPU.
+    void present() {
+        ++m_FrameIndex;
+        m_pContext->EnqueueSignal(m_pFence, m_FrameIndex);
+
+        if (m_pSwapChain) {
+            m_pSwapChain->Present(m_PresentMode == present_mode::fifo ? 1 : 0);
+        }
+        else {
+            m_pContext->Flush();
+            m_pContext->FinishFrame();
+            m_pDevice->ReleaseStaleResources();
+        }
+
+        if (m_FrameIndex > m_FramesInFlight) {
+            m_pFence->Wait(m_FrameIndex - m_FramesInFlight);
+        }
+    }
+
+    bool offscreen() const {
+        return !m_pSwapChain;
+    }
+
+    // Takes effect at the next present; switching between FIFO and uncapped recreates the swap
+    // chain. Offscreen frames are never presented, so there it only changes what is reported.
+    void set_present_mode(present_mode Mode) {
+        m_PresentMode = Mode;
+    }
+
+    present_mode current_present_mode() const {
+        return m_PresentMode;
+    }
+
+    Diligent::Uint32 frames_in_flight() const {
+        return static_cast<Diligent::Uint32> (m_FramesInFlight);
+    }
+
+private:
+    void create_frame_fence(Diligent::IRenderDevice* pDevice, Diligent::IDeviceContext* pContext, const launch_options& Options) {
+        using namespace Diligent;
+
+        m_pDevice = pDevice;
+        m_pContext = pContext;
+        m_PresentMode = Options.present;
+        m_FramesInFlight = Options.frames_in_flight;
+
+        FenceDesc FenceCI;
+        FenceCI.Name = "Frame fence";
+        m_pDevice->CreateFence(FenceCI, &m_pFence);
+    }
+
+    void create_offscreen_textures() {
+        using namespace Diligent;
+
+        TextureDesc TexDesc;
+        TexDesc.Type = RESOURCE_DIM_TEX_2D;
+        TexDesc.Width = m_Desc.Width;
+        TexDesc.Height = m_Desc.Height;
+
+        TexDesc.Name = "Offscreen color buffer";
+        TexDesc.Format = m_Desc.ColorBufferFormat;
+        TexDesc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+        m_pColor.Release();
+        m_pDevice->CreateTexture(TexDesc, nullptr, &m_pColor);
+        if (!m_pColor) {
+            throw std::runtime_error("Failed to create the offscreen render target.");
+        }
+
+        create_depth_texture();
+    }
+
+    void create_depth_texture() {
+        using namespace Diligent;
+
+        TextureDesc TexDesc;
+        TexDesc.Name = "Depth buffer";
+        TexDesc.Type = RESOURCE_DIM_TEX_2D;
+        TexDesc.Width = m_Desc.Width;
+        TexDesc.Height = m_Desc.Height;
+        TexDesc.Format = m_Desc.DepthBufferFormat;
+        TexDesc.BindFlags = m_ReadableDepth ? BIND_DEPTH_STENCIL | BIND_SHADER_RESOURCE : BIND_DEPTH_STENCIL;
+        m_pDepth.Release();
+        m_pDevice->CreateTexture(TexDesc, nullptr, &m_pDepth);
+        if (!m_pDepth) {
+            throw std::runtime_error("Failed to create the depth buffer.");
+        }
+    }
+
+    Diligent::RefCntAutoPtr<Diligent::ISwapChain>     m_pSwapChain;
+
+    Diligent::RefCntAutoPtr<Diligent::IRenderDevice>  m_pDevice;
+    Diligent::RefCntAutoPtr<Diligent::IDeviceContext> m_pContext;
+    Diligent::RefCntAutoPtr<Diligent::ITexture>       m_pColor;
+    Diligent::RefCntAutoPtr<Diligent::ITexture>       m_pDepth;
+    Diligent::RefCntAutoPtr<Diligent::IFence>         m_pFence;
+    Diligent::SwapChainDesc                           m_Desc;
+    Diligent::Uint64                                  m_FrameIndex = 0;
+    Diligent::Uint64                                  m_FramesInFlight = 2;
+    present_mode                                      m_PresentMode = present_mode::fifo;
+    bool                                              m_ReadableDepth = false;
+};
+
+// Paces the main loop. Windowed it runs until the window closes and reports GLFW time; headless
+// and benchmark runs stop after the requested frame count and step time by a fixed 1/60 s, so a
+// batch run renders the same frames regardless of how fast the device is.
+//
+// With --fps-limit, windowed frames start at most fps_limit times a second. The wait happens at
+// the start of the frame rather than after present, so the input read right after begin_frame is
+// as fresh as it can be when the frame is submitted.
+class frame_loop {
+public:
+    static constexpr double headless_frame_time = 1.0 / 60.0;
+
+    using clock = std::chrono::steady_clock;
+
+    explicit frame_loop(const launch_options& Options)
+        : m_Headless(Options.headless)
+        , m_FixedClock(Options.headless || !Options.benchmark_path.empty())
+        , m_FrameCount(Options.frame_count) {
+        set_fps_limit(Options.fps_limit);
+    }
+
+    // Returns false once the sample should exit.
+    bool begin_frame(GLFWwindow* window) {
+        if (m_Headless) {
+            if (m_FrameIndex == m_FrameCount) {
+                return false;
+            }
+            ++m_FrameIndex;
+            return true;
+        }
+
+        wait_for_frame_start();
+
+        if (m_FixedClock && m_FrameIndex == m_FrameCount) {
+            return false;
+        }
+        ++m_FrameIndex;
+        return !glfwWindowShouldClose(window);
+    }
+
+    double time() const {
+        return m_FixedClock ? m_FrameIndex * headless_frame_time : glfwGetTime();
+    }
+
+    // Whether time() steps by headless_frame_time per frame rather than following the wall clock.
+    bool fixed_clock() const {
+        return m_FixedClock;
+    }
+
+    Diligent::Uint32 frame_index() const {
+        return m_FrameIndex;
+    }
+
+    // 0 removes the cap.
+    void set_fps_limit(Diligent::Uint32 FramesPerSecond) {
+        m_FpsLimit = FramesPerSecond;
+        m_FramePeriod = FramesPerSecond ? std::chrono::duration_cast<clock::duration> (std::chrono::duration<double>(1.0 / FramesPerSecond)) : clock::duration::zero();
+        m_NextFrame = clock::now();
+    }
+
+    Diligent::Uint32 fps_limit() const {
+        return m_FpsLimit;
+    }
+
+private:
+    // Sleep overshoots by up to a scheduler tick, so it stops short of the deadline and spins for
+    // the rest.
+    static constexpr auto spin_time = std::chrono::milliseconds(2);
+
+    void wait_for_frame_start() {
+        if (m_FramePeriod == clock::duration::zero()) {
+            return;
+        }
+
+        const auto SleepUntil = m_NextFrame - spin_time;
+        if (clock::now() < SleepUntil) {
+            std::this_thread::sleep_until(SleepUntil);
+        }
+        while (clock::now() < m_NextFrame) {
+            std::this_thread::yield();
+        }
+
+        // Deadlines advance by whole periods to hold the average rate, but a frame that ran over
+        // restarts the schedule instead of letting the next ones run back to back to catch up.
+        const auto Now = clock::now();
+        m_NextFrame += m_FramePeriod;
+        if (m_NextFrame < Now) {
+            m_NextFrame = Now + m_FramePeriod;
+        }
+    }
+
+    bool              m_Headless;
+    bool              m_FixedClock;
+    Diligent::Uint32  m_FrameCount;
+    Diligent::Uint32  m_FrameIndex = 0;
+    Diligent::Uint32  m_FpsLimit = 0;
+    clock::duration   m_FramePeriod = clock::duration::zero();
+    clock::time_point m_NextFrame;
+};
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Just enough JSON for asset headers such as glTF's: parse() builds a tree of values in one
+// recursive descent over the text, and malformed input throws std::runtime_error with the
+// offset it stopped at. Objects keep their members in file order and look keys up linearly,
+// which is fine for the handful of members asset formats put in each object. The bulk data of
+// those formats lives in binary buffers next to the JSON, not in it.
+class json_value {
+public:
+    enum class kind {
+        null,
+        boolean,
+        number,
+        string,
+        array,
+        object
+    };
+
+    static json_value parse(std::string_view Text) {
+        parser Parser{ Text };
+        Parser.skip_whitespace();
+        json_value Value = Parser.value(0);
+        Parser.skip_whitespace();
+        if (Parser.position != Text.size()) {
+            Parser.fail("trailing characters");
+        }
+        return Value;
+    }
+
+    kind type() const {
+        return m_Kind;
+    }
+
+    bool is_null() const {
+        return m_Kind == kind::null;
+    }
+
+    bool boolean() const {
+        expect(kind::boolean, "a boolean");
+        return m_Boolean;
+    }
+
+    double number() const {
+        expect(kind::number, "a number");
+        return m_Number;
+    }
+
+    // A number that has to be a non-negative integer, such as an index or a count.
+    size_t index() const {
+        const double Value = number();
+        if (Value < 0.0 || Value != static_cast<double> (static_cast<std::uint64_t> (Value))) {
+            throw std::runtime_error("JSON value " + std::to_string(Value) + " is not an index.");
+        }
+        return static_cast<size_t> (Value);
+    }
+
+    const std::string& string() const {
+        expect(kind::string, "a string");
+        return m_String;
+    }
+
+    // Elements of an array, members of an object.
+    size_t size() const {
+        return m_Kind == kind::array || m_Kind == kind::object ? m_Values.size() : 0;
+    }
+
+    const json_value& operator[](size_t Index) const {
+        expect(kind::array, "an array");
+        if (Index >= m_Values.size()) {
+            throw std::runtime_error("JSON array index " + std::to_string(Index) + " out of range.");
+        }
+        return m_Values[Index];
+    }
+
+    // Null when this isn't an object or has no member named Key.
+    const json_value* find(std::string_view Key) const {
+        if (m_Kind != kind::object) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < m_Keys.size(); ++i) {
+            if (m_Keys[i] == Key) {
+                return &m_Values[i];
+            }
+        }
+        return nullptr;
+    }
+
+    const json_value& operator[](std::string_view Key) const {
+        expect(kind::object, "an object");
+        if (const auto* pValue = find(Key)) {
+            return *pValue;
+        }
+        throw std::runtime_error("JSON object has no member " + std::string(Key) + ".");
+    }
+
+    // Member Key as a number or index, or Default when there is no such member.
+    double number_or(std::string_view Key, double Default) const {
+        const auto* pValue = find(Key);
+        return pValue != nullptr ? pValue->number() : Default;
+    }
+
+    size_t index_or(std::string_view Key, size_t Default) const {
+        const auto* pValue = find(Key);
+        return pValue != nullptr ? pValue->index() : Default;
+    }
+
+    const std::vector<std::string>& keys() const {
+        return m_Keys;
+    }
+
+    // Elements of an array or member values of an object, for range-for.
+    const std::vector<json_value>& values() const {
+        return m_Values;
+    }
+
+private:
+    // Deeper nesting than any real header has, so hostile input can't exhaust the stack.
+    static constexpr int max_depth = 128;
+
+    struct parser {
+        std::string_view text;
+        size_t           position = 0;
+
+        [[noreturn]] void fail(const char* What) const {
+            throw std::runtime_error(std::string("Invalid JSON at offset ") + std::to_string(position) + ": " + What + ".");
+        }
+
+        void skip_whitespace() {
+            while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) {
+                ++position;
+            }
+        }
+
+        bool consume(char c) {
+            skip_whitespace();
+            if (position < text.size() && text[position] == c) {
+                ++position;
+                return true;
+            }
+            return false;
+        }
+
+        void literal(std::string_view Word) {
+            if (text.substr(position, Word.size()) != Word) {
+                fail("unknown literal");
+            }
+            position += Word.size();
+        }
+
+        json_value value(int Depth) {
+            if (Depth > max_depth) {
+                fail("nested too deeply");
+            }
+            skip_whitespace();
+            if (position >= text.size()) {
+                fail("unexpected end");
+            }
+
+            json_value Value;
+            switch (text[position]) {
+            case '{':
+                ++position;
+                Value.m_Kind = kind::object;
+                if (consume('}')) {
+                    break;
+                }
+                do {
+                    skip_whitespace();
+                    Value.m_Keys.push_back(string());
+                    if (!consume(':')) {
+                        fail("expected ':'");
+                    }
+                    Value.m_Values.push_back(value(Depth + 1));
+                } while (consume(','));
+                if (!consume('}')) {
+                    fail("expected ',' or '}'");
+                }
+                break;
+            case '[':
+                ++position;
+                Value.m_Kind = kind::array;
+                if (consume(']')) {
+                    break;
+                }
+                do {
+                    Value.m_Values.push_back(value(Depth + 1));
+                } while (consume(','));
+                if (!consume(']')) {
+                    fail("expected ',' or ']'");
+                }
+                break;
+            case '"':
+                Value.m_Kind = kind::string;
+                Value.m_String = string();
+                break;
+            case 't':
+                literal("true");
+                Value.m_Kind = kind::boolean;
+                Value.m_Boolean = true;
+                break;
+            case 'f':
+                literal("false");
+                Value.m_Kind = kind::boolean;
+                break;
+            case 'n':
+                literal("null");
+                break;
+            default:
+                Value.m_Kind = kind::number;
+                Value.m_Number = number();
+                break;
+            }
+            return Value;
+        }
+
+        double number() {
+            const char* pFirst = text.data() + position;
+            const char* pLast = text.data() + text.size();
+            double Value = 0.0;
+            const auto Result = std::from_chars(pFirst, pLast, Value);
+            if (Result.ec != std::errc{} || Result.ptr == pFirst) {
+                fail("expected a value");
+            }
+            position += static_cast<size_t> (Result.ptr - pFirst);
+            return Value;
+        }
+
+        std::string string() {
+            if (position >= text.size() || text[position] != '"') {
+                fail("expected a string");
+            }
+            ++position;
+
+            std::string Result;
+            while (true) {
+                if (position >= text.size()) {
+                    fail("unterminated string");
+                }
+                const char c = text[position++];
+                if (c == '"') {
+                    return Result;
+                }
+                if (c != '\\') {
+                    Result.push_back(c);
+                    continue;
+                }
+
+                if (position >= text.size()) {
+                    fail("unterminated string");
+                }
+                switch (text[position++]) {
+                case '"':  Result.push_back('"');  break;
+                case '\\': Result.push_back('\\'); break;
+                case '/':  Result.push_back('/');  break;
+                case 'b':  Result.push_back('\b'); break;
+                case 'f':  Result.push_back('\f'); break;
+                case 'n':  Result.push_back('\n'); break;
+                case 'r':  Result.push_back('\r'); break;
+                case 't':  Result.push_back('\t'); break;
+                case 'u':  append_utf8(Result, code_point()); break;
+                default:   fail("unknown escape");
+                }
+            }
+        }
+
+        // The code point of a \u escape, combining a surrogate pair into one.
+        std::uint32_t code_point() {
+            std::uint32_t Code = hex4();
+            if (Code >= 0xD800 && Code < 0xDC00) {
+                if (text.substr(position, 2) != "\\u") {
+                    fail("unpaired surrogate");
+                }
+                position += 2;
+                const std::uint32_t Low = hex4();
+                if (Low < 0xDC00 || Low >= 0xE000) {
+                    fail("unpaired surrogate");
+                }
+                Code = 0x10000 + ((Code - 0xD800) << 10) + (Low - 0xDC00);
+            }
+            return Code;
+        }
+
+        std::uint32_t hex4() {
+            if (position + 4 > text.size()) {
+                fail("truncated \\u escape");
+            }
+            std::uint32_t Code = 0;
+            const auto Result = std::from_chars(text.data() + position, text.data() + position + 4, Code, 16);
+            if (Result.ptr != text.data() + position + 4) {
+                fail("invalid \\u escape");
+            }
+            position += 4;
+            return Code;
+        }
+
+        static void append_utf8(std::string& Out, std::uint32_t Code) {
+            if (Code < 0x80) {
+                Out.push_back(static_cast<char> (Code));
+            }
+            else if (Code < 0x800) {
+                Out.push_back(static_cast<char> (0xC0 | (Code >> 6)));
+                Out.push_back(static_cast<char> (0x80 | (Code & 0x3F)));
+            }
+            else if (Code < 0x10000) {
+                Out.push_back(static_cast<char> (0xE0 | (Code >> 12)));
+                Out.push_back(static_cast<char> (0x80 | ((Code >> 6) & 0x3F)));
+                Out.push_back(static_cast<char> (0x80 | (Code & 0x3F)));
+            }
+            else {
+                Out.push_back(static_cast<char> (0xF0 | (Code >> 18)));
+                Out.push_back(static_cast<char> (0x80 | ((Code >> 12) & 0x3F)));
+                Out.push_back(static_cast<char> (0x80 | ((Code >> 6) & 0x3F)));
+                Out.push_back(static_cast<char> (0x80 | (Code & 0x3F)));
+            }
+        }
+    };
+
+    void expect(kind Kind, const char* What) const {
+        if (m_Kind != Kind) {
+            throw std::runtime_error(std::string("JSON value is not ") + What + ".");
+        }
+    }
+
+    kind                     m_Kind = kind::null;
+    bool                     m_Boolean = false;
+    double                   m_Number = 0.0;
+    std::string              m_String;
+    std::vector<std::string> m_Keys;
+    std::vector<json_value>  m_Values;
+};
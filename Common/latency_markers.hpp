@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+// Timestamps three points of every frame and reports how far apart they are:
+//
+//   input    events polled and applied to the scene, or the time given for it
+//   submit   the frame's commands handed to the GPU (right before Flush)
+//   present  Present returned, including the wait for a free frame in flight
+//
+// input -> present is the part of input latency the application controls. What the display adds
+// on top (scan-out, the compositor) isn't visible to the CPU. Marks are taken on the render thread;
+// averages and maxima are printed once per report interval while reporting is on.
+class latency_markers {
+public:
+    using clock = std::chrono::steady_clock;
+
+    void set_reporting(bool Reporting) {
+        m_Reporting = Reporting;
+        reset();
+    }
+
+    bool reporting() const {
+        return m_Reporting;
+    }
+
+    void input() {
+        m_Input = clock::now();
+    }
+
+    // For input sampled earlier or on another thread.
+    void input(clock::time_point Sampled) {
+        m_Input = Sampled;
+    }
+
+    void submit() {
+        m_Submit = clock::now();
+    }
+
+    void present() {
+        const auto Present = clock::now();
+        if (!m_Reporting) {
+            return;
+        }
+
+        m_InputToSubmit.add(m_Submit - m_Input);
+        m_SubmitToPresent.add(Present - m_Submit);
+        m_InputToPresent.add(Present - m_Input);
+        ++m_Frames;
+
+        if (Present - m_ReportStart >= report_interval) {
+            report();
+            reset();
+        }
+    }
+
+    static constexpr auto report_interval = std::chrono::seconds(1);
+
+private:
+    struct span {
+        double total_ms = 0.0;
+        double max_ms = 0.0;
+
+        void add(clock::duration Duration) {
+            const double Ms = std::chrono::duration<double, std::milli>(Duration).count();
+            total_ms += Ms;
+            max_ms = std::max(max_ms, Ms);
+        }
+    };
+
+    void report() const {
+        const auto print = [this](const char* Name, const span& Span) {
+            char Line[96];
+            std::snprintf(Line, sizeof(Line), "  %-16s %6.2f ms avg %6.2f ms max\n", Name, Span.total_ms / m_Frames, Span.max_ms);
+            std::cout << Line;
+        };
+        std::cout << "latency over " << m_Frames << " frames\n";
+        print("input->submit", m_InputToSubmit);
+        print("submit->present", m_SubmitToPresent);
+        print("input->present", m_InputToPresent);
+    }
+
+    void reset() {
+        m_InputToSubmit = {};
+        m_SubmitToPresent = {};
+        m_InputToPresent = {};
+        m_Frames = 0;
+        m_ReportStart = clock::now();
+    }
+
+    bool              m_Reporting = false;
+    clock::time_point m_Input;
+    clock::time_point m_Submit;
+    clock::time_point m_ReportStart;
+    span              m_InputToSubmit;
+    span              m_SubmitToPresent;
+    span              m_InputToPresent;
+    unsigned          m_Frames = 0;
+};
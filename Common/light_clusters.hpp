@@ -0,0 +1,283 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include "thread_pool.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Constants of the cluster lookup, laid out like ClusterConstants in clustered_lighting.fxh.
+struct cluster_constants {
+    glm::vec3        view_forward;
+    float            depth_scale;
+    glm::vec2        tile_scale;
+    float            near_plane;
+    Diligent::Uint32 padding = 0;
+    Diligent::Uint32 grid_size[3];
+    Diligent::Uint32 light_count;
+};
+
+// Clustered forward light assignment.
+//
+// The view frustum is cut into grid_x * grid_y screen tiles and grid_z depth slices spaced
+// exponentially between the near and far planes. build() takes every light's bounding sphere and
+// records, per cluster, the lights whose sphere touches that cluster's view space box:
+//
+//   ClusterRanges        uint2 per cluster, offset and count into ClusterLightIndices
+//   ClusterLightIndices  light indices, grouped by cluster, ascending within each cluster
+//
+// The pixel shader finds its cluster from the screen position and view depth and loops over that
+// range only. Binning is split by depth slices across a thread_pool, each task writing its own
+// index list, and the lists are concatenated afterwards in slice order.
+class light_clusters {
+public:
+    static constexpr Diligent::Uint32 grid_x = 16;
+    static constexpr Diligent::Uint32 grid_y = 9;
+    static constexpr Diligent::Uint32 grid_z = 24;
+    static constexpr Diligent::Uint32 cluster_count = grid_x * grid_y * grid_z;
+
+    // Lights past this many in one cluster are dropped from it.
+    static constexpr Diligent::Uint32 max_lights_per_cluster = 256;
+
+    void create(Diligent::IRenderDevice* pDevice) {
+        using namespace Diligent;
+
+        BufferDesc RangesDesc;
+        RangesDesc.Name = "Cluster light ranges";
+        RangesDesc.Usage = USAGE_DEFAULT;
+        RangesDesc.BindFlags = BIND_SHADER_RESOURCE;
+        RangesDesc.Mode = BUFFER_MODE_STRUCTURED;
+        RangesDesc.ElementByteStride = sizeof(cluster_range);
+        RangesDesc.Size = cluster_count * sizeof(cluster_range);
+        pDevice->CreateBuffer(RangesDesc, nullptr, &m_RangesBuffer);
+
+        BufferDesc IndicesDesc;
+        IndicesDesc.Name = "Cluster light indices";
+        IndicesDesc.Usage = USAGE_DEFAULT;
+        IndicesDesc.BindFlags = BIND_SHADER_RESOURCE;
+        IndicesDesc.Mode = BUFFER_MODE_STRUCTURED;
+        IndicesDesc.ElementByteStride = sizeof(Uint32);
+        IndicesDesc.Size = cluster_count * max_lights_per_cluster * sizeof(Uint32);
+        pDevice->CreateBuffer(IndicesDesc, nullptr, &m_IndicesBuffer);
+
+        if (!m_RangesBuffer || !m_IndicesBuffer) {
+            throw std::runtime_error("Failed to create the light cluster buffers.");
+        }
+
+        m_Ranges.resize(cluster_count);
+        m_Indices.reserve(cluster_count * max_lights_per_cluster);
+    }
+
+    // Spheres are world space, xyz center and w radius. The projection parameters must match the
+    // glm::perspective the frame is drawn with.
+    void build(const glm::mat4& View, float FovY, float Aspect, float Near, float Far, const std::vector<glm::vec4>& Spheres, thread_pool& Pool) {
+        m_ViewForward = -glm::vec3(View[0][2], View[1][2], View[2][2]);
+        m_TanHalfFovY = std::tan(FovY * 0.5f);
+        m_Aspect = Aspect;
+        m_Near = Near;
+        m_Far = Far;
+        m_LightCount = static_cast<Diligent::Uint32> (Spheres.size());
+
+        // View space with depth pointing into the screen, which keeps every comparison below positive.
+        m_ViewSpheres.resize(Spheres.size());
+        const size_t LightChunk = 1024;
+        Pool.run((Spheres.size() + LightChunk - 1) / LightChunk, [&](size_t Chunk) {
+            const size_t End = std::min(Spheres.size(), (Chunk + 1) * LightChunk);
+            for (size_t i = Chunk * LightChunk; i < End; ++i) {
+                const glm::vec4 Center = View * glm::vec4(glm::vec3(Spheres[i]), 1.0f);
+                m_ViewSpheres[i] = glm::vec4(Center.x, Center.y, -Center.z, Spheres[i].w);
+            }
+        });
+
+        const size_t TaskCount = std::min<size_t>(Pool.size(), grid_z);
+        m_Tasks.resize(TaskCount);
+        Pool.run(TaskCount, [&](size_t Task) {
+            bin_slices(m_Tasks[Task], static_cast<Diligent::Uint32> (Task * grid_z / TaskCount), static_cast<Diligent::Uint32> ((Task + 1) * grid_z / TaskCount));
+        });
+
+        m_Indices.clear();
+        for (const auto& Task : m_Tasks) {
+            const auto Base = static_cast<Diligent::Uint32> (m_Indices.size());
+            for (Diligent::Uint32 Cluster = Task.first_cluster; Cluster < Task.end_cluster; ++Cluster) {
+                m_Ranges[Cluster].offset += Base;
+            }
+            m_Indices.insert(m_Indices.end(), Task.indices.begin(), Task.indices.end());
+        }
+    }
+
+    void upload(Diligent::IDeviceContext* pContext) {
+        using namespace Diligent;
+
+        pContext->UpdateBuffer(m_RangesBuffer, 0, cluster_count * sizeof(cluster_range), m_Ranges.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        if (!m_Indices.empty()) {
+            pContext->UpdateBuffer(m_IndicesBuffer, 0, m_Indices.size() * sizeof(Uint32), m_Indices.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        }
+    }
+
+    cluster_constants constants(Diligent::Uint32 Width, Diligent::Uint32 Height) const {
+        cluster_constants Constants;
+        Constants.view_forward = m_ViewForward;
+        Constants.depth_scale = grid_z / std::log(m_Far / m_Near);
+        Constants.tile_scale = glm::vec2(static_cast<float> (grid_x) / Width, static_cast<float> (grid_y) / Height);
+        Constants.near_plane = m_Near;
+        Constants.grid_size[0] = grid_x;
+        Constants.grid_size[1] = grid_y;
+        Constants.grid_size[2] = grid_z;
+        Constants.light_count = m_LightCount;
+        return Constants;
+    }
+
+    Diligent::IBufferView* ranges_srv() const {
+        return m_RangesBuffer->GetDefaultView(Diligent::BUFFER_VIEW_SHADER_RESOURCE);
+    }
+
+    Diligent::IBufferView* indices_srv() const {
+        return m_IndicesBuffer->GetDefaultView(Diligent::BUFFER_VIEW_SHADER_RESOURCE);
+    }
+
+    // Total light references over all clusters in the last build.
+    size_t index_count() const {
+        return m_Indices.size();
+    }
+
+private:
+    struct cluster_range {
+        Diligent::Uint32 offset;
+        Diligent::Uint32 count;
+    };
+
+    struct slice_task {
+        Diligent::Uint32                                           first_cluster = 0;
+        Diligent::Uint32                                           end_cluster = 0;
+        std::vector<std::pair<Diligent::Uint32, Diligent::Uint32>> hits; // cluster, light
+        std::vector<Diligent::Uint32>                              counts;
+        std::vector<Diligent::Uint32>                              indices;
+    };
+
+    float slice_depth(Diligent::Uint32 Slice) const {
+        return m_Near * std::pow(m_Far / m_Near, static_cast<float> (Slice) / grid_z);
+    }
+
+    Diligent::Uint32 depth_slice(float Depth) const {
+        const float Slice = std::log(Depth / m_Near) * grid_z / std::log(m_Far / m_Near);
+        return static_cast<Diligent::Uint32> (std::clamp(Slice, 0.0f, static_cast<float> (grid_z - 1)));
+    }
+
+    static Diligent::Uint32 tile(float Ndc, Diligent::Uint32 Count) {
+        const float Tile = std::floor((Ndc * 0.5f + 0.5f) * Count);
+        return static_cast<Diligent::Uint32> (std::clamp(Tile, 0.0f, static_cast<float> (Count - 1)));
+    }
+
+    void bin_slices(slice_task& Task, Diligent::Uint32 FirstSlice, Diligent::Uint32 EndSlice) {
+        using Diligent::Uint32;
+
+        Task.first_cluster = FirstSlice * grid_x * grid_y;
+        Task.end_cluster = EndSlice * grid_x * grid_y;
+        Task.hits.clear();
+
+        const float TanY = m_TanHalfFovY;
+        const float TanX = m_TanHalfFovY * m_Aspect;
+        const float FirstDepth = slice_depth(FirstSlice);
+        const float EndDepth = slice_depth(EndSlice);
+
+        for (Uint32 Light = 0; Light < m_ViewSpheres.size(); ++Light) {
+            const glm::vec4 Sphere = m_ViewSpheres[Light];
+            const float Radius = Sphere.w;
+            const float MinDepth = std::max(Sphere.z - Radius, m_Near);
+            const float MaxDepth = std::min(Sphere.z + Radius, m_Far);
+            if (MinDepth > MaxDepth || MaxDepth < FirstDepth || MinDepth > EndDepth) {
+                continue;
+            }
+
+            const Uint32 FirstK = std::max(depth_slice(MinDepth), FirstSlice);
+            const Uint32 LastK = std::min(depth_slice(MaxDepth), EndSlice - 1);
+
+            // The sphere's screen footprint, bounded by projecting its box at both depth extremes.
+            const float NdcX[] = { (Sphere.x - Radius) / (MinDepth * TanX), (Sphere.x - Radius) / (MaxDepth * TanX),
+                                   (Sphere.x + Radius) / (MinDepth * TanX), (Sphere.x + Radius) / (MaxDepth * TanX) };
+            const float NdcY[] = { (Sphere.y - Radius) / (MinDepth * TanY), (Sphere.y - Radius) / (MaxDepth * TanY),
+                                   (Sphere.y + Radius) / (MinDepth * TanY), (Sphere.y + Radius) / (MaxDepth * TanY) };
+            const auto [MinX, MaxX] = std::minmax_element(std::begin(NdcX), std::end(NdcX));
+            const auto [MinY, MaxY] = std::minmax_element(std::begin(NdcY), std::end(NdcY));
+            if (*MinX > 1.0f || *MaxX < -1.0f || *MinY > 1.0f || *MaxY < -1.0f) {
+                continue;
+            }
+
+            // Tile rows count down from the top of the screen, where NDC y is +1.
+            const Uint32 FirstI = tile(*MinX, grid_x);
+            const Uint32 LastI = tile(*MaxX, grid_x);
+            const Uint32 FirstJ = tile(-*MaxY, grid_y);
+            const Uint32 LastJ = tile(-*MinY, grid_y);
+
+            for (Uint32 k = FirstK; k <= LastK; ++k) {
+                const float Near = slice_depth(k);
+                const float Far = slice_depth(k + 1);
+                const float DZ = Sphere.z - std::clamp(Sphere.z, Near, Far);
+
+                for (Uint32 j = FirstJ; j <= LastJ; ++j) {
+                    const float Top = 1.0f - 2.0f * j / grid_y;
+                    const float Bottom = 1.0f - 2.0f * (j + 1) / grid_y;
+                    const float MinYView = std::min(Bottom * Near, Bottom * Far) * TanY;
+                    const float MaxYView = std::max(Top * Near, Top * Far) * TanY;
+                    const float DY = Sphere.y - std::clamp(Sphere.y, MinYView, MaxYView);
+
+                    for (Uint32 i = FirstI; i <= LastI; ++i) {
+                        const float Left = -1.0f + 2.0f * i / grid_x;
+                        const float Right = -1.0f + 2.0f * (i + 1) / grid_x;
+                        const float MinXView = std::min(Left * Near, Left * Far) * TanX;
+                        const float MaxXView = std::max(Right * Near, Right * Far) * TanX;
+                        const float DX = Sphere.x - std::clamp(Sphere.x, MinXView, MaxXView);
+
+                        if (DX * DX + DY * DY + DZ * DZ <= Radius * Radius) {
+                            Task.hits.emplace_back(i + grid_x * (j + grid_y * k), Light);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Counting sort by cluster. Hits arrive in light order, which the sort keeps.
+        Task.counts.assign(Task.end_cluster - Task.first_cluster, 0);
+        for (const auto& [Cluster, Light] : Task.hits) {
+            auto& Count = Task.counts[Cluster - Task.first_cluster];
+            Count = std::min(Count + 1, max_lights_per_cluster);
+        }
+
+        Uint32 Offset = 0;
+        for (Uint32 Cluster = Task.first_cluster; Cluster < Task.end_cluster; ++Cluster) {
+            m_Ranges[Cluster] = { Offset, 0 };
+            Offset += Task.counts[Cluster - Task.first_cluster];
+        }
+
+        Task.indices.resize(Offset);
+        for (const auto& [Cluster, Light] : Task.hits) {
+            auto& Range = m_Ranges[Cluster];
+            if (Range.count < Task.counts[Cluster - Task.first_cluster]) {
+                Task.indices[Range.offset + Range.count++] = Light;
+            }
+        }
+    }
+
+    Diligent::RefCntAutoPtr<Diligent::IBuffer> m_RangesBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer> m_IndicesBuffer;
+
+    std::vector<cluster_range>    m_Ranges;
+    std::vector<Diligent::Uint32> m_Indices;
+    std::vector<glm::vec4>        m_ViewSpheres;
+    std::vector<slice_task>       m_Tasks;
+
+    glm::vec3        m_ViewForward = glm::vec3(0.0f, 0.0f, -1.0f);
+    float            m_TanHalfFovY = 1.0f;
+    float            m_Aspect = 1.0f;
+    float            m_Near = 0.1f;
+    float            m_Far = 100.0f;
+    Diligent::Uint32 m_LightCount = 0;
+};
@@ -0,0 +1,340 @@
+#pragma once
+
+#include "DiligentCore/Primitives/interface/BasicTypes.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+// Reorders triangle lists so the GPU does less work drawing them, in the order a loader runs them:
+//
+//   optimize_vertex_cache        triangle order for the post-transform cache (Forsyth's linear
+//                                speed vertex cache optimisation)
+//   optimize_overdraw            cluster order so outer surfaces draw before what they hide,
+//                                at a bounded cost in cache hits (Sander, Nehab and Barczak,
+//                                "Fast Triangle Reordering for Vertex Locality and Reduced
+//                                Overdraw")
+//   optimize_vertex_fetch_remap  vertex order, in the order the triangles first use them, so
+//                                vertex fetch reads memory front to back
+//
+// All of them work in place on 32-bit triangle list indices into VertexCount vertices.
+namespace mesh_optimizer {
+
+// Cache size both the scoring and the simulated FIFO cache assume; small enough that every
+// GPU's post-transform cache holds at least that many vertices.
+inline constexpr size_t cache_size = 16;
+
+namespace detail {
+
+inline float vertex_score(int CachePosition, Diligent::Uint32 LiveTriangles) {
+    if (LiveTriangles == 0) {
+        return -1.0f;
+    }
+
+    float Score = 0.0f;
+    if (CachePosition >= 0) {
+        // The last triangle's vertices score the same, so the order inside it doesn't matter.
+        if (CachePosition < 3) {
+            Score = 0.75f;
+        }
+        else {
+            const float Scaler = 1.0f / static_cast<float> (cache_size - 3);
+            Score = std::pow(1.0f - static_cast<float> (CachePosition - 3) * Scaler, 1.5f);
+        }
+    }
+
+    // Vertices with few triangles left get finished first, so they don't linger as stragglers.
+    return Score + 2.0f / std::sqrt(static_cast<float> (LiveTriangles));
+}
+
+// Triangles of each vertex, as ranges into one array.
+struct adjacency {
+    std::vector<Diligent::Uint32> offsets;
+    std::vector<Diligent::Uint32> counts;
+    std::vector<Diligent::Uint32> triangles;
+
+    adjacency(const Diligent::Uint32* Indices, size_t IndexCount, size_t VertexCount) :
+        offsets(VertexCount, 0),
+        counts(VertexCount, 0),
+        triangles(IndexCount) {
+        for (size_t i = 0; i < IndexCount; ++i) {
+            ++counts[Indices[i]];
+        }
+        Diligent::Uint32 Offset = 0;
+        for (size_t v = 0; v < VertexCount; ++v) {
+            offsets[v] = Offset;
+            Offset += counts[v];
+        }
+
+        std::vector<Diligent::Uint32> Fill = offsets;
+        for (size_t i = 0; i < IndexCount; ++i) {
+            triangles[Fill[Indices[i]]++] = static_cast<Diligent::Uint32> (i / 3);
+        }
+    }
+};
+
+// FIFO cache of cache_size entries made of time stamps: a vertex is in it when it missed within
+// the last cache_size misses.
+class fifo_cache {
+public:
+    explicit fifo_cache(size_t VertexCount) :
+        m_Stamps(VertexCount, 0) {
+    }
+
+    void flush() {
+        m_Time += cache_size + 1;
+    }
+
+    // The misses of one triangle.
+    unsigned triangle(const Diligent::Uint32* Triangle) {
+        unsigned Misses = 0;
+        for (size_t k = 0; k < 3; ++k) {
+            auto& Stamp = m_Stamps[Triangle[k]];
+            if (m_Time - Stamp > cache_size) {
+                Stamp = m_Time++;
+                ++Misses;
+            }
+        }
+        return Misses;
+    }
+
+private:
+    std::vector<size_t> m_Stamps;
+    size_t              m_Time = cache_size + 1;
+};
+
+} // namespace detail
+
+inline void optimize_vertex_cache(Diligent::Uint32* Indices, size_t IndexCount, size_t VertexCount) {
+    using Diligent::Uint32;
+
+    const size_t TriangleCount = IndexCount / 3;
+    if (TriangleCount == 0) {
+        return;
+    }
+
+    detail::adjacency Adjacency(Indices, IndexCount, VertexCount);
+
+    std::vector<float> VertexScores(VertexCount);
+    for (size_t v = 0; v < VertexCount; ++v) {
+        VertexScores[v] = detail::vertex_score(-1, Adjacency.counts[v]);
+    }
+
+    std::vector<float> TriangleScores(TriangleCount);
+    for (size_t t = 0; t < TriangleCount; ++t) {
+        TriangleScores[t] = VertexScores[Indices[t * 3]] + VertexScores[Indices[t * 3 + 1]] + VertexScores[Indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> Emitted(TriangleCount, false);
+    std::vector<Uint32> Output(IndexCount);
+
+    // The triangle's three vertices go in front of the cache and can push up to three out, which
+    // still get their scores lowered.
+    std::array<Uint32, cache_size + 3> Cache;
+    std::array<Uint32, cache_size + 3> NewCache;
+    size_t CacheCount = 0;
+
+    constexpr Uint32 none = ~0u;
+    Uint32 Current = static_cast<Uint32> (std::max_element(TriangleScores.begin(), TriangleScores.end()) - TriangleScores.begin());
+    size_t Cursor = 0;
+
+    for (size_t Out = 0; Out < TriangleCount; ++Out) {
+        // Nothing in the cache has triangles left, so start over with the first one not drawn yet.
+        if (Current == none) {
+            while (Emitted[Cursor]) {
+                ++Cursor;
+            }
+            Current = static_cast<Uint32> (Cursor);
+        }
+
+        const Uint32* Triangle = Indices + Current * 3;
+        std::copy(Triangle, Triangle + 3, Output.begin() + Out * 3);
+        Emitted[Current] = true;
+
+        for (size_t k = 0; k < 3; ++k) {
+            const Uint32 Vertex = Triangle[k];
+            Uint32* First = Adjacency.triangles.data() + Adjacency.offsets[Vertex];
+            Uint32* Last = First + Adjacency.counts[Vertex];
+            auto* Found = std::find(First, Last, Current);
+            std::swap(*Found, *(Last - 1));
+            --Adjacency.counts[Vertex];
+        }
+
+        size_t NewCount = 0;
+        for (size_t k = 0; k < 3; ++k) {
+            if (std::find(NewCache.begin(), NewCache.begin() + NewCount, Triangle[k]) == NewCache.begin() + NewCount) {
+                NewCache[NewCount++] = Triangle[k];
+            }
+        }
+        for (size_t i = 0; i < CacheCount; ++i) {
+            if (Cache[i] != Triangle[0] && Cache[i] != Triangle[1] && Cache[i] != Triangle[2]) {
+                NewCache[NewCount++] = Cache[i];
+            }
+        }
+
+        for (size_t i = 0; i < NewCount; ++i) {
+            const Uint32 Vertex = NewCache[i];
+            const float Score = detail::vertex_score(i < cache_size ? static_cast<int> (i) : -1, Adjacency.counts[Vertex]);
+            const float Delta = Score - VertexScores[Vertex];
+            VertexScores[Vertex] = Score;
+
+            const Uint32* First = Adjacency.triangles.data() + Adjacency.offsets[Vertex];
+            for (const Uint32* t = First; t != First + Adjacency.counts[Vertex]; ++t) {
+                TriangleScores[*t] += Delta;
+            }
+        }
+
+        // The next triangle is the best one that uses a cached vertex.
+        CacheCount = std::min(NewCount, cache_size);
+        std::copy(NewCache.begin(), NewCache.begin() + CacheCount, Cache.begin());
+
+        Current = none;
+        float BestScore = 0.0f;
+        for (size_t i = 0; i < CacheCount; ++i) {
+            const Uint32 Vertex = Cache[i];
+            const Uint32* First = Adjacency.triangles.data() + Adjacency.offsets[Vertex];
+            for (const Uint32* t = First; t != First + Adjacency.counts[Vertex]; ++t) {
+                if (Current == none || TriangleScores[*t] > BestScore) {
+                    Current = *t;
+                    BestScore = TriangleScores[*t];
+                }
+            }
+        }
+    }
+
+    std::copy(Output.begin(), Output.end(), Indices);
+}
+
+// Position(Vertex) returns the vertex's position as std::array<float, 3>. Run it on the output of
+// optimize_vertex_cache: it splits the triangles into clusters wherever the cache would restart
+// anyway and, within those, as soon as a cluster's cache miss ratio gets within Threshold of the
+// whole run's, then sorts the clusters by how far out they face. Threshold 1.05 gives up at most
+// about 5% of the cache hits.
+template <typename PositionFn>
+void optimize_overdraw(Diligent::Uint32* Indices, size_t IndexCount, size_t VertexCount, PositionFn&& Position, float Threshold = 1.05f) {
+    using Diligent::Uint32;
+    using vec3 = std::array<float, 3>;
+
+    const size_t TriangleCount = IndexCount / 3;
+    if (TriangleCount == 0) {
+        return;
+    }
+
+    // Hard boundaries: triangles that miss with all three vertices share nothing with what came
+    // before them, so moving them costs nothing.
+    std::vector<size_t> Hard;
+    detail::fifo_cache Cache(VertexCount);
+    for (size_t t = 0; t < TriangleCount; ++t) {
+        if (Cache.triangle(Indices + t * 3) == 3 || t == 0) {
+            Hard.push_back(t);
+        }
+    }
+    Hard.push_back(TriangleCount);
+
+    // Soft boundaries: restart the cache inside a hard cluster once the part since the last
+    // boundary is about as cache friendly as the whole cluster.
+    std::vector<size_t> Clusters;
+    for (size_t h = 0; h + 1 < Hard.size(); ++h) {
+        const size_t Start = Hard[h];
+        const size_t End = Hard[h + 1];
+
+        Cache.flush();
+        unsigned ClusterMisses = 0;
+        for (size_t t = Start; t < End; ++t) {
+            ClusterMisses += Cache.triangle(Indices + t * 3);
+        }
+        const float ClusterThreshold = Threshold * static_cast<float> (ClusterMisses) / static_cast<float> (End - Start);
+
+        Clusters.push_back(Start);
+        Cache.flush();
+        unsigned Misses = 0;
+        size_t Faces = 0;
+        for (size_t t = Start; t < End; ++t) {
+            Misses += Cache.triangle(Indices + t * 3);
+            ++Faces;
+            if (static_cast<float> (Misses) / static_cast<float> (Faces) <= ClusterThreshold && t + 1 < End) {
+                Clusters.push_back(t + 1);
+                Cache.flush();
+                Misses = 0;
+                Faces = 0;
+            }
+        }
+    }
+    const size_t ClusterCount = Clusters.size();
+    Clusters.push_back(TriangleCount);
+
+    // Clusters far out along their own normal are the outside of the mesh and go first.
+    vec3 MeshCenter = {};
+    for (size_t v = 0; v < VertexCount; ++v) {
+        const vec3 p = Position(static_cast<Uint32> (v));
+        for (size_t k = 0; k < 3; ++k) {
+            MeshCenter[k] += p[k];
+        }
+    }
+    for (auto& c : MeshCenter) {
+        c /= static_cast<float> (std::max<size_t>(VertexCount, 1));
+    }
+
+    std::vector<float> SortKeys(ClusterCount);
+    for (size_t c = 0; c < ClusterCount; ++c) {
+        vec3 Center = {};
+        vec3 Normal = {};
+        float Area = 0.0f;
+        for (size_t t = Clusters[c]; t < Clusters[c + 1]; ++t) {
+            const vec3 p0 = Position(Indices[t * 3]);
+            const vec3 p1 = Position(Indices[t * 3 + 1]);
+            const vec3 p2 = Position(Indices[t * 3 + 2]);
+            const vec3 e1 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const vec3 e2 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const vec3 n = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const float a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (size_t k = 0; k < 3; ++k) {
+                Center[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * a;
+                Normal[k] += n[k];
+            }
+            Area += a;
+        }
+
+        const float NormalLength = std::sqrt(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+        float Key = 0.0f;
+        if (Area > 0.0f && NormalLength > 0.0f) {
+            for (size_t k = 0; k < 3; ++k) {
+                Key += (Center[k] / Area - MeshCenter[k]) * Normal[k] / NormalLength;
+            }
+        }
+        SortKeys[c] = Key;
+    }
+
+    std::vector<Uint32> Order(ClusterCount);
+    std::iota(Order.begin(), Order.end(), 0u);
+    std::stable_sort(Order.begin(), Order.end(), [&](Uint32 a, Uint32 b) { return SortKeys[a] > SortKeys[b]; });
+
+    std::vector<Uint32> Output;
+    Output.reserve(IndexCount);
+    for (const auto c : Order) {
+        Output.insert(Output.end(), Indices + Clusters[c] * 3, Indices + Clusters[c + 1] * 3);
+    }
+    std::copy(Output.begin(), Output.end(), Indices);
+}
+
+// Renumbers the vertices in the order the indices first use them and rewrites the indices to
+// match. Remap[Old] is the vertex's new number, or ~0u for vertices no triangle uses, which are
+// dropped. Returns the number of vertices kept.
+inline size_t optimize_vertex_fetch_remap(Diligent::Uint32* Indices, size_t IndexCount, size_t VertexCount, std::vector<Diligent::Uint32>& Remap) {
+    Remap.assign(VertexCount, ~0u);
+
+    Diligent::Uint32 Next = 0;
+    for (size_t i = 0; i < IndexCount; ++i) {
+        auto& New = Remap[Indices[i]];
+        if (New == ~0u) {
+            New = Next++;
+        }
+        Indices[i] = New;
+    }
+    return Next;
+}
+
+} // namespace mesh_optimizer
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/PipelineStateCache.h"
+#include "DiligentCore/Graphics/GraphicsTools/interface/RenderStateCache.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+#include "DiligentCore/Common/interface/DataBlobImpl.hpp"
+
+#include "spirv_bytecode.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+// Keeps compiled shaders and pipelines on disk between runs.
+//
+// Shaders and pipeline states are created through Diligent's render state cache, which stores the
+// compiled SPIR-V keyed by a hash of the shader source and create info, so a warm start never runs
+// glslang. Every PSO also gets the Vulkan pipeline cache attached, and its data is saved next to
+// the state cache so the driver can skip pipeline compilation as well. Files are named after the
+// adapter; the driver validates the pipeline cache header itself and ignores data it can't use.
+class pipeline_cache {
+public:
+    // Bump to discard every existing cache file, e.g. when the shader macros change meaning.
+    static constexpr Diligent::Uint32 content_version = 1;
+
+    static inline const std::filesystem::path directory = "cache";
+
+    void create(Diligent::IRenderDevice* pDevice, const std::string& Name) {
+        using namespace Diligent;
+
+        const auto& Adapter = pDevice->GetAdapterInfo();
+        char AdapterKey[32];
+        std::snprintf(AdapterKey, sizeof(AdapterKey), "%04x_%04x", Adapter.VendorId, Adapter.DeviceId);
+
+        m_StatePath = directory / (Name + "_" + AdapterKey + ".state");
+        m_PSOCachePath = directory / (Name + "_" + AdapterKey + ".pso");
+
+        RenderStateCacheCreateInfo StateCacheCI;
+        StateCacheCI.pDevice = pDevice;
+        CreateRenderStateCache(StateCacheCI, &m_pStateCache);
+        if (!m_pStateCache) {
+            throw std::runtime_error("Failed to create the render state cache.");
+        }
+
+        if (auto pStateData = read_file(m_StatePath)) {
+            m_pStateCache->Load(pStateData, content_version);
+        }
+
+        PipelineStateCacheCreateInfo PSOCacheCI;
+        PSOCacheCI.Desc.Name = "Pipeline cache";
+        PSOCacheCI.Desc.Mode = PSO_CACHE_MODE_LOAD | PSO_CACHE_MODE_STORE;
+
+        auto pPSOCacheData = read_file(m_PSOCachePath);
+        if (pPSOCacheData) {
+            PSOCacheCI.pCacheData = pPSOCacheData->GetConstDataPtr();
+            PSOCacheCI.CacheDataSize = static_cast<Uint32> (pPSOCacheData->GetSize());
+        }
+        // Optional, pipelines are still created without it.
+        pDevice->CreatePipelineStateCache(PSOCacheCI, &m_pPSOCache);
+    }
+
+    // Prefers the SPIR-V precompiled by the ShaderCompiler tool, so even a cold start skips glslang.
+    // The source is only compiled when there is no up to date .spv for this shader and macro set.
+    void create_shader(const Diligent::ShaderCreateInfo& ShaderCI, Diligent::IShader** ppShader) {
+        const auto ByteCode = load_spirv(ShaderCI);
+        if (ByteCode.empty()) {
+            m_pStateCache->CreateShader(ShaderCI, ppShader);
+            return;
+        }
+
+        auto ByteCodeCI = ShaderCI;
+        ByteCodeCI.FilePath = nullptr;
+        ByteCodeCI.Source = nullptr;
+        ByteCodeCI.pShaderSourceStreamFactory = nullptr;
+        ByteCodeCI.Macros = {};
+        ByteCodeCI.ByteCode = ByteCode.data();
+        ByteCodeCI.ByteCodeSize = ByteCode.size();
+        m_pStateCache->CreateShader(ByteCodeCI, ppShader);
+    }
+
+    void create_graphics_pipeline_state(Diligent::GraphicsPipelineStateCreateInfo& PSOCreateInfo, Diligent::IPipelineState** ppPSO) {
+        PSOCreateInfo.pPSOCache = m_pPSOCache;
+        m_pStateCache->CreateGraphicsPipelineState(PSOCreateInfo, ppPSO);
+    }
+
+    void create_compute_pipeline_state(Diligent::ComputePipelineStateCreateInfo& PSOCreateInfo, Diligent::IPipelineState** ppPSO) {
+        PSOCreateInfo.pPSOCache = m_pPSOCache;
+        m_pStateCache->CreateComputePipelineState(PSOCreateInfo, ppPSO);
+    }
+
+    // Writes both caches back to disk. Call once every pipeline the sample uses has been created.
+    void save() const {
+        std::filesystem::create_directories(directory);
+
+        Diligent::RefCntAutoPtr<Diligent::IDataBlob> pStateData;
+        if (m_pStateCache->WriteToBlob(content_version, &pStateData)) {
+            write_file(m_StatePath, *pStateData);
+        }
+
+        if (m_pPSOCache) {
+            Diligent::RefCntAutoPtr<Diligent::IDataBlob> pPSOCacheData;
+            m_pPSOCache->GetData(&pPSOCacheData);
+            if (pPSOCacheData) {
+                write_file(m_PSOCachePath, *pPSOCacheData);
+            }
+        }
+    }
+
+private:
+    static Diligent::RefCntAutoPtr<Diligent::IDataBlob> read_file(const std::filesystem::path& Path) {
+        std::ifstream File(Path, std::ios::binary | std::ios::ate);
+        if (!File) {
+            return {};
+        }
+
+        const auto Size = static_cast<size_t> (File.tellg());
+        auto pData = Diligent::DataBlobImpl::Create(Size);
+        File.seekg(0);
+        if (!File.read(static_cast<char*> (pData->GetDataPtr()), Size)) {
+            return {};
+        }
+        return pData;
+    }
+
+    static void write_file(const std::filesystem::path& Path, const Diligent::IDataBlob& Data) {
+        std::ofstream File(Path, std::ios::binary | std::ios::trunc);
+        File.write(static_cast<const char*> (Data.GetConstDataPtr()), Data.GetSize());
+    }
+
+    Diligent::RefCntAutoPtr<Diligent::IRenderStateCache>   m_pStateCache;
+    Diligent::RefCntAutoPtr<Diligent::IPipelineStateCache> m_pPSOCache;
+    std::filesystem::path                                  m_StatePath;
+    std::filesystem::path                                  m_PSOCachePath;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+// GLFW and Diligent both need to know which native window system they are talking to, so the
+// platform is picked once here instead of in every sample.
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX // glfw3native.h pulls in windows.h, whose min/max macros break std::min/std::max
+#   endif
+#   define GLFW_EXPOSE_NATIVE_WIN32
+#   define PLATFORM_WIN32 1
+#else
+#   define GLFW_EXPOSE_NATIVE_X11
+#   define PLATFORM_LINUX 1
+#endif
+
+#include "GLFW/glfw3.h"
+#include "GLFW/glfw3native.h"
+
+#define VULKAN_SUPPORTED
+#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
+
+inline Diligent::NativeWindow native_window(GLFWwindow* window) {
+#if PLATFORM_WIN32
+    return Diligent::Win32NativeWindow{ glfwGetWin32Window(window) };
+#else
+    Diligent::LinuxNativeWindow Window;
+    Window.WindowId = static_cast<Diligent::Uint32> (glfwGetX11Window(window));
+    Window.pDisplay = glfwGetX11Display();
+    return Window;
+#endif
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Declares the passes of a frame with the resources they read and write, and issues every
+// resource state transition itself, so the passes record with pass_mode instead of
+// RESOURCE_STATE_TRANSITION_MODE_TRANSITION.
+//
+// Each frame the sample calls reset(), imports the resources the passes use (back buffer, depth
+// buffer, meshes, constant buffers), adds its passes in submission order, and calls execute().
+// Before running any pass, execute() walks the passes once, following every resource's state from
+// the one the engine tracks at the start of the frame, and collects the transitions each pass needs. They go out as one TransitionResourceStates call per pass; a
+// resource already in a state the pass needs costs nothing. Draws inside a pass then only verify
+// states, which Diligent checks in development builds and skips in release ones, instead of looking
+// up and transitioning every bound resource on every draw.
+//
+// The graph only tracks states; it doesn't create resources or alias their memory. Diligent has no
+// placed resources to alias with, and the samples have no intermediate targets to alias.
+//
+// Resources written through a dynamic map (USAGE_DYNAMIC buffers, frame_ring_buffer) have no state
+// to track and aren't declared.
+class render_graph {
+public:
+    // What passes record with. Any transition a pass still needs is a missing declaration, which
+    // development builds of the engine report.
+    static constexpr Diligent::RESOURCE_STATE_TRANSITION_MODE pass_mode = Diligent::RESOURCE_STATE_TRANSITION_MODE_VERIFY;
+
+    using resource = Diligent::Uint32;
+    using execute_function = std::function<void(Diligent::IDeviceContext*)>;
+
+    struct access {
+        resource                 id;
+        Diligent::RESOURCE_STATE state;
+        bool                     write;
+    };
+
+    static access read(resource Id, Diligent::RESOURCE_STATE State) {
+        return { Id, State, false };
+    }
+
+    static access write(resource Id, Diligent::RESOURCE_STATE State) {
+        return { Id, State, true };
+    }
+
+    // Starts declaring a new frame.
+    void reset() {
+        m_Resources.clear();
+        m_Passes.clear();
+    }
+
+    resource import_texture(Diligent::ITexture* pTexture) {
+        resource_entry Entry;
+        Entry.texture = pTexture;
+        return add_resource(std::move(Entry));
+    }
+
+    resource import_buffer(Diligent::IBuffer* pBuffer) {
+        resource_entry Entry;
+        Entry.buffer = pBuffer;
+        return add_resource(std::move(Entry));
+    }
+
+    // A pass may list a resource more than once, for example a buffer read both as vertices and as
+    // a shader resource, or imported twice. Its accesses are merged into one per resource: read
+    // states combine, and a write can't share the resource with any other state in the same pass.
+    void add_pass(std::string Name, std::vector<access> Accesses, execute_function Execute) {
+        std::vector<access> Merged;
+        std::vector<Diligent::IDeviceObject*> Objects;
+        for (const auto& Access : Accesses) {
+            if (Access.id >= m_Resources.size()) {
+                throw std::runtime_error("Render graph pass " + Name + " uses an undeclared resource.");
+            }
+
+            auto* pObject = object(Access.id);
+            const auto Found = std::find(Objects.begin(), Objects.end(), pObject);
+            if (Found == Objects.end()) {
+                Objects.push_back(pObject);
+                Merged.push_back(Access);
+                continue;
+            }
+
+            auto& Existing = Merged[static_cast<size_t> (Found - Objects.begin())];
+            if ((Existing.write || Access.write) && Existing.state != Access.state) {
+                throw std::runtime_error("Render graph pass " + Name + " writes a resource it also uses in another state.");
+            }
+            Existing.state = Existing.state | Access.state;
+            Existing.write = Existing.write || Access.write;
+        }
+        m_Passes.push_back({ std::move(Name), std::move(Merged), std::move(Execute), {} });
+    }
+
+    void execute(Diligent::IDeviceContext* pContext) {
+        compile_barriers();
+
+        for (auto& Pass : m_Passes) {
+            if (!Pass.barriers.empty()) {
+                pContext->TransitionResourceStates(static_cast<Diligent::Uint32> (Pass.barriers.size()), Pass.barriers.data());
+            }
+            Pass.execute(pContext);
+        }
+    }
+
+private:
+    struct resource_entry {
+        Diligent::RefCntAutoPtr<Diligent::ITexture> texture;
+        Diligent::RefCntAutoPtr<Diligent::IBuffer>  buffer;
+    };
+
+    struct pass {
+        std::string                                 name;
+        std::vector<access>                         accesses;
+        execute_function                            execute;
+        std::vector<Diligent::StateTransitionDesc>  barriers;
+    };
+
+    resource add_resource(resource_entry Entry) {
+        m_Resources.push_back(std::move(Entry));
+        return static_cast<resource> (m_Resources.size() - 1);
+    }
+
+    Diligent::IDeviceObject* object(resource Id) const {
+        const auto& Entry = m_Resources[Id];
+        return Entry.texture ? static_cast<Diligent::IDeviceObject*> (Entry.texture.RawPtr()) : Entry.buffer.RawPtr();
+    }
+
+    // Follows the state of every resource through the passes, starting from the state the engine
+    // tracks, and records the transitions each pass needs.
+    void compile_barriers() {
+        using namespace Diligent;
+
+        std::unordered_map<IDeviceObject*, RESOURCE_STATE> States;
+        for (const auto& Entry : m_Resources) {
+            if (Entry.texture) {
+                States.emplace(Entry.texture.RawPtr(), Entry.texture->GetState());
+            }
+            else if (Entry.buffer) {
+                States.emplace(Entry.buffer.RawPtr(), Entry.buffer->GetState());
+            }
+        }
+
+        for (auto& Pass : m_Passes) {
+            Pass.barriers.clear();
+
+            for (const auto& Access : Pass.accesses) {
+                const auto& Entry = m_Resources[Access.id];
+                auto& State = States[object(Access.id)];
+
+                // Writes to a UAV need a barrier even in the same state, so the previous writes
+                // are visible.
+                const bool InState = (State & Access.state) == Access.state;
+                const bool UAVWrite = Access.write && Access.state == RESOURCE_STATE_UNORDERED_ACCESS && State == RESOURCE_STATE_UNORDERED_ACCESS;
+                if (InState && !UAVWrite) {
+                    continue;
+                }
+
+                // The old state is left to the engine, which knows it even if a pass changed it
+                // on its own.
+                if (Entry.texture) {
+                    Pass.barriers.emplace_back(Entry.texture, RESOURCE_STATE_UNKNOWN, Access.state, STATE_TRANSITION_FLAG_UPDATE_STATE);
+                }
+                else {
+                    Pass.barriers.emplace_back(Entry.buffer, RESOURCE_STATE_UNKNOWN, Access.state, STATE_TRANSITION_FLAG_UPDATE_STATE);
+                }
+                State = Access.state;
+            }
+        }
+    }
+
+    std::vector<resource_entry> m_Resources;
+    std::vector<pass>           m_Passes;
+};
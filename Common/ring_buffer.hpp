@@ -0,0 +1,101 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
+#include "DiligentCore/Graphics/GraphicsEngine/interface/ShaderResourceBinding.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+#include "DiligentCore/Graphics/GraphicsTools/interface/MapHelper.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Frame scoped linear allocator for dynamic constants.
+//
+// Constant blocks pushed during a frame are packed into a CPU staging area at offsets aligned to
+// the device's constant buffer offset alignment, and upload() copies them into one USAGE_DYNAMIC
+// uniform buffer with a single MAP_FLAG_DISCARD map. Shader variables are bound to the buffer once
+// with SetBufferRange and pick their slice per draw with SetBufferOffset, so N draws cost one map
+// instead of N.
+//
+// A discard map gives the buffer fresh memory, so when a frame needs more than the capacity
+// the caller can reset(), push the next batch and upload() again. Draws recorded before the
+// second upload keep reading the slices they were committed with.
+class frame_ring_buffer {
+public:
+    // Used when the device reports no alignment. Vulkan caps minUniformBufferOffsetAlignment at
+    // 256, so it satisfies every device.
+    static constexpr Diligent::Uint32 max_alignment = 256;
+
+    void create(Diligent::IRenderDevice& Device, Diligent::Uint32 Capacity, const char* Name) {
+        using namespace Diligent;
+
+        // Most desktop GPUs take 64 or fewer, which packs small per-draw blocks much tighter.
+        const Uint32 DeviceAlignment = Device.GetAdapterInfo().Buffer.ConstantBufferOffsetAlignment;
+        m_Alignment = DeviceAlignment != 0 ? DeviceAlignment : max_alignment;
+
+        BufferDesc RingDesc;
+        RingDesc.Name = Name;
+        RingDesc.Usage = USAGE_DYNAMIC;
+        RingDesc.BindFlags = BIND_UNIFORM_BUFFER;
+        RingDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+        RingDesc.Size = align(Capacity);
+        Device.CreateBuffer(RingDesc, nullptr, &m_Buffer);
+
+        m_Staging.resize(RingDesc.Size);
+        m_Cursor = 0;
+    }
+
+    // Rewinds to the start of the buffer. Call once per frame, and again per batch when a
+    // frame does not fit in the capacity.
+    void reset() {
+        m_Cursor = 0;
+    }
+
+    // Whether one block of each of the given types still fits.
+    template <typename... Data>
+    bool can_push() const {
+        return m_Cursor + (align(sizeof(Data)) + ...) <= m_Staging.size();
+    }
+
+    // Copies data into the next free slice and returns its offset in the buffer.
+    template <typename Data>
+    Diligent::Uint32 push(const Data& data) {
+        if (!can_push<Data>()) {
+            throw std::runtime_error("Frame ring buffer is out of space.");
+        }
+
+        const auto offset = m_Cursor;
+        std::memcpy(m_Staging.data() + offset, &data, sizeof(Data));
+        m_Cursor += align(sizeof(Data));
+        return offset;
+    }
+
+    void upload(Diligent::IDeviceContext* Context) {
+        Diligent::MapHelper<Diligent::Uint8> MappedBuffer(Context, m_Buffer, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
+        std::memcpy(MappedBuffer, m_Staging.data(), m_Cursor);
+    }
+
+    // Points a constant buffer variable at a sizeof(Data) window of the ring, which each draw then
+    // moves to its slice with SetBufferOffset. Static variables can't be moved, so pipelines have to
+    // declare every variable bound here mutable or dynamic.
+    template <typename Data>
+    void bind(Diligent::IShaderResourceBinding& SRB, Diligent::SHADER_TYPE ShaderType, const char* Name) const {
+        SRB.GetVariableByName(ShaderType, Name)->SetBufferRange(m_Buffer, 0, sizeof(Data));
+    }
+
+    Diligent::IBuffer* buffer() const {
+        return m_Buffer;
+    }
+
+private:
+    Diligent::Uint32 align(size_t size) const {
+        return static_cast<Diligent::Uint32> ((size + m_Alignment - 1) & ~size_t{ m_Alignment - 1 });
+    }
+
+    Diligent::Uint32                           m_Alignment = max_alignment;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer> m_Buffer;
+    std::vector<Diligent::Uint8>               m_Staging;
+    Diligent::Uint32                           m_Cursor = 0;
+};
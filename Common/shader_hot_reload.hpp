@@ -0,0 +1,125 @@
+#pragma once
+
+#include "spirv_bytecode.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Rebuilds pipelines in the background when their shader sources are edited.
+//
+// Each watch() names the source files one group of pipelines is built from, and a function that
+// builds replacements for them. A watcher thread polls the modification times of the files and
+// their #includes, and calls the build function of every group whose sources changed. The build
+// function only creates new objects, never touching the ones in use, and returns a function that
+// puts them in place. The render loop calls apply() between frames, which runs those functions, so
+// the old pipelines keep rendering until the new ones are complete and no frame waits on glslang.
+//
+// A build that throws, e.g. on a compile error, is reported and leaves the old pipelines in use;
+// saving the file again retries it.
+class shader_hot_reload {
+public:
+    using swap_function = std::function<void()>;
+    using build_function = std::function<swap_function()>;
+
+    ~shader_hot_reload() {
+        stop();
+    }
+
+    // Call before start().
+    void watch(std::vector<std::filesystem::path> Files, build_function Build) {
+        const auto Time = newest_source_time(Files);
+        m_Groups.push_back({ std::move(Files), std::move(Build), Time, Time });
+    }
+
+    void start(std::chrono::milliseconds Interval = std::chrono::milliseconds(250)) {
+        m_Thread = std::thread([this, Interval]() {
+            std::unique_lock Lock(m_Mutex);
+            while (!m_Wake.wait_for(Lock, Interval, [this]() { return m_Stop; })) {
+                Lock.unlock();
+                poll();
+                Lock.lock();
+            }
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard Lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        if (m_Thread.joinable()) {
+            m_Thread.join();
+        }
+    }
+
+    // Puts every rebuild that finished since the last call in place. Call between frames, from the
+    // thread that renders.
+    void apply() {
+        std::vector<swap_function> Ready;
+        {
+            std::lock_guard Lock(m_Mutex);
+            Ready.swap(m_Ready);
+        }
+        for (const auto& Swap : Ready) {
+            Swap();
+        }
+    }
+
+private:
+    struct group {
+        std::vector<std::filesystem::path> files;
+        build_function                     build;
+        std::filesystem::file_time_type    seen;
+        std::filesystem::file_time_type    built;
+    };
+
+    static std::filesystem::file_time_type newest_source_time(const std::vector<std::filesystem::path>& Files) {
+        auto Newest = std::filesystem::file_time_type::min();
+        for (const auto& File : Files) {
+            Newest = std::max(Newest, shader_source_time(File));
+        }
+        return Newest;
+    }
+
+    void poll() {
+        for (auto& Group : m_Groups) {
+            // max() means a file couldn't be read, which editors that replace files on save
+            // cause for a moment; the next poll sees the new file.
+            const auto Time = newest_source_time(Group.files);
+            if (Time == std::filesystem::file_time_type::max() || Time == Group.built) {
+                continue;
+            }
+            // Waits for one quiet interval, so a save still being written isn't compiled.
+            if (Time != Group.seen) {
+                Group.seen = Time;
+                continue;
+            }
+            Group.built = Time;
+
+            try {
+                auto Swap = Group.build();
+                std::lock_guard Lock(m_Mutex);
+                m_Ready.push_back(std::move(Swap));
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Shader reload failed, keeping the previous pipelines: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    std::vector<group>         m_Groups;
+    std::thread                m_Thread;
+    std::mutex                 m_Mutex;
+    std::condition_variable    m_Wake;
+    std::vector<swap_function> m_Ready;
+    bool                       m_Stop = false;
+};
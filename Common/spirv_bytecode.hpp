@@ -0,0 +1,78 @@
+#pragma once
+
+#include "DiligentCore/Graphics/GraphicsEngine/interface/Shader.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Precompiled SPIR-V written by the ShaderCompiler tool lives in a spirv folder next to the shader
+// sources, one file per source file and macro set:
+//
+//   spirv/colors.vsh.spv
+//   spirv/colors.vsh.INSTANCED=1.spv
+//
+// Each sample lists the shaders and permutations it uses in its shaders.txt.
+using shader_macro_list = std::vector<std::pair<std::string, std::string>>;
+
+inline std::filesystem::path spirv_path(const std::filesystem::path& Directory, const std::string& FilePath, shader_macro_list Macros) {
+    std::sort(Macros.begin(), Macros.end());
+
+    auto Name = FilePath;
+    for (const auto& [Macro, Value] : Macros) {
+        Name += "." + Macro + "=" + Value;
+    }
+    return Directory / "spirv" / (Name + ".spv");
+}
+
+inline shader_macro_list shader_macros(const Diligent::ShaderCreateInfo& ShaderCI) {
+    shader_macro_list Macros;
+    for (Diligent::Uint32 i = 0; i < ShaderCI.Macros.Count; ++i) {
+        Macros.emplace_back(ShaderCI.Macros.Elements[i].Name, ShaderCI.Macros.Elements[i].Definition);
+    }
+    return Macros;
+}
+
+// Newest modification time of a shader source and, recursively, of the files it #includes.
+inline std::filesystem::file_time_type shader_source_time(const std::filesystem::path& Path) {
+    std::error_code Error;
+    auto Newest = std::filesystem::last_write_time(Path, Error);
+    if (Error) {
+        return std::filesystem::file_time_type::max();
+    }
+
+    std::ifstream File(Path);
+    std::string Line;
+    while (std::getline(File, Line)) {
+        const auto Include = Line.find("#include");
+        const auto Open = Line.find('"', Include);
+        const auto Close = Line.find('"', Open + 1);
+        if (Include == std::string::npos || Open == std::string::npos || Close == std::string::npos) {
+            continue;
+        }
+        Newest = std::max(Newest, shader_source_time(Path.parent_path() / Line.substr(Open + 1, Close - Open - 1)));
+    }
+    return Newest;
+}
+
+// Returns the precompiled SPIR-V for a file based shader, or nothing when there is none or the
+// source or one of its includes has been edited since it was compiled, in which case the caller compiles the source.
+inline std::vector<Diligent::Uint8> load_spirv(const Diligent::ShaderCreateInfo& ShaderCI) {
+    if (ShaderCI.FilePath == nullptr) {
+        return {};
+    }
+
+    const auto Path = spirv_path(".", ShaderCI.FilePath, shader_macros(ShaderCI));
+
+    std::error_code Error;
+    const auto ByteCodeTime = std::filesystem::last_write_time(Path, Error);
+    if (Error || ByteCodeTime < shader_source_time(ShaderCI.FilePath)) {
+        return {};
+    }
+
+    std::ifstream File(Path, std::ios::binary);
+    return std::vector<Diligent::Uint8>(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed set of worker threads for splitting per frame CPU work. run() hands out task indices to
+// the workers and the calling thread alike and returns once every task has finished, so the
+// caller can use the results right away. Workers sleep on a condition variable between runs.
+class thread_pool {
+public:
+    // Leaves one hardware thread for the caller, which takes tasks too.
+    explicit thread_pool(unsigned ThreadCount = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+        m_Threads.reserve(ThreadCount);
+        for (unsigned i = 0; i < ThreadCount; ++i) {
+            m_Threads.emplace_back([this]() { worker(); });
+        }
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard Lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        for (auto& Thread : m_Threads) {
+            Thread.join();
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Threads taking part in run(), the caller included.
+    size_t size() const {
+        return m_Threads.size() + 1;
+    }
+
+    // Calls Task(Index) for every Index in [0, TaskCount). Not reentrant. If a task throws, no
+    // further tasks start, and once the ones already running have finished the first exception is
+    // rethrown here, whichever thread it came from.
+    void run(size_t TaskCount, const std::function<void(size_t)>& Task) {
+        if (m_Threads.empty() || TaskCount <= 1) {
+            for (size_t Index = 0; Index < TaskCount; ++Index) {
+                Task(Index);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard Lock(m_Mutex);
+            m_Task = &Task;
+            m_TaskCount = TaskCount;
+            m_NextTask = 0;
+            m_Pending = m_Threads.size();
+            m_Error = nullptr;
+            ++m_Generation;
+        }
+        m_Wake.notify_all();
+
+        drain(Task, TaskCount);
+
+        // Every worker checks in before returning, even after a task threw, so none of them can
+        // still be reading m_Task when the next run() replaces it or Task goes out of scope.
+        std::exception_ptr Error;
+        {
+            std::unique_lock Lock(m_Mutex);
+            m_Done.wait(Lock, [this]() { return m_Pending == 0; });
+            m_Task = nullptr;
+            Error = std::exchange(m_Error, nullptr);
+        }
+        if (Error) {
+            std::rethrow_exception(Error);
+        }
+    }
+
+private:
+    // Keeps the first exception for run() and hands out no more tasks after it.
+    void drain(const std::function<void(size_t)>& Task, size_t TaskCount) {
+        for (size_t Index = m_NextTask++; Index < TaskCount; Index = m_NextTask++) {
+            try {
+                Task(Index);
+            }
+            catch (...) {
+                std::lock_guard Lock(m_Mutex);
+                if (!m_Error) {
+                    m_Error = std::current_exception();
+                }
+                m_NextTask = TaskCount;
+            }
+        }
+    }
+
+    void worker() {
+        std::uint64_t Seen = 0;
+        std::unique_lock Lock(m_Mutex);
+        for (;;) {
+            m_Wake.wait(Lock, [&]() { return m_Stop || m_Generation != Seen; });
+            if (m_Stop) {
+                return;
+            }
+            Seen = m_Generation;
+
+            const auto* Task = m_Task;
+            const size_t TaskCount = m_TaskCount;
+            Lock.unlock();
+            drain(*Task, TaskCount);
+            Lock.lock();
+
+            if (--m_Pending == 0) {
+                m_Done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread>           m_Threads;
+    std::mutex                         m_Mutex;
+    std::condition_variable            m_Wake;
+    std::condition_variable            m_Done;
+    const std::function<void(size_t)>* m_Task = nullptr;
+    size_t                             m_TaskCount = 0;
+    std::atomic<size_t>                m_NextTask = 0;
+    size_t                             m_Pending = 0;
+    std::exception_ptr                 m_Error;
+    std::uint64_t                      m_Generation = 0;
+    bool                               m_Stop = false;
+};
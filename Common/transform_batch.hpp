@@ -0,0 +1,265 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__AVX__)
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define TRANSFORM_BATCH_SSE2 1
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+// Object transforms as structure of arrays (position, unit quaternion rotation, per axis scale),
+// turned into the matrices the shaders read 8 (AVX) or 4 (SSE2) objects at a time.
+//
+// For a translate * rotate * scale transform the normal matrix needs no general inverse:
+// inverse(transpose(R * S)) = R * inverse(S), so each column of the rotation is just divided by
+// its scale instead of scaled by it. Rigid transforms (scale 1) get the rotation itself.
+//
+// write_matrices() stores, per object, the model matrix and the normal matrix transposed, the way
+// Constants and InstanceData expect them, at caller given offsets inside a caller given stride.
+// That lets it fill a mapped instance buffer, or the model/inverse_transpose_model pair of a
+// constant block, directly. Only the upper 3x3 of the normal matrix is meaningful, which is all
+// the vertex shaders read.
+class transform_batch {
+public:
+#if defined(__AVX__)
+    static constexpr size_t lane_count = 8;
+#elif TRANSFORM_BATCH_SSE2
+    static constexpr size_t lane_count = 4;
+#else
+    static constexpr size_t lane_count = 1;
+#endif
+
+    void clear() {
+        m_Count = 0;
+    }
+
+    void reserve(size_t Count) {
+        const size_t Padded = (Count + 7) / 8 * 8;
+        if (Padded <= m_Capacity) {
+            return;
+        }
+
+        for (auto& Data : m_Data) {
+            aligned_floats New{ static_cast<float*> (allocate(Padded)) };
+            if (Data) {
+                std::copy(Data.get(), Data.get() + m_Count, New.get());
+            }
+            Data = std::move(New);
+        }
+        m_Capacity = Padded;
+    }
+
+    void add(const glm::vec3& Position, const glm::quat& Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& Scale = glm::vec3(1.0f)) {
+        if (m_Count == m_Capacity) {
+            reserve(std::max<size_t>(64, m_Capacity * 2));
+        }
+
+        const float Values[component_count] = {
+            Position.x, Position.y, Position.z,
+            Rotation.x, Rotation.y, Rotation.z, Rotation.w,
+            Scale.x, Scale.y, Scale.z
+        };
+        for (size_t Component = 0; Component < component_count; ++Component) {
+            m_Data[Component].get()[m_Count] = Values[Component];
+        }
+        ++m_Count;
+    }
+
+    size_t size() const {
+        return m_Count;
+    }
+
+    // Writes both matrices of objects [First, First + Count) to Dest, object i at
+    // Dest + (i - First) * Stride. Each matrix is 16 floats; ModelOffset and NormalOffset are
+    // byte offsets inside an object's Stride. Stores are unaligned and strictly sequential per
+    // object, which suits write-combined mapped memory.
+    void write_matrices(size_t First, size_t Count, void* Dest, size_t Stride, size_t ModelOffset, size_t NormalOffset) const {
+        auto* Out = static_cast<unsigned char*> (Dest);
+        size_t Index = First;
+        const size_t End = First + Count;
+
+#if defined(__AVX__) || TRANSFORM_BATCH_SSE2
+        // Aligned loads need the batch to start on a lane boundary; objects before it go one by one.
+        for (; Index < End && Index % lane_count != 0; ++Index, Out += Stride) {
+            write_one(Index, Out + ModelOffset, Out + NormalOffset);
+        }
+        for (; Index + lane_count <= End; Index += lane_count, Out += lane_count * Stride) {
+            write_batch(Index, Out, Stride, ModelOffset, NormalOffset);
+        }
+#endif
+        for (; Index < End; ++Index, Out += Stride) {
+            write_one(Index, Out + ModelOffset, Out + NormalOffset);
+        }
+    }
+
+private:
+    enum component : size_t {
+        px, py, pz, qx, qy, qz, qw, sx, sy, sz, component_count
+    };
+
+    struct aligned_delete {
+        void operator()(float* p) const {
+#if defined(_MSC_VER)
+            _aligned_free(p);
+#else
+            std::free(p);
+#endif
+        }
+    };
+    using aligned_floats = std::unique_ptr<float[], aligned_delete>;
+
+    static void* allocate(size_t Count) {
+#if defined(_MSC_VER)
+        return _aligned_malloc(Count * sizeof(float), 32);
+#else
+        return std::aligned_alloc(32, Count * sizeof(float));
+#endif
+    }
+
+    float get(component Component, size_t Index) const {
+        return m_Data[Component].get()[Index];
+    }
+
+    // Rows of the transposed matrices, i.e. rows of the matrices themselves:
+    //   model  row r = ( R[r][0] * sx,  R[r][1] * sy,  R[r][2] * sz,  p[r] ),  row 3 = (0, 0, 0, 1)
+    //   normal row r = ( R[r][0] / sx,  R[r][1] / sy,  R[r][2] / sz,  0    ),  row 3 = (0, 0, 0, 1)
+    void write_one(size_t Index, unsigned char* Model, unsigned char* Normal) const {
+        const float x = get(qx, Index), y = get(qy, Index), z = get(qz, Index), w = get(qw, Index);
+        const float R[3][3] = {
+            { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - w * z),        2.0f * (x * z + w * y) },
+            { 2.0f * (x * y + w * z),        1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z - w * x) },
+            { 2.0f * (x * z - w * y),        2.0f * (y * z + w * x),        1.0f - 2.0f * (x * x + y * y) }
+        };
+        const float S[3] = { get(sx, Index), get(sy, Index), get(sz, Index) };
+        const float P[3] = { get(px, Index), get(py, Index), get(pz, Index) };
+
+        float ModelRows[16];
+        float NormalRows[16];
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                ModelRows[r * 4 + c] = R[r][c] * S[c];
+                NormalRows[r * 4 + c] = R[r][c] / S[c];
+            }
+            ModelRows[r * 4 + 3] = P[r];
+            NormalRows[r * 4 + 3] = 0.0f;
+        }
+        const float LastRow[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        std::memcpy(ModelRows + 12, LastRow, sizeof(LastRow));
+        std::memcpy(NormalRows + 12, LastRow, sizeof(LastRow));
+
+        std::memcpy(Model, ModelRows, sizeof(ModelRows));
+        std::memcpy(Normal, NormalRows, sizeof(NormalRows));
+    }
+
+#if defined(__AVX__) || TRANSFORM_BATCH_SSE2
+    // Stores four matrix rows, one register per column holding four objects, as one row per object.
+    static void store_rows(__m128 c0, __m128 c1, __m128 c2, __m128 c3, unsigned char* Out, size_t Stride) {
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        _mm_storeu_ps(reinterpret_cast<float*> (Out), c0);
+        _mm_storeu_ps(reinterpret_cast<float*> (Out + Stride), c1);
+        _mm_storeu_ps(reinterpret_cast<float*> (Out + 2 * Stride), c2);
+        _mm_storeu_ps(reinterpret_cast<float*> (Out + 3 * Stride), c3);
+    }
+
+    // The matrix elements of four objects, in the layout write_one() documents.
+    struct elements {
+        __m128 m[3][4];
+        __m128 n[3][3];
+    };
+
+    static void store_elements(const elements& e, unsigned char* Out, size_t Stride, size_t ModelOffset, size_t NormalOffset) {
+        const __m128 Zero = _mm_setzero_ps();
+        const __m128 One = _mm_set1_ps(1.0f);
+        for (int r = 0; r < 3; ++r) {
+            store_rows(e.m[r][0], e.m[r][1], e.m[r][2], e.m[r][3], Out + ModelOffset + r * 16, Stride);
+            store_rows(e.n[r][0], e.n[r][1], e.n[r][2], Zero, Out + NormalOffset + r * 16, Stride);
+        }
+        store_rows(Zero, Zero, Zero, One, Out + ModelOffset + 48, Stride);
+        store_rows(Zero, Zero, Zero, One, Out + NormalOffset + 48, Stride);
+    }
+#endif
+
+#if defined(__AVX__)
+    void write_batch(size_t Index, unsigned char* Out, size_t Stride, size_t ModelOffset, size_t NormalOffset) const {
+        const auto load = [&](component Component) { return _mm256_load_ps(m_Data[Component].get() + Index); };
+        const __m256 x = load(qx), y = load(qy), z = load(qz), w = load(qw);
+        const __m256 Two = _mm256_set1_ps(2.0f);
+        const __m256 One = _mm256_set1_ps(1.0f);
+
+        const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        const __m256 R[3][3] = {
+            { _mm256_sub_ps(One, _mm256_mul_ps(Two, _mm256_add_ps(yy, zz))), _mm256_mul_ps(Two, _mm256_sub_ps(xy, wz)), _mm256_mul_ps(Two, _mm256_add_ps(xz, wy)) },
+            { _mm256_mul_ps(Two, _mm256_add_ps(xy, wz)), _mm256_sub_ps(One, _mm256_mul_ps(Two, _mm256_add_ps(xx, zz))), _mm256_mul_ps(Two, _mm256_sub_ps(yz, wx)) },
+            { _mm256_mul_ps(Two, _mm256_sub_ps(xz, wy)), _mm256_mul_ps(Two, _mm256_add_ps(yz, wx)), _mm256_sub_ps(One, _mm256_mul_ps(Two, _mm256_add_ps(xx, yy))) }
+        };
+        const __m256 S[3] = { load(sx), load(sy), load(sz) };
+        const __m256 InvS[3] = { _mm256_div_ps(One, S[0]), _mm256_div_ps(One, S[1]), _mm256_div_ps(One, S[2]) };
+        const __m256 P[3] = { load(px), load(py), load(pz) };
+
+        elements Low, High;
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                const __m256 m = _mm256_mul_ps(R[r][c], S[c]);
+                const __m256 n = _mm256_mul_ps(R[r][c], InvS[c]);
+                Low.m[r][c] = _mm256_castps256_ps128(m);
+                High.m[r][c] = _mm256_extractf128_ps(m, 1);
+                Low.n[r][c] = _mm256_castps256_ps128(n);
+                High.n[r][c] = _mm256_extractf128_ps(n, 1);
+            }
+            Low.m[r][3] = _mm256_castps256_ps128(P[r]);
+            High.m[r][3] = _mm256_extractf128_ps(P[r], 1);
+        }
+
+        store_elements(Low, Out, Stride, ModelOffset, NormalOffset);
+        store_elements(High, Out + 4 * Stride, Stride, ModelOffset, NormalOffset);
+    }
+#elif TRANSFORM_BATCH_SSE2
+    void write_batch(size_t Index, unsigned char* Out, size_t Stride, size_t ModelOffset, size_t NormalOffset) const {
+        const auto load = [&](component Component) { return _mm_load_ps(m_Data[Component].get() + Index); };
+        const __m128 x = load(qx), y = load(qy), z = load(qz), w = load(qw);
+        const __m128 Two = _mm_set1_ps(2.0f);
+        const __m128 One = _mm_set1_ps(1.0f);
+
+        const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        const __m128 R[3][3] = {
+            { _mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(yy, zz))), _mm_mul_ps(Two, _mm_sub_ps(xy, wz)), _mm_mul_ps(Two, _mm_add_ps(xz, wy)) },
+            { _mm_mul_ps(Two, _mm_add_ps(xy, wz)), _mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(xx, zz))), _mm_mul_ps(Two, _mm_sub_ps(yz, wx)) },
+            { _mm_mul_ps(Two, _mm_sub_ps(xz, wy)), _mm_mul_ps(Two, _mm_add_ps(yz, wx)), _mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(xx, yy))) }
+        };
+        const __m128 S[3] = { load(sx), load(sy), load(sz) };
+        const __m128 InvS[3] = { _mm_div_ps(One, S[0]), _mm_div_ps(One, S[1]), _mm_div_ps(One, S[2]) };
+
+        elements e;
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                e.m[r][c] = _mm_mul_ps(R[r][c], S[c]);
+                e.n[r][c] = _mm_mul_ps(R[r][c], InvS[c]);
+            }
+        }
+        e.m[0][3] = load(px);
+        e.m[1][3] = load(py);
+        e.m[2][3] = load(pz);
+
+        store_elements(e, Out, Stride, ModelOffset, NormalOffset);
+    }
+#endif
+
+    aligned_floats m_Data[component_count];
+    size_t         m_Count = 0;
+    size_t         m_Capacity = 0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Hands the newest value from one producer thread to one consumer thread without either waiting.
+//
+// The producer fills back() and publish()es it; the consumer reads latest(). Three slots let both
+// sides work at their own rate: the producer always has a slot the consumer isn't reading, and a
+// value published while the consumer is busy replaces the one it hasn't picked up yet, so the
+// consumer never sees anything older than the newest publish before its call.
+template <typename Value>
+class triple_buffer {
+public:
+    triple_buffer() = default;
+
+    explicit triple_buffer(const Value& Initial) {
+        m_Slots.fill(Initial);
+    }
+
+    // Producer side.
+    Value& back() {
+        return m_Slots[m_Back];
+    }
+
+    void publish() {
+        m_Back = m_Middle.exchange(m_Back | fresh, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // Consumer side. Returns the same value again while nothing new was published.
+    const Value& latest() {
+        if (m_Middle.load(std::memory_order_relaxed) & fresh) {
+            m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & index_mask;
+        }
+        return m_Slots[m_Front];
+    }
+
+private:
+    static constexpr unsigned index_mask = 3;
+    static constexpr unsigned fresh = 4;
+
+    std::array<Value, 3>  m_Slots{};
+    unsigned              m_Back = 0;
+    unsigned              m_Front = 1;
+    std::atomic<unsigned> m_Middle{ 2 };
+};
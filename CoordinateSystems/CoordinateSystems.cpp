@@ -1,10 +1,7 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
+#include "../Common/baked_texture.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -35,10 +32,7 @@ class application {
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        if (app->m_pSwapChain)
-        {
-            app->m_pSwapChain->Resize(width, height);
-        }
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -63,8 +57,8 @@ class application {
     }
 
     void initialize_glfw() {
-        constexpr auto width = 800;
-        constexpr auto height = 600;
+        const auto width = static_cast<int> (m_Options.width);
+        const auto height = static_cast<int> (m_Options.height);
 
         if (auto res = glfwInit(); res == GLFW_FALSE) {
             throw std::runtime_error("GLFW failed to initialize.");
@@ -91,30 +85,35 @@ class application {
         auto vk_factory = Diligent::GetEngineFactoryVk();
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
-        
-        auto handle = glfwGetWin32Window(window);
 
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
-            
-            SwapChainDesc SCDesc;
-            SCDesc.ColorBufferFormat = TEX_FORMAT_BGRA8_UNORM_SRGB;
-            SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        SwapChainDesc SCDesc;
+        SCDesc.ColorBufferFormat = TEX_FORMAT_BGRA8_UNORM_SRGB;
+        SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
+
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
         }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
+        }
+
+        m_PipelineCache.create(m_pDevice, "CoordinateSystems");
 
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
-        auto pDSV = m_pSwapChain->GetDepthBufferDSV();
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
+        auto pDSV = m_RenderTarget.depth_buffer_dsv();
         m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
         const glm::vec4 ClearColor = { 0.2f, 0.3f, 0.3f, 1.0f };
         m_pImmediateContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
@@ -146,7 +145,7 @@ class application {
         {
             Constants c;            
 
-            const auto& SwapChainDesc = m_pSwapChain->GetDesc();
+            const auto& SwapChainDesc = m_RenderTarget.desc();
             float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
             c.projection = glm::transpose(glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f));
 
@@ -171,7 +170,7 @@ class application {
 
                 case render_mode::rotating_cube:
                 {
-                    c.model = glm::transpose(glm::rotate(c.model, static_cast<float> (glfwGetTime()), glm::vec3(0.5f, 1.0f, 0.0f)));
+                    c.model = glm::transpose(glm::rotate(c.model, static_cast<float> (m_Loop.time()), glm::vec3(0.5f, 1.0f, 0.0f)));
                     Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
                     *CBConstants = c;
                     m_pImmediateContext->CommitShaderResources(m_pCombinedSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
@@ -221,7 +220,7 @@ class application {
         }
 
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
     void create_pipeline_state() {
@@ -231,8 +230,8 @@ class application {
         PSOCreateInfo.PSODesc.Name = "Texture PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
-        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_RenderTarget.desc().DepthBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = true;
 
@@ -249,7 +248,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Coordinate systems vertex shader";
             ShaderCI.FilePath = "coordinate_systems.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+            m_PipelineCache.create_shader(ShaderCI, &pVS);
 
             BufferDesc CBDesc;
             CBDesc.Name = "VS constants CB";
@@ -266,7 +265,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Combined Texture pixel shader";
             ShaderCI.FilePath = "combined_texture.psh";
-            m_pDevice->CreateShader(ShaderCI, &pCombinedPS);
+            m_PipelineCache.create_shader(ShaderCI, &pCombinedPS);
         }
 
         std::array LayoutElems =
@@ -306,7 +305,7 @@ class application {
         PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers = CombinedImtblSamplers.data();
         PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = CombinedImtblSamplers.size();
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pCombinedPSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pCombinedPSO);
 
         m_pCombinedPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
         
@@ -431,7 +430,7 @@ class application {
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB = true;
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\container.jpg)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("container.jpg"), loadInfo, m_pDevice, &Tex);
 
         m_ContainerTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -444,7 +443,7 @@ class application {
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB = true;
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\awesomeface.png)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("awesomeface.png"), loadInfo, m_pDevice, &Tex);
 
         m_FaceTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -458,7 +457,9 @@ class application {
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options) {
         init();
     }
 
@@ -468,26 +469,33 @@ public:
 
     void run() {
         create_pipeline_state();
+        m_PipelineCache.save();
         create_quad_buffers();
         create_cube_buffer();
         load_textures();
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
 
             render();
 
-            glfwPollEvents();
+            if (!m_Options.headless) {
+                glfwPollEvents();
+            }
         }
     }
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+
+    GLFWwindow* window = nullptr;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
 
     Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_ContainerTextureSRV;
     Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_FaceTextureSRV;
@@ -510,10 +518,10 @@ private:
     render_mode mode = render_mode::static_quad;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
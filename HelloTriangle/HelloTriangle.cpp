@@ -1,10 +1,6 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -21,7 +17,7 @@ class application {
 
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
-        app->m_pSwapChain->Resize(width, height);
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -52,7 +48,7 @@ class application {
         }
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        window = glfwCreateWindow(800, 600, "LearnDiligent", nullptr, nullptr);
+        window = glfwCreateWindow(static_cast<int> (m_Options.width), static_cast<int> (m_Options.height), "LearnDiligent", nullptr, nullptr);
 
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, &application::framebuffer_size_callback);
@@ -70,22 +66,28 @@ class application {
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
 
-        auto handle = glfwGetWin32Window(window);
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
+        }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
         }
+
+        m_PipelineCache.create(m_pDevice, "HelloTriangle");
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
 
         m_pImmediateContext->SetRenderTargets(1, &pRTV, nullptr, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
@@ -122,7 +124,7 @@ class application {
         }
 
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
     void create_pipeline_state() {
@@ -133,7 +135,7 @@ class application {
         PSOCreateInfo.PSODesc.Name = "PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_NONE;
 
@@ -162,7 +164,7 @@ void main(in  VSInput VSIn,
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Triangle vertex shader";
             ShaderCI.Source = VSSource;
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+            m_PipelineCache.create_shader(ShaderCI, &pVS);
         }
 
         const char* PSSource = R"(
@@ -190,7 +192,7 @@ void main(in  PSInput  PSIn,
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Triangle pixel shader";
             ShaderCI.Source = PSSource;
-            m_pDevice->CreateShader(ShaderCI, &pPS);
+            m_PipelineCache.create_shader(ShaderCI, &pPS);
         }
 
         std::array LayoutElems =
@@ -208,11 +210,11 @@ void main(in  PSInput  PSIn,
         // Define variable type that will be used by default
         PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
         
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pPSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pPSO);
 
         PSOCreateInfo.PSODesc.Name = "Wireframe PSO";
         PSOCreateInfo.GraphicsPipeline.RasterizerDesc.FillMode = FILL_MODE_WIREFRAME;
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pWireframePSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pWireframePSO);
     }
 
     void create_triangle_buffer() {
@@ -273,7 +275,9 @@ void main(in  PSInput  PSIn,
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options) {
         init();
     }
 
@@ -284,26 +288,33 @@ public:
     void run() {
         
         create_pipeline_state();
+        m_PipelineCache.save();
         create_triangle_buffer();
         create_quad_buffers();
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
 
             render();
 
-            glfwPollEvents();
+            if (!m_Options.headless) {
+                glfwPollEvents();
+            }
         }
     }
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+
+    GLFWwindow* window = nullptr;
     bool QuadMode = false;
     bool WireframeMode = false;
 
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>  m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext> m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>     m_pSwapChain;
+    render_target                                     m_RenderTarget;
+    pipeline_cache                                    m_PipelineCache;
     
     Diligent::RefCntAutoPtr<Diligent::IPipelineState> m_pPSO;
     Diligent::RefCntAutoPtr<Diligent::IPipelineState> m_pWireframePSO;
@@ -314,10 +325,10 @@ private:
     Diligent::RefCntAutoPtr<Diligent::IBuffer>        m_QuadIndexBuffer;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
@@ -1,46 +1,179 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
+#include "../Common/benchmark.hpp"
+#include "../Common/cube_mesh.hpp"
+#include "../Common/baked_texture.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
 
 #include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
 #include "DiligentCore/Graphics/GraphicsTools/interface/MapHelper.hpp"
+#include "DiligentCore/Graphics/GraphicsTools/interface/ShaderMacroHelper.hpp"
 
 #include "DiligentTools/TextureLoader/interface/TextureUtilities.h"
 
+#include "../Common/ring_buffer.hpp"
+#include "../Common/constant_buffer.hpp"
+#include "../Common/frame_profiler.hpp"
+#include "../Common/frustum_culling.hpp"
+#include "../Common/thread_pool.hpp"
+#include "../Common/light_clusters.hpp"
+#include "../Common/transform_batch.hpp"
+#include "../Common/shader_hot_reload.hpp"
+#include "../Common/latency_markers.hpp"
+#include "../Common/triple_buffer.hpp"
+#include "../Common/render_graph.hpp"
+#include "../Common/draw_list.hpp"
+#include "../Common/gltf_model.hpp"
+
 #include "glm/glm.hpp"
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <algorithm>
+#include <utility>
 #include <variant>
+#include <vector>
 
-struct Constants
+// The "Frame" constants of constants.fxh: the camera, uploaded once per frame when it moved.
+// Matrices are stored transposed.
+struct FrameConstants
 {
-    glm::mat4 model = glm::mat4(1.0f);
     glm::mat4 view = glm::mat4(1.0f);
     glm::mat4 projection = glm::mat4(1.0f);
-    glm::mat4 inverse_transpose_model;
+    alignas(16) glm::vec3 view_position;
+};
+
+// The matrices of one object: the "Object" constants colors.vsh reads per draw, and an entry of
+// the "Instances" structured buffer it reads when INSTANCED is set. Stored transposed. The UV
+// transform scales (xy) and offsets (zw) the decoded UVs; only glTF primitives, whose UVs are
+// quantized within their own bounds, need anything but the identity.
+struct InstanceData
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::mat4 inverse_transpose_model = glm::mat4(1.0f);
+    glm::vec4 uv_transform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
+// The "Cull" constants of cull.csh: the view frustum's planes, the camera the depth pyramid was
+// seen from (stored transposed, like the frame constants), the number of containers and the
+// pyramid's size.
+struct CullConstants
+{
+    glm::vec4 planes[6];
+    glm::mat4 previous_view = glm::mat4(1.0f);
+    glm::mat4 previous_projection = glm::mat4(1.0f);
+    Diligent::Uint32 instance_count = 0;
+    Diligent::Uint32 pyramid_valid = 0;
+    Diligent::Uint32 pyramid_size[2] = {};
+    Diligent::Uint32 pyramid_mip_count = 0;
+    Diligent::Uint32 padding[3] = {};
+};
+
+// cull.csh's "DrawArgs" buffer: the indirect draw of the containers the first cull pass lets
+// through, the one of the containers the second occlusion pass finds visible after all, and how
+// many the first one found occluded. The CPU resets it before every frame's cull passes.
+struct CullDrawArgs
+{
+    std::array<Diligent::Uint32, 5> early = cube_mesh::indirect_args();
+    std::array<Diligent::Uint32, 5> late = cube_mesh::indirect_args();
+    Diligent::Uint32 occluded_count = 0;
+};
+
+static_assert(sizeof(CullDrawArgs) == 11 * sizeof(Diligent::Uint32), "CullDrawArgs must match the DrawArgs buffer of cull.csh.");
+
+// An entry of cull.csh's "Bounds" buffer: the world space box of one container.
+struct InstanceBounds
+{
+    glm::vec4 center;
+    glm::vec4 extent;
+};
+
+// A compute pipeline with its SRB.
+struct compute_pipeline
+{
+    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         pso;
+    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> srb;
+};
+
+// The compute passes of the GPU-driven mode: the frustum-only cull, the two passes of the
+// occlusion cull, and the two that build the depth pyramid, copying the depth buffer into mip 0
+// and reducing each mip into the next.
+struct cull_pipelines
+{
+    compute_pipeline frustum;
+    compute_pipeline early;
+    compute_pipeline late;
+    compute_pipeline pyramid_copy;
+    compute_pipeline pyramid_reduce;
+};
+
+// The plain and instanced pipeline of one light type, with their SRBs.
+struct light_pipelines
+{
+    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         pso;
+    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> srb;
+    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         instanced_pso;
+    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> instanced_srb;
 };
 
+// The first ten containers keep their hand placed positions, the rest fill a 100x100 grid
+// of layers receding down -z so the field can be scaled up for stress testing.
+glm::vec3 container_position(size_t index) {
+    static const std::array cube_positions = {
+        glm::vec3(0.0f,  0.0f,  0.0f),
+        glm::vec3(2.0f,  5.0f, -15.0f),
+        glm::vec3(-1.5f, -2.2f, -2.5f),
+        glm::vec3(-3.8f, -2.0f, -12.3f),
+        glm::vec3(2.4f, -0.4f, -3.5f),
+        glm::vec3(-1.7f,  3.0f, -7.5f),
+        glm::vec3(1.3f, -2.0f, -2.5f),
+        glm::vec3(1.5f,  2.0f, -2.5f),
+        glm::vec3(1.5f,  0.2f, -1.5f),
+        glm::vec3(-1.3f,  1.0f, -1.5f)
+    };
+
+    if (index < cube_positions.size()) {
+        return cube_positions[index];
+    }
+
+    const size_t grid_index = index - cube_positions.size();
+    return glm::vec3(
+        (static_cast<float> (grid_index % 100) - 50.0f) * 3.0f,
+        (static_cast<float> ((grid_index / 100) % 100) - 50.0f) * 3.0f,
+        -20.0f - static_cast<float> (grid_index / 10000) * 3.0f);
+}
+
+glm::quat container_rotation(size_t index) {
+    const float angle = 20.0f * index;
+    return glm::angleAxis(glm::radians(angle), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
+}
+
 struct Material {
     float shininess;
 };
 
 struct Camera
 {
-    struct CB {
-        alignas(16) glm::vec3 view_position;
-    };
-
     glm::vec3 eye       = glm::vec3(0.0f, 0.0f, 3.0f);
     glm::vec3 front     = glm::vec3(0.0f, 0.0f, -1.0f);
     glm::vec3 up        = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -48,32 +181,221 @@ struct Camera
     float yaw = -90.0f;
     float pitch = 0.0f;
 
-    std::optional<float> last_x;
-    std::optional<float> last_y;
-
     double fov = 45.0;
+};
+
+glm::vec3 camera_front(float yaw, float pitch) {
+    return glm::normalize(glm::vec3{
+        std::cos(glm::radians(yaw)) * std::cos(glm::radians(pitch)),
+        std::sin(glm::radians(pitch)),
+        std::sin(glm::radians(yaw)) * std::cos(glm::radians(pitch))
+    });
+}
+
+// The camera and the clock that drives the light animation, advanced in fixed ticks apart from
+// rendering.
+//
+// Windowed, a thread ticks tick_rate times a second. Each tick applies the input the GLFW
+// callbacks gathered since the previous one, then publishes the camera from before and after the
+// tick to a triple buffer. The render thread takes the newest snapshot and interpolates between the
+// two for its frame time, trailing the simulation by up to one tick. A slow frame delays neither
+// the input nor the camera, and the camera moves smoothly at any frame rate. Headless runs tick
+// inline up to each frame's fixed time instead, so they stay deterministic.
+class simulation {
+public:
+    static constexpr double tick_rate = 120.0;
+    static constexpr double tick_time = 1.0 / tick_rate;
+
+    using clock = std::chrono::steady_clock;
+
+    enum move_flags : Diligent::Uint32 {
+        move_forward = 1,
+        move_back = 2,
+        move_left = 4,
+        move_right = 8,
+    };
+
+    struct snapshot {
+        Camera            previous;
+        Camera            current;
+        double            time = 0.0;  // simulation time of current
+        clock::time_point input_time;  // when the input current was built from was taken
+    };
+
+    struct frame_state {
+        Camera            camera;
+        double            time;
+        clock::time_point input_time;
+    };
+
+    ~simulation() {
+        stop();
+    }
+
+    void reset(const Camera& Start) {
+        m_Camera = Start;
+        m_Tick = 0;
+        auto& Snapshot = m_Snapshots.back();
+        Snapshot = { Start, Start, 0.0, clock::now() };
+        m_Snapshots.publish();
+    }
+
+    // Input, from the GLFW callbacks on the main thread.
+    void set_moving(Diligent::Uint32 Flag, bool Moving) {
+        std::lock_guard Lock(m_InputMutex);
+        m_Input.moving = Moving ? m_Input.moving | Flag : m_Input.moving & ~Flag;
+    }
+
+    void look(double X, double Y) {
+        std::lock_guard Lock(m_InputMutex);
+        m_Input.look_x += X - m_Input.cursor_x.value_or(X);
+        m_Input.look_y += m_Input.cursor_y.value_or(Y) - Y; // reversed since y-coordinates range from bottom to top
+        m_Input.cursor_x = X;
+        m_Input.cursor_y = Y;
+    }
+
+    void zoom(double Offset) {
+        std::lock_guard Lock(m_InputMutex);
+        m_Input.zoom += Offset;
+    }
+
+    void start() {
+        m_Start = clock::now();
+        m_Thread = std::thread([this]() {
+            // Tick n runs once n ticks of wall time have passed, so frames between two ticks
+            // interpolate towards the newest one.
+            const auto Period = std::chrono::duration_cast<clock::duration> (std::chrono::duration<double>(tick_time));
+            auto Next = m_Start + Period;
+            std::unique_lock Lock(m_StopMutex);
+            while (!m_Wake.wait_until(Lock, Next, [this]() { return m_Stop; })) {
+                Lock.unlock();
+                tick(std::chrono::duration<double>(Next - m_Start).count());
+                Lock.lock();
+
+                // After a stall, e.g. in a debugger, skips the missed ticks instead of replaying
+                // them back to back; the camera just doesn't move for that time.
+                Next += Period;
+                if (Next < clock::now() - std::chrono::milliseconds(250)) {
+                    Next = clock::now();
+                }
+            }
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard Lock(m_StopMutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        if (m_Thread.joinable()) {
+            m_Thread.join();
+        }
+    }
+
+    // Headless: ticks on the calling thread until the simulation reaches Time.
+    void advance_to(double Time) {
+        while ((m_Tick + 1) * tick_time <= Time) {
+            tick((m_Tick + 1) * tick_time);
+        }
+    }
+
+    // Seconds of wall time since start(), the frame time of windowed runs.
+    double elapsed() const {
+        return std::chrono::duration<double>(clock::now() - m_Start).count();
+    }
+
+    // The camera and animation time to render at FrameTime, one tick behind the simulation.
+    frame_state frame(double FrameTime) {
+        const auto& Snapshot = m_Snapshots.latest();
+        const float t = static_cast<float> (std::clamp((FrameTime - Snapshot.time) / tick_time, 0.0, 1.0));
+
+        frame_state State{ Snapshot.current, Snapshot.time - tick_time * (1.0 - t), Snapshot.input_time };
+        State.camera.eye = glm::mix(Snapshot.previous.eye, Snapshot.current.eye, t);
+        State.camera.yaw = glm::mix(Snapshot.previous.yaw, Snapshot.current.yaw, t);
+        State.camera.pitch = glm::mix(Snapshot.previous.pitch, Snapshot.current.pitch, t);
+        State.camera.fov = glm::mix(Snapshot.previous.fov, Snapshot.current.fov, static_cast<double> (t));
+        State.camera.front = camera_front(State.camera.yaw, State.camera.pitch);
+        return State;
+    }
 
-    CB create_buffer() const {
-        return CB{ .view_position = eye };
+private:
+    struct input_state {
+        Diligent::Uint32      moving = 0;
+        double                look_x = 0.0;
+        double                look_y = 0.0;
+        double                zoom = 0.0;
+        std::optional<double> cursor_x;
+        std::optional<double> cursor_y;
+    };
+
+    // Advances the camera by one tick, ending at simulation time Time.
+    void tick(double Time) {
+        input_state Input;
+        clock::time_point InputTime;
+        {
+            std::lock_guard Lock(m_InputMutex);
+            Input = m_Input;
+            InputTime = clock::now();
+            m_Input.look_x = 0.0;
+            m_Input.look_y = 0.0;
+            m_Input.zoom = 0.0;
+        }
+
+        const Camera Previous = m_Camera;
+
+        const float sensitivity = 0.1f;
+        m_Camera.yaw += static_cast<float> (Input.look_x) * sensitivity;
+        m_Camera.pitch = std::clamp(m_Camera.pitch + static_cast<float> (Input.look_y) * sensitivity, -89.0f, 89.0f);
+        m_Camera.front = camera_front(m_Camera.yaw, m_Camera.pitch);
+        m_Camera.fov = std::clamp(m_Camera.fov - Input.zoom, 1.0, 45.0);
+
+        const float camera_speed = static_cast<float> (2.5 * tick_time);
+        const glm::vec3 right = glm::normalize(glm::cross(m_Camera.front, m_Camera.up));
+        if (Input.moving & move_forward)
+            m_Camera.eye += camera_speed * m_Camera.front;
+        if (Input.moving & move_back)
+            m_Camera.eye -= camera_speed * m_Camera.front;
+        if (Input.moving & move_left)
+            m_Camera.eye -= right * camera_speed;
+        if (Input.moving & move_right)
+            m_Camera.eye += right * camera_speed;
+
+        ++m_Tick;
+
+        auto& Snapshot = m_Snapshots.back();
+        Snapshot = { Previous, m_Camera, Time, InputTime };
+        m_Snapshots.publish();
     }
+
+    Camera                  m_Camera;
+    Diligent::Uint64        m_Tick = 0;
+    triple_buffer<snapshot> m_Snapshots;
+
+    std::mutex              m_InputMutex;
+    input_state             m_Input;
+
+    clock::time_point       m_Start = clock::now();
+    std::thread             m_Thread;
+    std::mutex              m_StopMutex;
+    std::condition_variable m_Wake;
+    bool                    m_Stop = false;
 };
 
 
+// Per frame or per pass constants: the copy the frame fills in, and the buffer that holds what
+// the GPU last got. Update() uploads only when data changed; the buffer is bound once per SRB.
 template <typename Data>
 struct Resource {
-    Diligent::RefCntAutoPtr<Diligent::IBuffer> buffer;
     Data data;
+    constant_buffer<Data> buffer;
 
-    void CreateBuffer(Diligent::IRenderDevice& Device, Diligent::BufferDesc PartialDesc, const char* Name) {
-        PartialDesc.Name = Name;
-        PartialDesc.Size = sizeof(Data);
-        Device.CreateBuffer(PartialDesc, nullptr, &buffer);
+    void Update(Diligent::IDeviceContext* pContext) {
+        buffer.update(pContext, data);
     }
 
-    void Map(Diligent::IDeviceContext* ImmediateContext) {
-        Diligent::MapHelper<Data> MappedBuffer (ImmediateContext, buffer, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-
-        *MappedBuffer = data;
+    void Bind(Diligent::IShaderResourceBinding& SRB, Diligent::SHADER_TYPE ShaderType, const char* Name) const {
+        buffer.bind(SRB, ShaderType, Name);
     }
 };
 
@@ -95,6 +417,7 @@ struct PointLight {
     float constant;
     float linear;
     float quadratic;
+    float range;
 };
 
 struct SpotLight {
@@ -106,6 +429,43 @@ struct SpotLight {
     alignas(16) glm::vec3 ambient;
     alignas(16) glm::vec3 diffuse;
     alignas(16) glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+    float range;
+};
+
+// Point and spot lights are drawn clustered: the light selected with 2/3 is element 0 of a
+// structured buffer, followed by light_count - 1 generated lights orbiting through the scene.
+// Their layouts match the Light structs of point_light.psh and spot_light.psh, std430 style.
+static_assert(sizeof(PointLight) == 80, "PointLight must match the Lights buffer of point_light.psh.");
+static_assert(sizeof(SpotLight) == 96, "SpotLight must match the Lights buffer of spot_light.psh.");
+
+// Constants of the all lights mode (multi_light.psh). Point and spot lights come from the
+// clustered buffers; the counts tell the shader where the point lights end in the cluster lists.
+struct LightSet {
+    static constexpr Diligent::Uint32 max_directional = 4;
+
+    DirectionalLight directional[max_directional];
+    Diligent::Uint32 directional_count = 0;
+    Diligent::Uint32 point_count = 0;
+    Diligent::Uint32 spot_count = 0;
+};
+
+// Which per pass constants a lighting mode reads: the "Lights" constant buffer, the "Clusters"
+// constant buffer with the clustered light buffers, or both.
+template <typename Light>
+constexpr bool has_light_constants = !std::is_same_v<Light, PointLight> && !std::is_same_v<Light, SpotLight>;
+
+template <typename Light>
+constexpr bool is_clustered = !std::is_same_v<Light, DirectionalLight>;
+
+struct light_orbit {
+    glm::vec3 center;
+    float     radius;
+    float     speed;
+    float     phase;
 };
 
 struct light_setting_visitor {
@@ -129,77 +489,169 @@ struct light_setting_visitor {
 
 };
 
+// The frame-rate caps F steps through, 0 being none.
+Diligent::Uint32 next_fps_limit(Diligent::Uint32 Limit) {
+    constexpr std::array<Diligent::Uint32, 4> Limits = { 0, 30, 60, 120 };
+    const auto Next = std::upper_bound(Limits.begin(), Limits.end(), Limit);
+    return Next == Limits.end() ? Limits.front() : *Next;
+}
+
 class application {
+    // The GLFW callbacks run on the main thread while the render thread draws, so they only record
+    // what happened: movement goes to the simulation, everything else is queued for
+    // handle_window_events() at the start of the next frame.
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        if (app->m_pSwapChain)
-        {
-            app->m_pSwapChain->Resize(width, height);
-        }
+        std::lock_guard lock(app->m_WindowEventsMutex);
+        app->m_PendingSize = { width, height };
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        if (action == GLFW_PRESS) {
-            switch (key) {
-            case GLFW_KEY_ESCAPE:
+        if (const auto flag = move_flag(key); flag && action != GLFW_REPEAT) {
+            app->m_Simulation.set_moving(flag, action == GLFW_PRESS);
+        }
+        else if (action == GLFW_PRESS) {
+            if (key == GLFW_KEY_ESCAPE) {
                 glfwSetWindowShouldClose(window, true);
-                break;
-            case GLFW_KEY_1:
-                app->PSO_use = app->m_pDirectionalLightPSO;
-                app->SRB_use = app->m_pDirectionalLightSRB;
-                app->light_use = std::ref(std::get<Resource<DirectionalLight>>(app->lights));
-                break;
-            case GLFW_KEY_2:
-                app->PSO_use = app->m_pPointLightPSO;
-                app->SRB_use = app->m_pPointLightSRB;
-                app->light_use = std::ref(std::get<Resource<PointLight>>(app->lights));
-                break;
-            case GLFW_KEY_3:
-                app->PSO_use = app->m_pSpotLightPSO;
-                app->SRB_use = app->m_pSpotLightSRB;
-                app->light_use = std::ref(std::get<Resource<SpotLight>>(app->lights));
-                break;
+                return;
             }
+            std::lock_guard lock(app->m_WindowEventsMutex);
+            app->m_PendingKeys.push_back(key);
+        }
+    }
+
+    static Diligent::Uint32 move_flag(int key) {
+        switch (key) {
+        case GLFW_KEY_W: return simulation::move_forward;
+        case GLFW_KEY_S: return simulation::move_back;
+        case GLFW_KEY_A: return simulation::move_left;
+        case GLFW_KEY_D: return simulation::move_right;
+        default:         return 0;
         }
     }
 
     static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        float xoffset = xpos - app->camera.last_x.value_or(xpos);
-        float yoffset = app->camera.last_y.value_or(ypos) - ypos; // reversed since y-coordinates range from bottom to top
-        app->camera.last_x = xpos;
-        app->camera.last_y = ypos;
-
-        const float sensitivity = 0.1f;
-        xoffset *= sensitivity;
-        yoffset *= sensitivity;
-
-        app->camera.yaw += xoffset;
-        app->camera.pitch = std::clamp(app->camera.pitch + yoffset, -89.0f, 89.0f);
-
-        glm::vec3 direction = glm::vec3{
-            std::cos(glm::radians(app->camera.yaw)) * std::cos(glm::radians(app->camera.pitch)),
-            std::sin(glm::radians(app->camera.pitch)),
-            std::sin(glm::radians(app->camera.yaw))* std::cos(glm::radians(app->camera.pitch))
-        };
-
-        app->camera.front = glm::normalize(direction);
+        app->m_Simulation.look(xpos, ypos);
     }
 
     static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        app->camera.fov = std::clamp(app->camera.fov - yoffset, 1.0, 45.0);
+        app->m_Simulation.zoom(yoffset);
+    }
+
+    void handle_window_events() {
+        std::vector<int> keys;
+        std::optional<std::pair<int, int>> size;
+        {
+            std::lock_guard lock(m_WindowEventsMutex);
+            keys.swap(m_PendingKeys);
+            size.swap(m_PendingSize);
+        }
+
+        if (size) {
+            m_RenderTarget.resize(size->first, size->second);
+        }
+        for (const int key : keys) {
+            handle_key(key);
+        }
+    }
+
+    void handle_key(int key) {
+        switch (key) {
+        case GLFW_KEY_1:
+            pipelines_use = &m_DirectionalLightPipelines;
+            light_use = std::ref(std::get<Resource<DirectionalLight>>(lights));
+            break;
+        case GLFW_KEY_2:
+            pipelines_use = &m_PointLightPipelines;
+            light_use = std::ref(std::get<Resource<PointLight>>(lights));
+            break;
+        case GLFW_KEY_3:
+            pipelines_use = &m_SpotLightPipelines;
+            light_use = std::ref(std::get<Resource<SpotLight>>(lights));
+            break;
+        case GLFW_KEY_4:
+            pipelines_use = &m_MultiLightPipelines;
+            light_use = std::ref(std::get<Resource<LightSet>>(lights));
+            break;
+        case GLFW_KEY_I:
+            switch (mode) {
+            case render_mode::per_draw:
+                mode = render_mode::instanced;
+                std::cout << "instanced\n";
+                break;
+            case render_mode::instanced:
+                mode = render_mode::gpu_driven;
+                std::cout << "gpu driven\n";
+                break;
+            case render_mode::gpu_driven:
+                mode = render_mode::per_draw;
+                std::cout << "per draw\n";
+                break;
+            }
+            break;
+        case GLFW_KEY_O:
+            occlusion_culling = !occlusion_culling;
+            std::cout << "occlusion culling " << (occlusion_culling ? "on" : "off") << "\n";
+            break;
+        case GLFW_KEY_EQUAL:
+            container_count = std::min(container_count * 10, max_container_count);
+            std::cout << container_count << " containers\n";
+            break;
+        case GLFW_KEY_MINUS:
+            container_count = std::max(container_count / 10, min_container_count);
+            std::cout << container_count << " containers\n";
+            break;
+        case GLFW_KEY_RIGHT_BRACKET:
+            light_count = std::min(light_count * 10, max_light_count);
+            std::cout << light_count << " lights\n";
+            break;
+        case GLFW_KEY_LEFT_BRACKET:
+            light_count = std::max(light_count / 10, size_t{ 1 });
+            std::cout << light_count << " lights\n";
+            break;
+        case GLFW_KEY_V:
+            m_RenderTarget.set_present_mode(next_present_mode(m_RenderTarget.current_present_mode()));
+            std::cout << "present mode " << present_mode_name(m_RenderTarget.current_present_mode()) << "\n";
+            break;
+        case GLFW_KEY_F:
+        {
+            const auto limit = next_fps_limit(m_Loop.fps_limit());
+            m_Loop.set_fps_limit(limit);
+            if (limit) {
+                std::cout << "fps limit " << limit << "\n";
+            }
+            else {
+                std::cout << "fps unlimited\n";
+            }
+        }
+            break;
+        case GLFW_KEY_L:
+            m_Latency.set_reporting(!m_Latency.reporting());
+            break;
+        case GLFW_KEY_P:
+            if (m_Profiler.capturing()) {
+                stop_trace();
+            }
+            else {
+                m_Profiler.clear();
+                m_Profiler.set_capturing(true);
+                std::cout << "capturing trace\n";
+            }
+            break;
+        }
     }
 
     void initialize_glfw() {
-        constexpr auto width = 800;
-        constexpr auto height = 600;
+        const auto width = static_cast<int> (m_Options.width);
+        const auto height = static_cast<int> (m_Options.height);
 
         if (auto res = glfwInit(); res == GLFW_FALSE) {
             throw std::runtime_error("GLFW failed to initialize.");
@@ -226,43 +678,77 @@ class application {
         using namespace Diligent;
 
         EngineVkCreateInfo engine_ci;
+        // Per-draw mode uploads an InstanceData slice per container through the frame ring, one
+        // megabyte batch at a time, which outgrows the default 8MB dynamic heap quickly.
+        engine_ci.DynamicHeapSize = 128 << 20;
+        engine_ci.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+        // The GPU-driven mode culls in a compute shader.
+        engine_ci.Features.ComputeShaders = DEVICE_FEATURE_STATE_ENABLED;
 
         auto vk_factory = Diligent::GetEngineFactoryVk();
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
 
-        auto handle = glfwGetWin32Window(window);
+        SwapChainDesc SCDesc;
+        SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
+        SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
-
-            SwapChainDesc SCDesc;
-            SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
-            SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        // The GPU-driven mode builds its depth pyramid from the depth buffer.
+        m_RenderTarget.set_readable_depth(true);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
         }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
+        }
+
+        m_PipelineCache.create(m_pDevice, "LightCasters");
+        m_Benchmark.create(m_pDevice);
+
+        m_Profiler.create(m_pDevice);
+        m_Profiler.set_capturing(!m_Options.trace_path.empty());
 
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        apply_draw_options();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
-    void process_input(float delta)
-    {
-        const float camera_speed = 2.5f * delta;
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            camera.eye += camera_speed * camera.front;
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            camera.eye -= camera_speed * camera.front;
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-            camera.eye -= glm::normalize(glm::cross(camera.front, camera.up)) * camera_speed;
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-            camera.eye += glm::normalize(glm::cross(camera.front, camera.up)) * camera_speed;
+    // --draw-mode, --containers and --no-occlusion-culling, so headless and benchmark runs can
+    // pick what I, =/- and O pick in a window.
+    void apply_draw_options() {
+        if (m_Options.draw_mode == "instanced") {
+            mode = render_mode::instanced;
+        }
+        else if (m_Options.draw_mode == "gpu-driven") {
+            mode = render_mode::gpu_driven;
+        }
+        else if (!m_Options.draw_mode.empty() && m_Options.draw_mode != "per-draw") {
+            throw std::runtime_error("Unknown draw mode " + m_Options.draw_mode + ", expected per-draw, instanced or gpu-driven.");
+        }
 
+        if (m_Options.container_count != 0) {
+            container_count = std::clamp<size_t>(m_Options.container_count, min_container_count, max_container_count);
+        }
+        occlusion_culling = m_Options.occlusion_culling;
+    }
+
+    // Takes the camera and animation time for this frame from the simulation.
+    void update_scene(double frame_time) {
+        const auto state = m_Simulation.frame(frame_time);
+        camera = state.camera;
+        if (m_Benchmark.enabled()) {
+            frame_benchmark::place_camera(camera, m_Loop.time());
+        }
+        m_AnimationTime = state.time;
+        m_Latency.input(state.input_time);
 
         auto& spot_light = std::get<Resource<SpotLight>>(lights);
         spot_light.data.position = camera.eye;
@@ -270,177 +756,706 @@ class application {
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
-        auto pDSV = m_pSwapChain->GetDepthBufferDSV();
-        m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-        const glm::vec4 ClearColor = { 0.1f, 0.1f, 0.1f, 1.0f };
-        m_pImmediateContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-        m_pImmediateContext->ClearDepthStencil(pDSV, Diligent::CLEAR_DEPTH_FLAG, 1.f, 0, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
-        {
-            m_pImmediateContext->SetPipelineState(PSO_use);
-
-            Diligent::Uint64 offset = 0;
-            std::array pBuffs = { m_CubeVertexBuffer.RawPtr() };
-            m_pImmediateContext->SetVertexBuffers(0, pBuffs.size(), pBuffs.data(), &offset, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION, Diligent::SET_VERTEX_BUFFERS_FLAG_RESET);
-
-            glm::mat4 light_model(1.0f);
+        using namespace Diligent;
 
-            const glm::vec4 light_pos = (light_model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
-            {
-                std::visit([this](auto& LightResource) {
+        glm::mat4 light_model(1.0f);
 
-                    LightResource.get().Map(m_pImmediateContext);
+        // Hi-Z occlusion culling: the GPU-driven mode culls and draws in two passes around a depth
+        // pyramid build, see cull.csh.
+        const bool occlusion = mode == render_mode::gpu_driven && occlusion_culling;
 
-                }, light_use);
-            }
+        {
+            const auto cpu_scope = m_Profiler.cpu("Update constants");
 
             if (auto point_light_use = std::get_if<std::reference_wrapper<Resource<PointLight>>>(&light_use)) {
                 light_model = glm::translate(light_model, point_light_use->get().data.position);
             }
+            else if (std::holds_alternative<std::reference_wrapper<Resource<LightSet>>>(light_use)) {
+                light_model = glm::translate(light_model, std::get<Resource<PointLight>>(lights).data.position);
+            }
             else if (auto directional_light_use = std::get_if<std::reference_wrapper<Resource<DirectionalLight>>>(&light_use)) {
                 light_model = glm::translate(light_model, directional_light_use->get().data.direction);
             }
 
+            material.data.shininess = 64.0f;
 
             {
-                Diligent::MapHelper<Camera::CB> CBCamera(m_pImmediateContext, m_PSCamera, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
+                const auto& SwapChainDesc = m_RenderTarget.desc();
+                const float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
+                const float fov = glm::radians(static_cast<float> (camera.fov));
+                const glm::mat4 view = glm::lookAt(camera.eye, camera.eye + camera.front, camera.up);
+                const glm::mat4 projection = glm::perspective(fov, aspect, 0.1f, 100.0f);
+
+                // The camera of the previous frame, the one its depth pyramid was seen from.
+                cull_constants.data.previous_view = frame_constants.data.view;
+                cull_constants.data.previous_projection = frame_constants.data.projection;
+                frame_constants.data.view = glm::transpose(view);
+                frame_constants.data.projection = glm::transpose(projection);
+                frame_constants.data.view_position = camera.eye;
+
+                if (std::holds_alternative<std::reference_wrapper<Resource<PointLight>>>(light_use)) {
+                    update_clustered_lights(light_count, 0, view, fov, aspect);
+                }
+                else if (std::holds_alternative<std::reference_wrapper<Resource<SpotLight>>>(light_use)) {
+                    update_clustered_lights(0, light_count, view, fov, aspect);
+                }
+                else if (std::holds_alternative<std::reference_wrapper<Resource<LightSet>>>(light_use)) {
+                    update_clustered_lights(light_count, light_count, view, fov, aspect);
+
+                    auto& light_set = std::get<Resource<LightSet>>(lights).data;
+                    light_set.directional[0] = std::get<Resource<DirectionalLight>>(lights).data;
+                    light_set.directional_count = 1;
+                    light_set.point_count = static_cast<Uint32> (light_count);
+                    light_set.spot_count = static_cast<Uint32> (light_count);
+                }
 
-                *CBCamera = camera.create_buffer();
+                const auto cull_scope = m_Profiler.cpu("Cull");
+                if (m_ContainerTransformsCount != container_count) {
+                    create_container_transforms();
+                }
+                const auto view_frustum = frustum::from_matrix(projection * view);
+                if (mode == render_mode::gpu_driven) {
+                    // cull.csh tests the containers instead, so the CPU cost doesn't grow with them.
+                    std::copy(view_frustum.planes.begin(), view_frustum.planes.end(), cull_constants.data.planes);
+                    cull_constants.data.instance_count = static_cast<Uint32> (container_count);
+                    m_VisibleContainers.clear();
+                }
+                else {
+                    m_ContainerBounds.cull(view_frustum, m_VisibleContainers);
+                }
+                // The model draws one primitive at a time in every mode, so it is always culled here.
+                m_ModelBounds.cull(view_frustum, m_VisibleModelInstances);
             }
 
-            Constants c;
             {
-                const auto& SwapChainDesc = m_pSwapChain->GetDesc();
-                const float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
-                c.view = glm::transpose(glm::lookAt(camera.eye, camera.eye + camera.front, camera.up));
-                c.projection = glm::transpose(glm::perspective(glm::radians(static_cast<float> (camera.fov)), aspect, 0.1f, 100.0f));
-            }
+                const auto sort_scope = m_Profiler.cpu("Sort draws");
 
-            Diligent::DrawAttribs DrawAttrs;
-            DrawAttrs.NumVertices = 36;
-            DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
+                // The containers share one pipeline and binding, so they only sort front to back.
+                // The model's primitives come after them, then the light cube with its own pipeline.
+                const auto view_depth = [&](const glm::vec3& position) {
+                    return draw_list::quantize_depth(glm::dot(position - camera.eye, camera.front), 0.1f, 100.0f);
+                };
 
-            const auto render_cube = [&](const glm::mat4& model) {
-                {
-                    c.model = glm::transpose(model);
-                    c.inverse_transpose_model = glm::transpose(glm::transpose(glm::inverse(model)));
+                m_DrawList.clear();
+                m_DrawList.reserve(m_VisibleContainers.size() + m_VisibleModelInstances.size() + 1);
+                for (const auto container : m_VisibleContainers) {
+                    m_DrawList.submit(draw_list::make_key(0, static_cast<Uint32> (draw_pipeline::container), 0, 0, view_depth(m_ContainerBounds.center(container))), container);
+                }
+                if (mode == render_mode::gpu_driven) {
+                    // One indirect draw stands for all of them.
+                    m_DrawList.submit(draw_list::make_key(0, static_cast<Uint32> (draw_pipeline::container), 0, 0, 0), 0);
+                }
+                for (const auto instance : m_VisibleModelInstances) {
+                    m_DrawList.submit(draw_list::make_key(0, static_cast<Uint32> (draw_pipeline::model), 0, 0, view_depth(m_ModelBounds.center(instance))), instance);
+                }
+                m_DrawList.submit(draw_list::make_key(0, static_cast<Uint32> (draw_pipeline::light_cube), 0, 0, view_depth(glm::vec3(light_model[3]))), 0);
+                m_DrawList.sort();
+
+                // In draw order, which is also the order of the instanced draw's instances.
+                if (mode != render_mode::gpu_driven) {
+                    m_VisibleContainers.clear();
+                    for (size_t i = 0; i < m_DrawList.size(); ++i) {
+                        if (draw_list::pipeline(m_DrawList[i].key) == static_cast<Uint32> (draw_pipeline::container)) {
+                            m_VisibleContainers.push_back(m_DrawList[i].index);
+                        }
+                    }
+                }
+            }
 
-                    Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-                    *CBConstants = c;
+            light_cube_object.model = glm::transpose(glm::scale(light_model, glm::vec3(0.2f)));
+
+            // The frame and pass constants go up once, and only when they changed. The SRBs
+            // were bound to their buffers when they were created.
+            std::visit([this](auto& LightResource) {
+                using light_type = decltype(LightResource.get().data);
+                if constexpr (has_light_constants<light_type>) {
+                    LightResource.get().Update(m_pImmediateContext);
                 }
-                {
-                    Diligent::MapHelper<Material> CBMaterial(m_pImmediateContext, m_PSMaterial, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-                    CBMaterial->shininess = 64.0f;
+                if constexpr (is_clustered<light_type>) {
+                    cluster_buffer.Update(m_pImmediateContext);
                 }
+            }, light_use);
+            material.Update(m_pImmediateContext);
+            frame_constants.Update(m_pImmediateContext);
 
-                m_pImmediateContext->CommitShaderResources(SRB_use, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-                m_pImmediateContext->Draw(DrawAttrs);
-            };
+            if (mode != render_mode::per_draw && m_InstanceBufferCount != container_count) {
+                create_instance_buffer();
+            }
+            if (mode == render_mode::instanced && !m_VisibleContainers.empty()) {
+                m_pImmediateContext->UpdateBuffer(m_VisibleInstanceBuffer, 0, m_VisibleContainers.size() * sizeof(Uint32), m_VisibleContainers.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+            }
+            if (occlusion) {
+                const auto& DepthDesc = m_RenderTarget.desc();
+                if (!m_DepthPyramid || m_DepthPyramid->GetDesc().Width != DepthDesc.Width || m_DepthPyramid->GetDesc().Height != DepthDesc.Height) {
+                    create_depth_pyramid();
+                }
 
-            {
-                std::array cube_positions = {
-                    glm::vec3(0.0f,  0.0f,  0.0f),
-                    glm::vec3(2.0f,  5.0f, -15.0f),
-                    glm::vec3(-1.5f, -2.2f, -2.5f),
-                    glm::vec3(-3.8f, -2.0f, -12.3f),
-                    glm::vec3(2.4f, -0.4f, -3.5f),
-                    glm::vec3(-1.7f,  3.0f, -7.5f),
-                    glm::vec3(1.3f, -2.0f, -2.5f),
-                    glm::vec3(1.5f,  2.0f, -2.5f),
-                    glm::vec3(1.5f,  0.2f, -1.5f),
-                    glm::vec3(-1.3f,  1.0f, -1.5f)
-                };
+                // Until a frame has built the pyramid at this size, the first pass draws every
+                // container in the frustum and the second has nothing to test.
+                const auto& PyramidDesc = m_DepthPyramid->GetDesc();
+                cull_constants.data.pyramid_valid = m_DepthPyramidValid ? 1 : 0;
+                cull_constants.data.pyramid_size[0] = PyramidDesc.Width;
+                cull_constants.data.pyramid_size[1] = PyramidDesc.Height;
+                cull_constants.data.pyramid_mip_count = PyramidDesc.MipLevels;
+            }
+            if (mode == render_mode::gpu_driven) {
+                cull_constants.Update(m_pImmediateContext);
 
-                int i = 0;
+                // The cull passes count the visible containers into the instance counts.
+                const CullDrawArgs DrawArgs;
+                m_pImmediateContext->UpdateBuffer(m_DrawArgsBuffer, 0, sizeof(DrawArgs), &DrawArgs, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+            }
+        }
+
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
+        auto pDSV = m_RenderTarget.depth_buffer_dsv();
+
+        // Everything the scene pass touches, so the graph can move it into place with one batch
+        // of transitions and the draws only verify.
+        m_Graph.reset();
+
+        const auto RenderTarget = m_Graph.import_texture(pRTV->GetTexture());
+        const auto Depth = m_Graph.import_texture(pDSV->GetTexture());
+
+        render_graph::resource Bounds = 0, CullCB = 0, Visible = 0, DrawArgs = 0, Occluded = 0, Pyramid = 0;
+        if (mode == render_mode::gpu_driven) {
+            Bounds = m_Graph.import_buffer(m_InstanceBoundsBuffer);
+            CullCB = m_Graph.import_buffer(cull_constants.buffer.buffer());
+            Visible = m_Graph.import_buffer(m_VisibleInstanceBuffer);
+            DrawArgs = m_Graph.import_buffer(m_DrawArgsBuffer);
+        }
+
+        if (occlusion) {
+            Occluded = m_Graph.import_buffer(m_OccludedInstanceBuffer);
+            Pyramid = m_Graph.import_texture(m_DepthPyramid);
+
+            m_Graph.add_pass("Early cull", {
+                render_graph::read(Bounds, RESOURCE_STATE_SHADER_RESOURCE),
+                render_graph::read(CullCB, RESOURCE_STATE_CONSTANT_BUFFER),
+                render_graph::read(Pyramid, RESOURCE_STATE_SHADER_RESOURCE),
+                render_graph::write(Visible, RESOURCE_STATE_UNORDERED_ACCESS),
+                render_graph::write(Occluded, RESOURCE_STATE_UNORDERED_ACCESS),
+                render_graph::write(DrawArgs, RESOURCE_STATE_UNORDERED_ACCESS),
+            }, [this](IDeviceContext* pContext) {
+                const auto gpu_scope = m_Profiler.gpu(pContext, "Early cull pass");
+                dispatch_cull(pContext, m_CullPipelines.early);
+            });
+        }
+        else if (mode == render_mode::gpu_driven) {
+            m_Graph.add_pass("Cull", {
+                render_graph::read(Bounds, RESOURCE_STATE_SHADER_RESOURCE),
+                render_graph::read(CullCB, RESOURCE_STATE_CONSTANT_BUFFER),
+                render_graph::write(Visible, RESOURCE_STATE_UNORDERED_ACCESS),
+                render_graph::write(DrawArgs, RESOURCE_STATE_UNORDERED_ACCESS),
+            }, [this](IDeviceContext* pContext) {
+                const auto gpu_scope = m_Profiler.gpu(pContext, "Cull pass");
+                dispatch_cull(pContext, m_CullPipelines.frustum);
+            });
+        }
 
-                Diligent::DrawAttribs DrawAttrs;
-                DrawAttrs.NumVertices = 36;
-                DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
+        std::vector<render_graph::access> SceneAccesses = {
+            render_graph::write(RenderTarget, RESOURCE_STATE_RENDER_TARGET),
+            render_graph::write(Depth, RESOURCE_STATE_DEPTH_WRITE),
+        };
+        const auto read_buffer = [&](IBuffer* pBuffer, RESOURCE_STATE State) {
+            SceneAccesses.push_back(render_graph::read(m_Graph.import_buffer(pBuffer), State));
+        };
+        const auto read_texture = [&](ITextureView* pView) {
+            if (pView != nullptr) {
+                SceneAccesses.push_back(render_graph::read(m_Graph.import_texture(pView->GetTexture()), RESOURCE_STATE_SHADER_RESOURCE));
+            }
+        };
 
-                for (const auto& cube_position : cube_positions)
+        read_buffer(m_CubeMesh.vertex_buffer(), RESOURCE_STATE_VERTEX_BUFFER);
+        read_buffer(m_CubeMesh.index_buffer(), RESOURCE_STATE_INDEX_BUFFER);
+        if (!m_VisibleModelInstances.empty()) {
+            read_buffer(m_Model.vertex_buffer(), RESOURCE_STATE_VERTEX_BUFFER);
+            read_buffer(m_Model.index_buffer(), RESOURCE_STATE_INDEX_BUFFER);
+        }
+        read_buffer(frame_constants.buffer.buffer(), RESOURCE_STATE_CONSTANT_BUFFER);
+        read_buffer(material.buffer.buffer(), RESOURCE_STATE_CONSTANT_BUFFER);
+        std::visit([&](auto& LightResource) {
+            using light_type = decltype(LightResource.get().data);
+            if constexpr (has_light_constants<light_type>) {
+                read_buffer(LightResource.get().buffer.buffer(), RESOURCE_STATE_CONSTANT_BUFFER);
+            }
+            if constexpr (is_clustered<light_type>) {
+                read_buffer(cluster_buffer.buffer.buffer(), RESOURCE_STATE_CONSTANT_BUFFER);
+                read_buffer(m_PointLightBuffer, RESOURCE_STATE_SHADER_RESOURCE);
+                read_buffer(m_SpotLightBuffer, RESOURCE_STATE_SHADER_RESOURCE);
+                read_buffer(m_LightClusters.ranges_srv()->GetBuffer(), RESOURCE_STATE_SHADER_RESOURCE);
+                read_buffer(m_LightClusters.indices_srv()->GetBuffer(), RESOURCE_STATE_SHADER_RESOURCE);
+            }
+        }, light_use);
+        read_texture(m_ContainerTextureSRV);
+        read_texture(m_ContainerSpecularTextureSRV);
+        if ((mode == render_mode::instanced && !m_VisibleContainers.empty()) || mode == render_mode::gpu_driven) {
+            read_buffer(m_InstanceBuffer, RESOURCE_STATE_SHADER_RESOURCE);
+            read_buffer(m_VisibleInstanceBuffer, RESOURCE_STATE_SHADER_RESOURCE);
+        }
+        if (mode == render_mode::gpu_driven) {
+            SceneAccesses.push_back(render_graph::read(DrawArgs, RESOURCE_STATE_INDIRECT_ARGUMENT));
+        }
+
+        // The late scene pass draws with the same pipeline, into the same targets.
+        auto LateSceneAccesses = occlusion ? SceneAccesses : std::vector<render_graph::access>{};
+
+        m_Graph.add_pass("Scene", std::move(SceneAccesses), [&](IDeviceContext* pContext) {
+            const auto gpu_scope = m_Profiler.gpu(pContext, "Scene pass");
+
+            pContext->SetRenderTargets(1, &pRTV, pDSV, render_graph::pass_mode);
+            const glm::vec4 ClearColor = { 0.1f, 0.1f, 0.1f, 1.0f };
+            pContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), render_graph::pass_mode);
+            pContext->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 1.f, 0, render_graph::pass_mode);
+
+            m_CubeMesh.bind(pContext, render_graph::pass_mode);
+
+            // Starts a ring upload. Each one discards the previous contents of the ring, so the
+            // light cube's constants go into every batch and the last batch's are drawn with.
+            Uint32 light_cube_offset = 0;
+            bool batch_started = false;
+            const auto begin_batch = [this, &light_cube_offset, &batch_started]() {
+                m_FrameRing.reset();
+                light_cube_offset = m_FrameRing.push(light_cube_object);
+                batch_started = true;
+            };
+
+            const auto DrawAttrs = cube_mesh::draw_attribs();
+
+            m_DrawList.for_each_run([&](Uint64 Key, size_t First, size_t Last) {
+                switch (static_cast<draw_pipeline> (draw_list::pipeline(Key)))
+                {
+                case draw_pipeline::container:
                 {
-                    glm::mat4 model = glm::translate(glm::mat4(1.0f), cube_position);
-                    float angle = 20.0f * i++;
-                    model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-                    render_cube(model);
+                    switch (mode)
+                    {
+                    case render_mode::per_draw:
+                    {
+                        pContext->SetPipelineState(pipelines_use->pso);
+
+                        auto* pObjectVar = pipelines_use->srb->GetVariableByName(SHADER_TYPE_VERTEX, "Object");
+
+                        size_t next_visible = 0;
+                        do {
+                            {
+                                const auto cpu_scope = m_Profiler.cpu("Update constants");
+
+                                begin_batch();
+
+                                // Only the container's own matrices; view, projection and
+                                // lights are in the frame and pass constants.
+                                m_DrawOffsets.clear();
+                                for (; next_visible < m_VisibleContainers.size() && m_FrameRing.can_push<InstanceData>(); ++next_visible)
+                                {
+                                    m_DrawOffsets.push_back(m_FrameRing.push(m_ContainerMatrices[m_VisibleContainers[next_visible]]));
+                                }
+
+                                m_FrameRing.upload(pContext);
+                            }
+
+                            const auto cpu_scope = m_Profiler.cpu("Record draws");
+
+                            for (const auto draw_offset : m_DrawOffsets)
+                            {
+                                pObjectVar->SetBufferOffset(draw_offset);
+                                pContext->CommitShaderResources(pipelines_use->srb, render_graph::pass_mode);
+                                pContext->DrawIndexed(DrawAttrs);
+                            }
+                        } while (next_visible < m_VisibleContainers.size());
+                    }
+                        break;
+                    case render_mode::instanced:
+                    {
+                        {
+                            const auto cpu_scope = m_Profiler.cpu("Update constants");
+
+                            begin_batch();
+                            m_FrameRing.upload(pContext);
+                        }
+
+                        if (m_VisibleContainers.empty()) {
+                            break;
+                        }
+
+                        const auto cpu_scope = m_Profiler.cpu("Record draws");
+
+                        pContext->SetPipelineState(pipelines_use->instanced_pso);
+                        pContext->CommitShaderResources(pipelines_use->instanced_srb, render_graph::pass_mode);
+
+                        const auto InstancedDrawAttrs = cube_mesh::draw_attribs(static_cast<Uint32> (m_VisibleContainers.size()));
+                        pContext->DrawIndexed(InstancedDrawAttrs);
+                    }
+                        break;
+                    case render_mode::gpu_driven:
+                    {
+                        {
+                            const auto cpu_scope = m_Profiler.cpu("Update constants");
+
+                            begin_batch();
+                            m_FrameRing.upload(pContext);
+                        }
+
+                        const auto cpu_scope = m_Profiler.cpu("Record draws");
+
+                        // The same pipeline as the instanced mode, with the instance count and
+                        // VisibleInstances written by the cull pass.
+                        pContext->SetPipelineState(pipelines_use->instanced_pso);
+                        pContext->CommitShaderResources(pipelines_use->instanced_srb, render_graph::pass_mode);
+                        pContext->DrawIndexedIndirect(cube_mesh::indirect_draw_attribs(m_DrawArgsBuffer, render_graph::pass_mode));
+                    }
+                        break;
+                    }
                 }
-            }
+                    break;
+                case draw_pipeline::model:
+                {
+                    // One draw per primitive instance through the frame ring, like the per-draw
+                    // containers, from the model's vertex and index buffers.
+                    pContext->SetPipelineState(pipelines_use->pso);
+                    m_Model.bind(pContext, render_graph::pass_mode);
+
+                    auto* pObjectVar = pipelines_use->srb->GetVariableByName(SHADER_TYPE_VERTEX, "Object");
+
+                    size_t next_draw = First;
+                    do {
+                        {
+                            const auto cpu_scope = m_Profiler.cpu("Update constants");
+
+                            begin_batch();
+                            m_DrawOffsets.clear();
+                            for (; next_draw < Last && m_FrameRing.can_push<InstanceData>(); ++next_draw)
+                            {
+                                m_DrawOffsets.push_back(m_FrameRing.push(m_ModelObjects[m_DrawList[next_draw].index]));
+                            }
+                            m_FrameRing.upload(pContext);
+                        }
+
+                        const auto cpu_scope = m_Profiler.cpu("Record draws");
+
+                        const size_t batch_first = next_draw - m_DrawOffsets.size();
+                        for (size_t i = 0; i < m_DrawOffsets.size(); ++i)
+                        {
+                            const auto instance = m_DrawList[batch_first + i].index;
+                            pObjectVar->SetBufferOffset(m_DrawOffsets[i]);
+                            pContext->CommitShaderResources(pipelines_use->srb, render_graph::pass_mode);
+                            pContext->DrawIndexed(m_Model.draw_attribs(m_Model.instances()[instance].primitive));
+                        }
+                    } while (next_draw < Last);
+
+                    m_CubeMesh.bind(pContext, render_graph::pass_mode);
+                }
+                    break;
+                case draw_pipeline::light_cube:
+                {
+                    if (!batch_started) {
+                        begin_batch();
+                        m_FrameRing.upload(pContext);
+                    }
+
+                    const auto cpu_scope = m_Profiler.cpu("Record draws");
+
+                    pContext->SetPipelineState(m_pLightCubePSO);
+                    m_pLightCubeSRB->GetVariableByName(SHADER_TYPE_VERTEX, "Object")->SetBufferOffset(light_cube_offset);
+                    pContext->CommitShaderResources(m_pLightCubeSRB, render_graph::pass_mode);
+                    pContext->DrawIndexed(DrawAttrs);
+                }
+                    break;
+                }
+            });
+        });
+
+        if (occlusion) {
+            add_occlusion_passes(pRTV, pDSV, Depth, Pyramid, Bounds, CullCB, Occluded, DrawArgs, std::move(LateSceneAccesses));
+        }
+        // The next frame tests against this frame's pyramid only if there is one.
+        m_DepthPyramidValid = occlusion;
 
-            m_pImmediateContext->SetPipelineState(m_pLightCubePSO);
-            c.model = glm::transpose(glm::scale(light_model, glm::vec3(0.2f)));
-            c.inverse_transpose_model = glm::transpose(glm::inverse(glm::transpose(c.model)));
-            Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-            *CBConstants = c;
+        m_Graph.execute(m_pImmediateContext);
 
-            m_pImmediateContext->CommitShaderResources(m_pLightCubeSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-            m_pImmediateContext->Draw(DrawAttrs);
+        {
+            const auto cpu_scope = m_Profiler.cpu("Flush");
+            m_Latency.submit();
+            m_Benchmark.end_frame(m_pImmediateContext);
+            m_pImmediateContext->Flush();
         }
+        m_Profiler.end_frame();
 
-        m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        const auto cpu_scope = m_Profiler.cpu("Present");
+        m_RenderTarget.present();
+        m_Latency.present();
     }
 
-    void create_pipeline_states() {
+    // What follows the scene pass with occlusion culling on: the depth pyramid is rebuilt from the
+    // depth the scene pass left, the containers the early cull found occluded are tested against
+    // it, and the ones that turn out visible are drawn on top of the scene.
+    void add_occlusion_passes(Diligent::ITextureView* pRTV, Diligent::ITextureView* pDSV, render_graph::resource Depth, render_graph::resource Pyramid,
+        render_graph::resource Bounds, render_graph::resource CullCB, render_graph::resource Occluded, render_graph::resource DrawArgs,
+        std::vector<render_graph::access> LateSceneAccesses) {
+        using namespace Diligent;
+
+        // One pass per mip, so each reduction reads what the previous one wrote.
+        m_Graph.add_pass("Depth pyramid mip 0", {
+            render_graph::read(Depth, RESOURCE_STATE_SHADER_RESOURCE),
+            render_graph::write(Pyramid, RESOURCE_STATE_UNORDERED_ACCESS),
+        }, [this](IDeviceContext* pContext) {
+            const auto gpu_scope = m_Profiler.gpu(pContext, "Depth pyramid pass");
+
+            m_CullPipelines.pyramid_copy.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "Depth")->Set(m_RenderTarget.depth_buffer_srv());
+            dispatch_pyramid(pContext, m_CullPipelines.pyramid_copy, 0);
+        });
+        for (Uint32 Mip = 1; Mip < m_DepthPyramid->GetDesc().MipLevels; ++Mip) {
+            m_Graph.add_pass("Depth pyramid mip " + std::to_string(Mip), {
+                render_graph::write(Pyramid, RESOURCE_STATE_UNORDERED_ACCESS),
+            }, [this, Mip](IDeviceContext* pContext) {
+                const auto gpu_scope = m_Profiler.gpu(pContext, "Depth pyramid pass");
+
+                m_CullPipelines.pyramid_reduce.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "Source")->Set(m_DepthPyramidUAVs[Mip - 1]);
+                dispatch_pyramid(pContext, m_CullPipelines.pyramid_reduce, Mip);
+            });
+        }
+
+        const auto FrameCB = m_Graph.import_buffer(frame_constants.buffer.buffer());
+        const auto LateVisible = m_Graph.import_buffer(m_LateVisibleInstanceBuffer);
+
+        m_Graph.add_pass("Late cull", {
+            render_graph::read(Bounds, RESOURCE_STATE_SHADER_RESOURCE),
+            render_graph::read(CullCB, RESOURCE_STATE_CONSTANT_BUFFER),
+            render_graph::read(FrameCB, RESOURCE_STATE_CONSTANT_BUFFER),
+            render_graph::read(Occluded, RESOURCE_STATE_SHADER_RESOURCE),
+            render_graph::read(Pyramid, RESOURCE_STATE_SHADER_RESOURCE),
+            render_graph::write(LateVisible, RESOURCE_STATE_UNORDERED_ACCESS),
+            render_graph::write(DrawArgs, RESOURCE_STATE_UNORDERED_ACCESS),
+        }, [this](IDeviceContext* pContext) {
+            const auto gpu_scope = m_Profiler.gpu(pContext, "Late cull pass");
+            dispatch_cull(pContext, m_CullPipelines.late);
+        });
+
+        LateSceneAccesses.push_back(render_graph::read(LateVisible, RESOURCE_STATE_SHADER_RESOURCE));
+        m_Graph.add_pass("Late scene", std::move(LateSceneAccesses), [this, pRTV, pDSV](IDeviceContext* pContext) {
+            const auto gpu_scope = m_Profiler.gpu(pContext, "Late scene pass");
+            const auto cpu_scope = m_Profiler.cpu("Record draws");
+
+            pContext->SetRenderTargets(1, &pRTV, pDSV, render_graph::pass_mode);
+            m_CubeMesh.bind(pContext, render_graph::pass_mode);
+
+            // The early draw's SRB, pointed at the late list for this one draw.
+            auto* pVisibleVar = pipelines_use->instanced_srb->GetVariableByName(SHADER_TYPE_VERTEX, "VisibleInstances");
+            pVisibleVar->Set(m_LateVisibleInstanceBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+
+            pContext->SetPipelineState(pipelines_use->instanced_pso);
+            pContext->CommitShaderResources(pipelines_use->instanced_srb, render_graph::pass_mode);
+            pContext->DrawIndexedIndirect(cube_mesh::indirect_draw_attribs(m_DrawArgsBuffer, render_graph::pass_mode, offsetof(CullDrawArgs, late)));
+
+            pVisibleVar->Set(m_VisibleInstanceBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+        });
+    }
+
+    // The cull passes run a thread per container. The late one only has work for the containers
+    // the early one found occluded, a count only the GPU knows, so the rest of its threads return.
+    void dispatch_cull(Diligent::IDeviceContext* pContext, const compute_pipeline& Pipeline) {
+        using namespace Diligent;
+
+        pContext->SetPipelineState(Pipeline.pso);
+        pContext->CommitShaderResources(Pipeline.srb, render_graph::pass_mode);
+
+        DispatchComputeAttribs DispatchAttrs;
+        DispatchAttrs.ThreadGroupCountX = static_cast<Uint32> ((container_count + cull_group_size - 1) / cull_group_size);
+        pContext->DispatchCompute(DispatchAttrs);
+    }
+
+    // Writes mip Mip of the depth pyramid, a thread per texel.
+    void dispatch_pyramid(Diligent::IDeviceContext* pContext, const compute_pipeline& Pipeline, Diligent::Uint32 Mip) {
+        using namespace Diligent;
+
+        Pipeline.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "Destination")->Set(m_DepthPyramidUAVs[Mip]);
+        pContext->SetPipelineState(Pipeline.pso);
+        pContext->CommitShaderResources(Pipeline.srb, render_graph::pass_mode);
+
+        const auto& Desc = m_DepthPyramid->GetDesc();
+        const Uint32 Width = std::max(Desc.Width >> Mip, 1u);
+        const Uint32 Height = std::max(Desc.Height >> Mip, 1u);
+
+        DispatchComputeAttribs DispatchAttrs;
+        DispatchAttrs.ThreadGroupCountX = (Width + pyramid_group_size - 1) / pyramid_group_size;
+        DispatchAttrs.ThreadGroupCountY = (Height + pyramid_group_size - 1) / pyramid_group_size;
+        pContext->DispatchCompute(DispatchAttrs);
+    }
+
+    Diligent::GraphicsPipelineStateCreateInfo pipeline_create_info() const {
         using namespace Diligent;
         GraphicsPipelineStateCreateInfo PSOCreateInfo;
 
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
-        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_RenderTarget.desc().DepthBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = true;
         PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_NONE;
 
-        ShaderCreateInfo ShaderCI;
-        ShaderCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
+        PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = packed_vertex::layout.data();
+        PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = packed_vertex::layout.size();
+
+        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+        return PSOCreateInfo;
+    }
+
+    Diligent::RefCntAutoPtr<Diligent::IShader> create_shader(Diligent::SHADER_TYPE Type, const char* Name, const char* FilePath, const Diligent::ShaderMacroArray& Macros = {}) {
+        using namespace Diligent;
 
         RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
         m_pEngineFactory->CreateDefaultShaderSourceStreamFactory(nullptr, &pShaderSourceFactory);
+
+        ShaderCreateInfo ShaderCI;
+        ShaderCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
         ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
+        ShaderCI.Desc.ShaderType = Type;
+        ShaderCI.EntryPoint = "main";
+        ShaderCI.Desc.Name = Name;
+        ShaderCI.FilePath = FilePath;
+        ShaderCI.Macros = Macros;
+
+        RefCntAutoPtr<IShader> pShader;
+        m_PipelineCache.create_shader(ShaderCI, &pShader);
+        if (!pShader) {
+            throw std::runtime_error(std::string("Failed to compile ") + FilePath + ".");
+        }
+        return pShader;
+    }
+
+    void create_light_cube_pipeline(Diligent::RefCntAutoPtr<Diligent::IPipelineState>& PSO, Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding>& SRB) {
+        using namespace Diligent;
+        auto PSOCreateInfo = pipeline_create_info();
 
-        std::array LayoutElems =
+        // Only Object comes from the frame ring; Frame stays static.
+        std::array LightCubeVars =
         {
-            LayoutElement{0, 0, 3, VT_FLOAT32, False},
-            LayoutElement{1, 0, 3, VT_FLOAT32, False},
-            LayoutElement{2, 0, 2, VT_FLOAT32, False}
+            ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Object", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
         };
 
-        PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = LayoutElems.data();
-        PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = LayoutElems.size();
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables = LightCubeVars.data();
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = LightCubeVars.size();
+
+        const auto pLightCubeVS = create_shader(SHADER_TYPE_VERTEX, "Light Cube vertex shader", "light_cube.vsh");
+        const auto pLightCubePS = create_shader(SHADER_TYPE_PIXEL, "Light Cube pixel shader", "light_cube.psh");
+
+        PSOCreateInfo.PSODesc.Name = "Light Cube PSO";
+        PSOCreateInfo.pVS = pLightCubeVS;
+        PSOCreateInfo.pPS = pLightCubePS;
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &PSO);
+        if (!PSO) {
+            throw std::runtime_error("Failed to create the light cube pipeline.");
+        }
+        frame_constants.buffer.bind(*PSO, SHADER_TYPE_VERTEX, "Frame");
+
+        PSO->CreateShaderResourceBinding(&SRB, true);
+        m_FrameRing.bind<InstanceData>(*SRB, SHADER_TYPE_VERTEX, "Object");
+    }
+
+    // One compute pipeline of the GPU-driven mode. The resources named in Dynamic change with the
+    // container count or the window size and are bound later; the constant and draw argument
+    // buffers are bound here, where the shader has them.
+    compute_pipeline create_compute_pipeline(const std::string& Name, const char* FilePath, const Diligent::ShaderMacroArray& Macros, std::initializer_list<const char*> Dynamic) {
+        using namespace Diligent;
 
+        const std::string PSOName = Name + " PSO";
+        ComputePipelineStateCreateInfo PSOCreateInfo;
+        PSOCreateInfo.PSODesc.Name = PSOName.c_str();
+        PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_COMPUTE;
         PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
 
-        RefCntAutoPtr<IShader> pLightCubeVS;
-        {
-            ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
-            ShaderCI.Desc.Name = "Light Cube vertex shader";
-            ShaderCI.FilePath = "light_cube.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubeVS);
+        std::vector<ShaderResourceVariableDesc> Vars;
+        for (const auto* VarName : Dynamic) {
+            Vars.emplace_back(SHADER_TYPE_COMPUTE, VarName, SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC);
         }
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables = Vars.data();
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = static_cast<Uint32> (Vars.size());
 
-        RefCntAutoPtr<IShader> pLightCubePS;
-        {
-            ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
-            ShaderCI.Desc.Name = "Light Cube pixel shader";
-            ShaderCI.FilePath = "light_cube.psh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubePS);
+        const std::string ShaderName = Name + " compute shader";
+        const auto pCS = create_shader(SHADER_TYPE_COMPUTE, ShaderName.c_str(), FilePath, Macros);
+        PSOCreateInfo.pCS = pCS;
+
+        compute_pipeline Pipeline;
+        m_PipelineCache.create_compute_pipeline_state(PSOCreateInfo, &Pipeline.pso);
+        if (!Pipeline.pso) {
+            throw std::runtime_error("Failed to create " + PSOName + ".");
         }
 
-        PSOCreateInfo.PSODesc.Name = "Light Cube PSO";
-        PSOCreateInfo.pVS = pLightCubeVS;
-        PSOCreateInfo.pPS = pLightCubePS;
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pLightCubePSO);
+        if (auto* pVar = Pipeline.pso->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "Cull")) {
+            pVar->Set(cull_constants.buffer.buffer());
+        }
+        if (auto* pVar = Pipeline.pso->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "Frame")) {
+            pVar->Set(frame_constants.buffer.buffer());
+        }
+        if (auto* pVar = Pipeline.pso->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "DrawArgs")) {
+            pVar->Set(m_DrawArgsBuffer->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS));
+        }
+
+        Pipeline.pso->CreateShaderResourceBinding(&Pipeline.srb, true);
+        return Pipeline;
+    }
+
+    // The instance buffers are bound by bind_cull_buffers() and the depth pyramid by
+    // bind_depth_pyramid(). Runs at startup and on the hot reload thread.
+    cull_pipelines create_cull_pipelines() {
+        using namespace Diligent;
+
+        ShaderMacroHelper EarlyMacros;
+        EarlyMacros.AddShaderMacro("OCCLUSION_PHASE", 1);
+        ShaderMacroHelper LateMacros;
+        LateMacros.AddShaderMacro("OCCLUSION_PHASE", 2);
+        ShaderMacroHelper CopyMacros;
+        CopyMacros.AddShaderMacro("COPY_DEPTH", 1);
+
+        cull_pipelines Pipelines;
+        Pipelines.frustum = create_compute_pipeline("Cull", "cull.csh", {}, { "Bounds", "VisibleInstances" });
+        Pipelines.early = create_compute_pipeline("Early Cull", "cull.csh", EarlyMacros, { "Bounds", "VisibleInstances", "OccludedInstances", "DepthPyramid" });
+        Pipelines.late = create_compute_pipeline("Late Cull", "cull.csh", LateMacros, { "Bounds", "OccludedInstances", "LateVisibleInstances", "DepthPyramid" });
+        Pipelines.pyramid_copy = create_compute_pipeline("Depth Pyramid Copy", "depth_pyramid.csh", CopyMacros, { "Depth", "Destination" });
+        Pipelines.pyramid_reduce = create_compute_pipeline("Depth Pyramid Reduce", "depth_pyramid.csh", {}, { "Source", "Destination" });
+        return Pipelines;
+    }
+
+    // Creates the plain and instanced pipelines of one light type from colors.vsh and PSFile, with
+    // their SRBs bound to everything but the instance buffers, which create_instance_buffer() binds.
+    // Runs at startup and, on shader edits, on the hot reload thread, so it only touches what it returns.
+    template <typename Light>
+    light_pipelines create_light_pipelines(const char* Name, const char* PSFile) {
+        using namespace Diligent;
+        auto PSOCreateInfo = pipeline_create_info();
 
         std::array CombinedVars =
         {
             ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "diffuse_texture", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
           , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "specular_texture", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Object", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+          , ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Frame", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Frame", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Lights", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Materials", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Clusters", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "ClusterRanges", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "ClusterLightIndices", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "PointLights", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "SpotLights", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
         };
 
-        PSOCreateInfo.PSODesc.ResourceLayout.Variables = CombinedVars.data();
-        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = CombinedVars.size();
+        std::array InstancedVars =
+        {
+            ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "diffuse_texture", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "specular_texture", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Frame", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Frame", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Lights", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Materials", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Clusters", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "ClusterRanges", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "ClusterLightIndices", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "PointLights", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "SpotLights", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Instances", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+          , ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "VisibleInstances", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+        };
 
         SamplerDesc SamLinearClampDesc
         {
@@ -456,217 +1471,506 @@ class application {
         PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers = CombinedImtblSamplers.data();
         PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = CombinedImtblSamplers.size();
 
-        RefCntAutoPtr<IShader> pVS;
-        {
-            ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
-            ShaderCI.EntryPoint = "main";
-            ShaderCI.Desc.Name = "Colors vertex shader";
-            ShaderCI.FilePath = "colors.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+        const auto pVS = create_shader(SHADER_TYPE_VERTEX, "Colors vertex shader", "colors.vsh");
+
+        ShaderMacroHelper Macros;
+        Macros.AddShaderMacro("INSTANCED", 1);
+        const auto pInstancedVS = create_shader(SHADER_TYPE_VERTEX, "Colors instanced vertex shader", "colors.vsh", Macros);
+
+        const std::string PSName = std::string(Name) + " pixel shader";
+        const auto pPS = create_shader(SHADER_TYPE_PIXEL, PSName.c_str(), PSFile);
+
+        PSOCreateInfo.pPS = pPS;
+
+        light_pipelines Pipelines;
+        const auto CreatePipeline = [&](bool Instanced, RefCntAutoPtr<IPipelineState>& PSO, RefCntAutoPtr<IShaderResourceBinding>& SRB) {
+            const std::string PSOName = std::string(Name) + (Instanced ? " Instanced PSO" : " PSO");
+            PSOCreateInfo.PSODesc.Name = PSOName.c_str();
+            PSOCreateInfo.pVS = Instanced ? pInstancedVS : pVS;
+            PSOCreateInfo.PSODesc.ResourceLayout.Variables = Instanced ? InstancedVars.data() : CombinedVars.data();
+            PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = Instanced ? InstancedVars.size() : CombinedVars.size();
+            m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &PSO);
+            if (!PSO) {
+                throw std::runtime_error("Failed to create " + PSOName + ".");
+            }
+
+            PSO->CreateShaderResourceBinding(&SRB, true);
+            bind_light_resources<Light>(*SRB);
+            if (!Instanced) {
+                m_FrameRing.bind<InstanceData>(*SRB, SHADER_TYPE_VERTEX, "Object");
+            }
+        };
+        CreatePipeline(false, Pipelines.pso, Pipelines.srb);
+        CreatePipeline(true, Pipelines.instanced_pso, Pipelines.instanced_srb);
+
+        return Pipelines;
+    }
+
+    // Everything but the per-draw constants and the instance buffers, which change with the
+    // container count.
+    template <typename Light>
+    void bind_light_resources(Diligent::IShaderResourceBinding& SRB) {
+        using namespace Diligent;
+
+        frame_constants.Bind(SRB, SHADER_TYPE_VERTEX, "Frame");
+        frame_constants.Bind(SRB, SHADER_TYPE_PIXEL, "Frame");
+        if constexpr (has_light_constants<Light>) {
+            std::get<Resource<Light>>(lights).Bind(SRB, SHADER_TYPE_PIXEL, "Lights");
+        }
+        if constexpr (is_clustered<Light>) {
+            auto* pPointLightsSRV = m_PointLightBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE);
+            auto* pSpotLightsSRV = m_SpotLightBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE);
+            if constexpr (std::is_same_v<Light, PointLight>) {
+                SRB.GetVariableByName(SHADER_TYPE_PIXEL, "Lights")->Set(pPointLightsSRV);
+            }
+            else if constexpr (std::is_same_v<Light, SpotLight>) {
+                SRB.GetVariableByName(SHADER_TYPE_PIXEL, "Lights")->Set(pSpotLightsSRV);
+            }
+            else {
+                SRB.GetVariableByName(SHADER_TYPE_PIXEL, "PointLights")->Set(pPointLightsSRV);
+                SRB.GetVariableByName(SHADER_TYPE_PIXEL, "SpotLights")->Set(pSpotLightsSRV);
+            }
+            SRB.GetVariableByName(SHADER_TYPE_PIXEL, "ClusterRanges")->Set(m_LightClusters.ranges_srv());
+            SRB.GetVariableByName(SHADER_TYPE_PIXEL, "ClusterLightIndices")->Set(m_LightClusters.indices_srv());
+            cluster_buffer.Bind(SRB, SHADER_TYPE_PIXEL, "Clusters");
         }
+        material.Bind(SRB, SHADER_TYPE_PIXEL, "Materials");
 
-        PSOCreateInfo.pVS = pVS;
+        // Null until the textures finish loading at startup, when bind_container_texture() and
+        // bind_container_specular_texture() set them.
+        if (m_ContainerTextureSRV) {
+            SRB.GetVariableByName(SHADER_TYPE_PIXEL, "diffuse_texture")->Set(m_ContainerTextureSRV);
+        }
+        if (m_ContainerSpecularTextureSRV) {
+            SRB.GetVariableByName(SHADER_TYPE_PIXEL, "specular_texture")->Set(m_ContainerSpecularTextureSRV);
+        }
+    }
 
+    void create_pipeline_states() {
         create_uniform_buffers();
+        create_light_buffers();
+
+        create_light_cube_pipeline(m_pLightCubePSO, m_pLightCubeSRB);
+        m_CullPipelines = create_cull_pipelines();
+
+        m_DirectionalLightPipelines = create_light_pipelines<DirectionalLight>("Directional Light", "directional_light.psh");
+        m_PointLightPipelines = create_light_pipelines<PointLight>("Point Light", "point_light.psh");
+        m_SpotLightPipelines = create_light_pipelines<SpotLight>("Spot Light", "spot_light.psh");
+        m_MultiLightPipelines = create_light_pipelines<LightSet>("Multi Light", "multi_light.psh");
 
-        const auto BindResources = [this](Diligent::IPipelineState* PSO, Diligent::IShaderResourceBinding** SRB, Diligent::IDeviceObject* LightBuffer) {
-            PSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
-            PSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Lights")->Set(LightBuffer);
-            PSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Materials")->Set(m_PSMaterial);
-            PSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Camera")->Set(m_PSCamera);
-            PSO->CreateShaderResourceBinding(SRB, true);
+        pipelines_use = &m_DirectionalLightPipelines;
+    }
+
+    // Each light type's pipelines are rebuilt when colors.vsh or its pixel shader changes, and
+    // swapped in whole between frames. pipelines_use points at the members, so it follows the swap.
+    void watch_shaders() {
+        const auto WatchLightPipelines = [this](auto LightTag, const char* Name, const char* PSFile, light_pipelines& Pipelines) {
+            using light_type = typename decltype(LightTag)::type;
+            m_ShaderReload.watch({ "colors.vsh", PSFile }, [this, Name, PSFile, &Pipelines]() -> shader_hot_reload::swap_function {
+                auto New = std::make_shared<light_pipelines>(create_light_pipelines<light_type>(Name, PSFile));
+                return [this, New, &Pipelines, PSFile]() {
+                    Pipelines = std::move(*New);
+                    bind_instance_buffers(Pipelines);
+                    std::cout << "Reloaded " << PSFile << "\n";
+                };
+            });
         };
+        WatchLightPipelines(std::type_identity<DirectionalLight>{}, "Directional Light", "directional_light.psh", m_DirectionalLightPipelines);
+        WatchLightPipelines(std::type_identity<PointLight>{}, "Point Light", "point_light.psh", m_PointLightPipelines);
+        WatchLightPipelines(std::type_identity<SpotLight>{}, "Spot Light", "spot_light.psh", m_SpotLightPipelines);
+        WatchLightPipelines(std::type_identity<LightSet>{}, "Multi Light", "multi_light.psh", m_MultiLightPipelines);
+
+        m_ShaderReload.watch({ "cull.csh", "depth_pyramid.csh" }, [this]() -> shader_hot_reload::swap_function {
+            auto New = std::make_shared<cull_pipelines>(create_cull_pipelines());
+            return [this, New]() {
+                m_CullPipelines = std::move(*New);
+                bind_cull_buffers();
+                bind_depth_pyramid();
+                std::cout << "Reloaded cull.csh\n";
+            };
+        });
+
+        m_ShaderReload.watch({ "light_cube.vsh", "light_cube.psh" }, [this]() -> shader_hot_reload::swap_function {
+            auto New = std::make_shared<std::pair<Diligent::RefCntAutoPtr<Diligent::IPipelineState>, Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding>>>();
+            create_light_cube_pipeline(New->first, New->second);
+            return [this, New]() {
+                m_pLightCubePSO = New->first;
+                m_pLightCubeSRB = New->second;
+                std::cout << "Reloaded light_cube.psh\n";
+            };
+        });
 
+        m_ShaderReload.start();
+    }
 
-        {
-            RefCntAutoPtr<IShader> pDirectionalLightPS;
-            {
-                ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
-                ShaderCI.EntryPoint = "main";
-                ShaderCI.Desc.Name = "Directional light pixel shader";
-                ShaderCI.FilePath = "directional_light.psh";
-                m_pDevice->CreateShader(ShaderCI, &pDirectionalLightPS);
-            }
+    std::array<light_pipelines*, 4> all_light_pipelines() {
+        return { &m_DirectionalLightPipelines, &m_PointLightPipelines, &m_SpotLightPipelines, &m_MultiLightPipelines };
+    }
+
+    // Decodes on a worker thread; the render device is free-threaded, so the texture is created there too.
+    std::future<Diligent::RefCntAutoPtr<Diligent::ITexture>> load_texture_async(std::filesystem::path path, const char* scope_name) {
+        return std::async(std::launch::async, [this, path = std::move(path), scope_name]() {
+            const auto cpu_scope = m_Profiler.cpu(scope_name);
+
+            Diligent::TextureLoadInfo loadInfo;
+            loadInfo.IsSRGB = !is_linear_texture(path);
+            Diligent::RefCntAutoPtr<Diligent::ITexture> Tex;
+            load_texture(path, loadInfo, m_pDevice, &Tex);
+            return Tex;
+        });
+    }
+
+    void bind_container_texture(Diligent::ITexture* Tex) {
+        using namespace Diligent;
 
-            PSOCreateInfo.pPS = pDirectionalLightPS;
-            PSOCreateInfo.PSODesc.Name = "Directional Light PSO";
-            m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pDirectionalLightPSO);
-            BindResources(m_pDirectionalLightPSO, &m_pDirectionalLightSRB, std::get<Resource<DirectionalLight>> (lights).buffer);
+        m_ContainerTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+
+        for (auto* Pipelines : all_light_pipelines()) {
+            Pipelines->srb->GetVariableByName(SHADER_TYPE_PIXEL, "diffuse_texture")->Set(m_ContainerTextureSRV);
+            Pipelines->instanced_srb->GetVariableByName(SHADER_TYPE_PIXEL, "diffuse_texture")->Set(m_ContainerTextureSRV);
         }
+    }
 
-        {
-            RefCntAutoPtr<IShader> pPointLightPS;
-            {
-                ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
-                ShaderCI.EntryPoint = "main";
-                ShaderCI.Desc.Name = "Point light pixel shader";
-                ShaderCI.FilePath = "point_light.psh";
-                m_pDevice->CreateShader(ShaderCI, &pPointLightPS);
-            }
+    void bind_container_specular_texture(Diligent::ITexture* Tex) {
+        using namespace Diligent;
 
-            PSOCreateInfo.pPS = pPointLightPS;
-            PSOCreateInfo.PSODesc.Name = "Point Light PSO";
-            m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pPointLightPSO);
-            BindResources(m_pPointLightPSO, &m_pPointLightSRB, std::get<Resource<PointLight>>(lights).buffer);
+        m_ContainerSpecularTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+
+        for (auto* Pipelines : all_light_pipelines()) {
+            Pipelines->srb->GetVariableByName(SHADER_TYPE_PIXEL, "specular_texture")->Set(m_ContainerSpecularTextureSRV);
+            Pipelines->instanced_srb->GetVariableByName(SHADER_TYPE_PIXEL, "specular_texture")->Set(m_ContainerSpecularTextureSRV);
         }
+    }
 
-        {
-            RefCntAutoPtr<IShader> pSpotLightPS;
-            {
-                ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
-                ShaderCI.EntryPoint = "main";
-                ShaderCI.Desc.Name = "Spot light pixel shader";
-                ShaderCI.FilePath = "spot_light.psh";
-                m_pDevice->CreateShader(ShaderCI, &pSpotLightPS);
+    // Parses --model on a worker thread, which spreads the decoding over the worker pool (idle
+    // until the first frame) and creates the buffers there too.
+    std::future<void> load_model_async() {
+        return std::async(std::launch::async, [this]() {
+            if (m_Options.model_path.empty()) {
+                return;
             }
 
-            PSOCreateInfo.pPS = pSpotLightPS;
-            PSOCreateInfo.PSODesc.Name = "Spot Light PSO";
-            m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pSpotLightPSO);
-            BindResources(m_pSpotLightPSO, &m_pSpotLightSRB, std::get<Resource<SpotLight>>(lights).buffer);
+            const auto cpu_scope = m_Profiler.cpu("Load model");
+            m_Model.load(m_Options.model_path, m_WorkerPool);
+            m_Model.create(m_pDevice);
+        });
+    }
+
+    // The "Object" constants of every primitive instance of the model and their world space
+    // boxes. The decoded positions span -0.5..0.5 like the cube's, and the model never moves.
+    void create_model_objects() {
+        m_ModelObjects.clear();
+        m_ModelBounds.clear();
+        for (const auto& instance : m_Model.instances()) {
+            InstanceData object;
+            object.model = glm::transpose(instance.transform);
+            object.inverse_transpose_model = glm::transpose(glm::inverse(glm::transpose(instance.transform)));
+            object.uv_transform = m_Model.primitives()[instance.primitive].uv_transform;
+            m_ModelObjects.push_back(object);
+            m_ModelBounds.add(instance.transform, glm::vec3(0.5f));
         }
 
-        PSO_use = m_pDirectionalLightPSO;
-        SRB_use = m_pDirectionalLightSRB;
+        if (!m_ModelObjects.empty()) {
+            std::cout << m_Options.model_path << ": " << m_Model.primitives().size() << " primitives, "
+                << m_ModelObjects.size() << " draws, " << m_Model.triangle_count() << " triangles\n";
+        }
+    }
 
+    // Texture decoding, model decoding and PSO creation are all CPU heavy and independent of each
+    // other, so the textures and the model load on worker threads while this thread compiles the
+    // pipelines. The SRBs only exist once the PSOs do, so binding waits for both.
+    void create_pipeline_states_and_textures() {
+        auto container_texture = load_texture_async(asset_path("container2.png"), "Load container2.png");
+        auto container_specular_texture = load_texture_async(asset_path("container2_specular.png"), "Load container2_specular.png");
+        auto model = load_model_async();
 
-        m_pLightCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
-        m_pLightCubePSO->CreateShaderResourceBinding(&m_pLightCubeSRB, true);
+        {
+            const auto cpu_scope = m_Profiler.cpu("Create pipeline states");
+            create_pipeline_states();
+            m_PipelineCache.save();
+        }
+
+        const auto cpu_scope = m_Profiler.cpu("Wait for textures");
+        bind_container_texture(container_texture.get());
+        bind_container_specular_texture(container_specular_texture.get());
+
+        model.get();
+        create_model_objects();
+    }
 
+    void create_uniform_buffers() {
+        m_FrameRing.create(*m_pDevice, 1 << 20, "Object constants ring");
+
+        frame_constants.buffer.create(*m_pDevice, "Frame constants");
+        std::get<Resource<DirectionalLight>>(lights).buffer.create(*m_pDevice, "Directional light constants");
+        std::get<Resource<LightSet>>(lights).buffer.create(*m_pDevice, "Light set constants");
+        cluster_buffer.buffer.create(*m_pDevice, "Cluster constants");
+        material.buffer.create(*m_pDevice, "Material constants");
+        cull_constants.buffer.create(*m_pDevice, "Cull constants");
+
+        // Reset before every frame's cull passes, which count the visible containers into it.
+        Diligent::BufferDesc ArgsDesc;
+        ArgsDesc.Name = "Container draw arguments";
+        ArgsDesc.Usage = Diligent::USAGE_DEFAULT;
+        ArgsDesc.BindFlags = Diligent::BIND_INDIRECT_DRAW_ARGS | Diligent::BIND_UNORDERED_ACCESS;
+        ArgsDesc.Mode = Diligent::BUFFER_MODE_STRUCTURED;
+        ArgsDesc.ElementByteStride = sizeof(Diligent::Uint32);
+        ArgsDesc.Size = sizeof(CullDrawArgs);
+        m_pDevice->CreateBuffer(ArgsDesc, nullptr, &m_DrawArgsBuffer);
+        if (!m_DrawArgsBuffer) {
+            throw std::runtime_error("Failed to create the draw argument buffer.");
+        }
     }
 
-    void load_container_texture() {
+    // Room for max_light_count lights of each clustered type, rewritten every frame.
+    void create_light_buffers() {
         using namespace Diligent;
 
-        TextureLoadInfo loadInfo;
-        loadInfo.IsSRGB = true;
-        RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\container2.png)", loadInfo, m_pDevice, &Tex);
+        BufferDesc LightBuffDesc;
+        LightBuffDesc.Usage = USAGE_DEFAULT;
+        LightBuffDesc.BindFlags = BIND_SHADER_RESOURCE;
+        LightBuffDesc.Mode = BUFFER_MODE_STRUCTURED;
 
-        m_ContainerTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+        LightBuffDesc.Name = "Point light buffer";
+        LightBuffDesc.ElementByteStride = sizeof(PointLight);
+        LightBuffDesc.Size = max_light_count * sizeof(PointLight);
+        m_pDevice->CreateBuffer(LightBuffDesc, nullptr, &m_PointLightBuffer);
+
+        LightBuffDesc.Name = "Spot light buffer";
+        LightBuffDesc.ElementByteStride = sizeof(SpotLight);
+        LightBuffDesc.Size = max_light_count * sizeof(SpotLight);
+        m_pDevice->CreateBuffer(LightBuffDesc, nullptr, &m_SpotLightBuffer);
 
-        m_pDirectionalLightSRB->GetVariableByName(SHADER_TYPE_PIXEL, "diffuse_texture")->Set(m_ContainerTextureSRV);
-        m_pPointLightSRB->GetVariableByName(SHADER_TYPE_PIXEL, "diffuse_texture")->Set(m_ContainerTextureSRV);
-        m_pSpotLightSRB->GetVariableByName(SHADER_TYPE_PIXEL, "diffuse_texture")->Set(m_ContainerTextureSRV);
+        if (!m_PointLightBuffer || !m_SpotLightBuffer) {
+            throw std::runtime_error("Failed to create the light buffers.");
+        }
+
+        m_LightClusters.create(m_pDevice);
     }
 
-    void load_container_specular_texture() {
-        using namespace Diligent;
+    // Moves the generated lights along their orbits, bins the first point_count point lights and
+    // spot_count spot lights into clusters on the worker pool, and uploads lights and clusters.
+    // Cluster lists index point lights first and spot lights after them.
+    void update_clustered_lights(size_t point_count, size_t spot_count, const glm::mat4& view, float fov, float aspect) {
+        const auto cpu_scope = m_Profiler.cpu("Bin lights");
+
+        m_PointLights[0] = std::get<Resource<PointLight>>(lights).data;
+        m_SpotLights[0] = std::get<Resource<SpotLight>>(lights).data;
+
+        // Spot lights run half an orbit behind the point lights, so the two never coincide.
+        const float time = static_cast<float> (m_AnimationTime);
+        for (size_t i = 1; i < std::max(point_count, spot_count); ++i) {
+            const auto& orbit = m_LightOrbits[i];
+            const float angle = orbit.phase + orbit.speed * time;
+            m_PointLights[i].position = orbit.center + orbit.radius * glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+            m_SpotLights[i].position = orbit.center - orbit.radius * glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+        }
 
-        TextureLoadInfo loadInfo;
-        loadInfo.IsSRGB = true;
-        RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\container2_specular.png)", loadInfo, m_pDevice, &Tex);
+        m_LightSpheres.clear();
+        for (size_t i = 0; i < point_count; ++i) {
+            m_LightSpheres.emplace_back(m_PointLights[i].position, m_PointLights[i].range);
+        }
+        for (size_t i = 0; i < spot_count; ++i) {
+            m_LightSpheres.emplace_back(m_SpotLights[i].position, m_SpotLights[i].range);
+        }
 
-        m_ContainerSpecularTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+        m_LightClusters.build(view, fov, aspect, 0.1f, 100.0f, m_LightSpheres, m_WorkerPool);
 
-        m_pDirectionalLightSRB->GetVariableByName(SHADER_TYPE_PIXEL, "specular_texture")->Set(m_ContainerSpecularTextureSRV);
-        m_pPointLightSRB->GetVariableByName(SHADER_TYPE_PIXEL, "specular_texture")->Set(m_ContainerSpecularTextureSRV);
-        m_pSpotLightSRB->GetVariableByName(SHADER_TYPE_PIXEL, "specular_texture")->Set(m_ContainerSpecularTextureSRV);
+        const auto& SwapChainDesc = m_RenderTarget.desc();
+        cluster_buffer.data = m_LightClusters.constants(SwapChainDesc.Width, SwapChainDesc.Height);
+
+        if (point_count > 0) {
+            m_pImmediateContext->UpdateBuffer(m_PointLightBuffer, 0, point_count * sizeof(PointLight), m_PointLights.data(), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        }
+        if (spot_count > 0) {
+            m_pImmediateContext->UpdateBuffer(m_SpotLightBuffer, 0, spot_count * sizeof(SpotLight), m_SpotLights.data(), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        }
+        m_LightClusters.upload(m_pImmediateContext);
     }
 
-    void load_textures() {
-        load_container_texture();
-        load_container_specular_texture();
+    void create_cube_buffer() {
+        m_CubeMesh.create(m_pDevice);
     }
 
-    void create_uniform_buffers() {
+    void create_instance_buffer() {
         using namespace Diligent;
 
-        BufferDesc CBDesc;
-        CBDesc.Usage = USAGE_DYNAMIC;
-        CBDesc.BindFlags = BIND_UNIFORM_BUFFER;
-        CBDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+        if (m_ContainerTransformsCount != container_count) {
+            create_container_transforms();
+        }
+        const auto& instances = m_ContainerMatrices;
+
+        BufferDesc InstBuffDesc;
+        InstBuffDesc.Name = "Container instance buffer";
+        InstBuffDesc.Usage = USAGE_IMMUTABLE;
+        InstBuffDesc.BindFlags = BIND_SHADER_RESOURCE;
+        InstBuffDesc.Mode = BUFFER_MODE_STRUCTURED;
+        InstBuffDesc.ElementByteStride = sizeof(InstanceData);
+        InstBuffDesc.Size = instances.size() * sizeof(InstanceData);
+        BufferData InstData;
+        InstData.pData = instances.data();
+        InstData.DataSize = instances.size() * sizeof(InstanceData);
+
+        m_InstanceBuffer.Release();
+        m_pDevice->CreateBuffer(InstBuffDesc, &InstData, &m_InstanceBuffer);
+        m_InstanceBufferCount = container_count;
+
+        // Rewritten every frame with the indices the culler lets through, by the CPU in instanced
+        // mode and by cull.csh in GPU-driven mode, so it has room for all of them.
+        BufferDesc VisibleBuffDesc;
+        VisibleBuffDesc.Name = "Visible container indices";
+        VisibleBuffDesc.Usage = USAGE_DEFAULT;
+        VisibleBuffDesc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+        VisibleBuffDesc.Mode = BUFFER_MODE_STRUCTURED;
+        VisibleBuffDesc.ElementByteStride = sizeof(Uint32);
+        VisibleBuffDesc.Size = container_count * sizeof(Uint32);
+
+        m_VisibleInstanceBuffer.Release();
+        m_pDevice->CreateBuffer(VisibleBuffDesc, nullptr, &m_VisibleInstanceBuffer);
+
+        // The occlusion cull's lists, written by its early and its late pass.
+        VisibleBuffDesc.Name = "Occluded container indices";
+        m_OccludedInstanceBuffer.Release();
+        m_pDevice->CreateBuffer(VisibleBuffDesc, nullptr, &m_OccludedInstanceBuffer);
+
+        VisibleBuffDesc.Name = "Late visible container indices";
+        m_LateVisibleInstanceBuffer.Release();
+        m_pDevice->CreateBuffer(VisibleBuffDesc, nullptr, &m_LateVisibleInstanceBuffer);
+
+        std::vector<InstanceBounds> bounds(container_count);
+        for (size_t i = 0; i < container_count; ++i) {
+            bounds[i].center = glm::vec4(m_ContainerBounds.center(i), 0.0f);
+            bounds[i].extent = glm::vec4(m_ContainerBounds.extent(i), 0.0f);
+        }
 
-        CBDesc.Name = "VS constants CB";
-        CBDesc.Size = sizeof(Constants);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_VSConstants);
+        BufferDesc BoundsBuffDesc;
+        BoundsBuffDesc.Name = "Container bounds";
+        BoundsBuffDesc.Usage = USAGE_IMMUTABLE;
+        BoundsBuffDesc.BindFlags = BIND_SHADER_RESOURCE;
+        BoundsBuffDesc.Mode = BUFFER_MODE_STRUCTURED;
+        BoundsBuffDesc.ElementByteStride = sizeof(InstanceBounds);
+        BoundsBuffDesc.Size = bounds.size() * sizeof(InstanceBounds);
+        BufferData BoundsData;
+        BoundsData.pData = bounds.data();
+        BoundsData.DataSize = bounds.size() * sizeof(InstanceBounds);
+
+        m_InstanceBoundsBuffer.Release();
+        m_pDevice->CreateBuffer(BoundsBuffDesc, &BoundsData, &m_InstanceBoundsBuffer);
+
+        if (!m_InstanceBuffer || !m_VisibleInstanceBuffer || !m_OccludedInstanceBuffer || !m_LateVisibleInstanceBuffer || !m_InstanceBoundsBuffer) {
+            throw std::runtime_error("Failed to create the instance buffers.");
+        }
 
-        std::apply([this, &CBDesc](auto&... Resource) {
-            constexpr std::array LightResourceNames = {
-                "PS Directional Light CB",
-                "PS Point Light CB",
-                "PS Spot Light CB"
-            };
-            
-            size_t i = 0;
-            (Resource.CreateBuffer(*m_pDevice, CBDesc, LightResourceNames[i++]), ...);
-        }, lights);
+        for (auto* Pipelines : all_light_pipelines()) {
+            bind_instance_buffers(*Pipelines);
+        }
+        bind_cull_buffers();
+    }
+
+    void bind_cull_buffers() {
+        using namespace Diligent;
 
-        CBDesc.Name = "PS Material CB";
-        CBDesc.Size = sizeof(Material);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSMaterial);
+        if (!m_InstanceBoundsBuffer) {
+            return;
+        }
+        auto* pBoundsSRV = m_InstanceBoundsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE);
+        auto* pVisibleUAV = m_VisibleInstanceBuffer->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS);
 
-        CBDesc.Name = "PS Camera CB";
-        CBDesc.Size = sizeof(Camera::CB);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSCamera);
+        m_CullPipelines.frustum.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "Bounds")->Set(pBoundsSRV);
+        m_CullPipelines.frustum.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "VisibleInstances")->Set(pVisibleUAV);
 
+        m_CullPipelines.early.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "Bounds")->Set(pBoundsSRV);
+        m_CullPipelines.early.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "VisibleInstances")->Set(pVisibleUAV);
+        m_CullPipelines.early.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "OccludedInstances")->Set(m_OccludedInstanceBuffer->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS));
+
+        m_CullPipelines.late.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "Bounds")->Set(pBoundsSRV);
+        m_CullPipelines.late.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "OccludedInstances")->Set(m_OccludedInstanceBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+        m_CullPipelines.late.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "LateVisibleInstances")->Set(m_LateVisibleInstanceBuffer->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS));
     }
 
-    void create_cube_buffer() {
+    // An R32 texture with a full mip chain the size of the depth buffer, and a UAV per mip for
+    // the passes that build it. Until a frame fills it, the cull passes don't trust it.
+    void create_depth_pyramid() {
+        using namespace Diligent;
 
-        struct cube_vertex {
-            glm::vec3 pos;
-            glm::vec3 normal;
-            glm::vec2 uv;
-        };
+        const auto& Desc = m_RenderTarget.desc();
+
+        TextureDesc PyramidDesc;
+        PyramidDesc.Name = "Depth pyramid";
+        PyramidDesc.Type = RESOURCE_DIM_TEX_2D;
+        PyramidDesc.Width = Desc.Width;
+        PyramidDesc.Height = Desc.Height;
+        PyramidDesc.Format = TEX_FORMAT_R32_FLOAT;
+        PyramidDesc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+        PyramidDesc.MipLevels = 1;
+        while ((std::max(Desc.Width, Desc.Height) >> PyramidDesc.MipLevels) != 0) {
+            ++PyramidDesc.MipLevels;
+        }
 
-        std::array vertices = {
-            //face front
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(0.0f,  0.0f)},
-            //face back                                              
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(0.0f,  0.0f)},
-            //face right
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-            //face left
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-            //face top                                               
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-            //face bottom                                            
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)}       
-        };
+        m_DepthPyramid.Release();
+        m_pDevice->CreateTexture(PyramidDesc, nullptr, &m_DepthPyramid);
+        if (!m_DepthPyramid) {
+            throw std::runtime_error("Failed to create the depth pyramid.");
+        }
+
+        m_DepthPyramidUAVs.clear();
+        for (Uint32 Mip = 0; Mip < PyramidDesc.MipLevels; ++Mip) {
+            TextureViewDesc ViewDesc;
+            ViewDesc.ViewType = TEXTURE_VIEW_UNORDERED_ACCESS;
+            ViewDesc.MostDetailedMip = Mip;
+            ViewDesc.NumMipLevels = 1;
+
+            RefCntAutoPtr<ITextureView> UAV;
+            m_DepthPyramid->CreateView(ViewDesc, &UAV);
+            if (!UAV) {
+                throw std::runtime_error("Failed to create the depth pyramid views.");
+            }
+            m_DepthPyramidUAVs.push_back(std::move(UAV));
+        }
 
+        m_DepthPyramidValid = false;
+        bind_depth_pyramid();
+    }
+
+    void bind_depth_pyramid() {
+        using namespace Diligent;
+
+        if (!m_DepthPyramid) {
+            return;
+        }
+        auto* pPyramidSRV = m_DepthPyramid->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+        m_CullPipelines.early.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "DepthPyramid")->Set(pPyramidSRV);
+        m_CullPipelines.late.srb->GetVariableByName(SHADER_TYPE_COMPUTE, "DepthPyramid")->Set(pPyramidSRV);
+    }
+
+    void bind_instance_buffers(light_pipelines& Pipelines) {
         using namespace Diligent;
-        BufferDesc VertBuffDesc;
-        VertBuffDesc.Name = "Cube vertex buffer";
-        VertBuffDesc.Usage = USAGE_IMMUTABLE;
-        VertBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
-        VertBuffDesc.Size = vertices.size() * sizeof(decltype(vertices)::value_type);
-        BufferData VBData;
-        VBData.pData = vertices.data();
-        VBData.DataSize = vertices.size() * sizeof(decltype(vertices)::value_type);
-        m_pDevice->CreateBuffer(VertBuffDesc, &VBData, &m_CubeVertexBuffer);
 
+        Pipelines.instanced_srb->GetVariableByName(SHADER_TYPE_VERTEX, "Instances")->Set(m_InstanceBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+        Pipelines.instanced_srb->GetVariableByName(SHADER_TYPE_VERTEX, "VisibleInstances")->Set(m_VisibleInstanceBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+    }
+
+    // Matrices of every container, as InstanceData the per-draw path pushes into the ring and the
+    // instanced path uploads as is, and their world space boxes for the per frame frustum test.
+    // The cube mesh spans -0.5..0.5, and the container transforms never change, so this only
+    // reruns when the count does.
+    void create_container_transforms() {
+        transform_batch transforms;
+        transforms.reserve(container_count);
+        for (size_t i = 0; i < container_count; ++i) {
+            transforms.add(container_position(i), container_rotation(i));
+        }
+
+        m_ContainerMatrices.resize(container_count);
+        transforms.write_matrices(0, container_count, m_ContainerMatrices.data(), sizeof(InstanceData),
+            offsetof(InstanceData, model), offsetof(InstanceData, inverse_transpose_model));
+
+        m_ContainerBounds.clear();
+        m_ContainerBounds.reserve(container_count);
+        for (size_t i = 0; i < container_count; ++i) {
+            m_ContainerBounds.add(glm::transpose(m_ContainerMatrices[i].model), glm::vec3(0.5f));
+        }
+        m_ContainerTransformsCount = container_count;
     }
 
     void initialize_lights() {
@@ -685,6 +1989,7 @@ class application {
             point_light.constant = 1.0f;
             point_light.linear = 0.09f;
             point_light.quadratic = 0.032f;
+            point_light.range = 50.0f;
 
             point_light.ambient = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
             point_light.diffuse = glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);
@@ -703,37 +2008,159 @@ class application {
             spot_light.ambient = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
             spot_light.diffuse = glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);
             spot_light.specular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+            // The flashlight doesn't fade with distance; its range only has to reach the far plane.
+            spot_light.constant = 1.0f;
+            spot_light.linear = 0.0f;
+            spot_light.quadratic = 0.0f;
+            spot_light.range = 100.0f;
         }
 
+        // Fixed seed, so every run and every light count sees the same lights.
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        const auto random = [&](float min, float max) { return min + (max - min) * unit(generator); };
+
+        m_LightOrbits.resize(max_light_count);
+        m_PointLights.resize(max_light_count);
+        m_SpotLights.resize(max_light_count);
+        for (size_t i = 1; i < max_light_count; ++i) {
+            m_LightOrbits[i] = light_orbit{
+                .center = glm::vec3(random(-30.0f, 30.0f), random(-30.0f, 30.0f), random(-45.0f, 5.0f)),
+                .radius = random(0.5f, 2.0f),
+                .speed = random(-1.0f, 1.0f),
+                .phase = random(0.0f, glm::two_pi<float>())
+            };
+
+            const glm::vec3 color = glm::normalize(glm::vec3(random(0.1f, 1.0f), random(0.1f, 1.0f), random(0.1f, 1.0f)));
+            const float range = random(1.5f, 4.0f);
+
+            // Attenuation fitted to the range, as in the table LearnOpenGL quotes.
+            auto& point = m_PointLights[i];
+            point.ambient = glm::vec3(0.0f);
+            point.diffuse = color;
+            point.specular = color;
+            point.constant = 1.0f;
+            point.linear = 4.5f / range;
+            point.quadratic = 75.0f / (range * range);
+            point.range = range;
+
+            auto& spot = m_SpotLights[i];
+            spot.direction = glm::normalize(glm::vec3(random(-0.5f, 0.5f), -1.0f, random(-0.5f, 0.5f)));
+            spot.cutOff = glm::cos(glm::radians(25.0f));
+            spot.outerCutOff = glm::cos(glm::radians(35.0f));
+            spot.ambient = glm::vec3(0.0f);
+            spot.diffuse = color;
+            spot.specular = color;
+            spot.constant = 1.0f;
+            spot.linear = 4.5f / range;
+            spot.quadratic = 75.0f / (range * range);
+            spot.range = range;
+        }
+    }
+
+    void stop_trace() {
+        m_Profiler.set_capturing(false);
+
+        const auto path = m_Options.trace_path.empty() ? std::string("LightCasters_trace.json") : m_Options.trace_path;
+        m_Profiler.write_chrome_trace(path);
+        std::cout << "trace written to " << path << "\n";
     }
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options)
+        , m_Benchmark(Options) {
         init();     
     }
 
     ~application() {
+        // A rebuild in flight uses the device, buffers and textures below.
+        m_ShaderReload.stop();
         glfwTerminate();
     }
 
     void run() {
-        create_pipeline_states();
-        load_textures();
-        create_cube_buffer();
-        initialize_lights();
+        {
+            const auto cpu_scope = m_Profiler.cpu("Startup");
+            create_pipeline_states_and_textures();
+            create_cube_buffer();
+            create_container_transforms();
+            create_instance_buffer();
+            initialize_lights();
+        }
 
-        float delta_time = 0.0f; // Time between current frame and last frame
-        float last_frame = 0.0f; // Time of last frame
+        m_Simulation.reset(camera);
 
-        while (!glfwWindowShouldClose(window)) {
+        if (m_Options.headless) {
+            render_loop();
+        }
+        else {
+            // Benchmark runs keep their shaders and tick the simulation inline on the fixed frame
+            // clock, like headless runs, while the camera follows the scripted path.
+            if (!m_Benchmark.enabled()) {
+                watch_shaders();
+                m_Simulation.start();
+            }
 
-            float current_frame = glfwGetTime();
-            delta_time = current_frame - last_frame;
-            last_frame = current_frame;
+            // GLFW only delivers events on the main thread, so the main thread waits for events
+            // while another one renders; input reaches the simulation however long a frame takes.
+            std::exception_ptr render_error;
+            std::atomic<bool> rendering = true;
+            std::thread render_thread([&]() {
+                try {
+                    render_loop();
+                }
+                catch (...) {
+                    render_error = std::current_exception();
+                }
+                rendering = false;
+                glfwPostEmptyEvent();
+            });
 
-            glfwPollEvents();
-            process_input(delta_time);
+            while (rendering) {
+                glfwWaitEvents();
+            }
+            render_thread.join();
+            m_Simulation.stop();
+
+            if (render_error) {
+                std::rethrow_exception(render_error);
+            }
+        }
+
+        m_Benchmark.finish("LightCasters", m_Options, m_pImmediateContext);
+
+        if (m_Profiler.capturing()) {
+            stop_trace();
+        }
+    }
+
+    void render_loop() {
+        while (m_Loop.begin_frame(window)) {
+            m_Benchmark.begin_frame(m_pImmediateContext);
+            m_Profiler.begin_frame();
+            const auto frame_scope = m_Profiler.cpu("Frame");
+
+            {
+                const auto cpu_scope = m_Profiler.cpu("Swap reloaded shaders");
+                m_ShaderReload.apply();
+            }
+
+            if (!m_Options.headless) {
+                handle_window_events();
+            }
+
+            if (m_Loop.fixed_clock()) {
+                const auto cpu_scope = m_Profiler.cpu("Simulate");
+                m_Simulation.advance_to(m_Loop.time());
+                update_scene(m_Loop.time());
+            }
+            else {
+                update_scene(m_Simulation.elapsed());
+            }
 
             render();
         }
@@ -741,47 +2168,121 @@ public:
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+    frame_benchmark m_Benchmark;
+
+    GLFWwindow* window = nullptr;
     bool show_cursor = false;
     Camera camera;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
+
+    cube_mesh                                                 m_CubeMesh;
+
+    light_pipelines                                           m_DirectionalLightPipelines;
+    light_pipelines                                           m_PointLightPipelines;
+    light_pipelines                                           m_SpotLightPipelines;
+    light_pipelines                                           m_MultiLightPipelines;
+    shader_hot_reload                                         m_ShaderReload;
+
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_InstanceBuffer;
+    size_t                                                    m_InstanceBufferCount = 0;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_VisibleInstanceBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_InstanceBoundsBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_DrawArgsBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_OccludedInstanceBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_LateVisibleInstanceBuffer;
+    cull_pipelines                                            m_CullPipelines;
+
+    Diligent::RefCntAutoPtr<Diligent::ITexture>               m_DepthPyramid;
+    std::vector<Diligent::RefCntAutoPtr<Diligent::ITextureView>> m_DepthPyramidUAVs;
+    bool                                                      m_DepthPyramidValid = false;
+
+    std::vector<InstanceData>                                 m_ContainerMatrices;
+    aabb_culler                                               m_ContainerBounds;
+    size_t                                                    m_ContainerTransformsCount = 0;
+    std::vector<Diligent::Uint32>                             m_VisibleContainers;
+    draw_list                                                 m_DrawList;
+
+    gltf_model                                                m_Model;
+    std::vector<InstanceData>                                 m_ModelObjects;
+    aabb_culler                                               m_ModelBounds;
+    std::vector<Diligent::Uint32>                             m_VisibleModelInstances;
+
+    frame_ring_buffer                                         m_FrameRing;
+    render_graph                                              m_Graph;
+    frame_profiler                                            m_Profiler;
+    latency_markers                                           m_Latency;
+
+    simulation                                                m_Simulation;
+    double                                                    m_AnimationTime = 0.0;
+    std::mutex                                                m_WindowEventsMutex;
+    std::vector<int>                                          m_PendingKeys;
+    std::optional<std::pair<int, int>>                        m_PendingSize;
+    thread_pool                                               m_WorkerPool;
+
+    light_clusters                                            m_LightClusters;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PointLightBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_SpotLightBuffer;
+    std::vector<PointLight>                                   m_PointLights;
+    std::vector<SpotLight>                                    m_SpotLights;
+    std::vector<light_orbit>                                  m_LightOrbits;
+    std::vector<glm::vec4>                                    m_LightSpheres;
+    std::vector<Diligent::Uint32>                             m_DrawOffsets;
 
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_CubeVertexBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pLightCubePSO;
+    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pLightCubeSRB;
 
-    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pDirectionalLightPSO;
-    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pDirectionalLightSRB;
+    Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_ContainerTextureSRV;
+    Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_ContainerSpecularTextureSRV;
 
-    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pPointLightPSO;
-    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pPointLightSRB;
+    std::tuple<Resource<DirectionalLight>, Resource<PointLight>, Resource<SpotLight>, Resource<LightSet>> lights;
+    Resource<Material> material;
+    Resource<FrameConstants> frame_constants;
+    Resource<cluster_constants> cluster_buffer;
+    Resource<CullConstants> cull_constants;
+    InstanceData light_cube_object;
 
-    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pSpotLightPSO;
-    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pSpotLightSRB;
+    light_pipelines* pipelines_use = nullptr;
+    std::variant<std::reference_wrapper<Resource<DirectionalLight>>, std::reference_wrapper<Resource<PointLight>>, std::reference_wrapper<Resource<SpotLight>>, std::reference_wrapper<Resource<LightSet>>> light_use = std::ref(std::get<0>(lights));
 
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_VSConstants;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSMaterial;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSCamera;
+    enum class render_mode {
+        per_draw,
+        instanced,
+        gpu_driven
+    };
 
-    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pLightCubePSO;
-    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pLightCubeSRB;
+    // Threads per group of cull.csh, and per side of a group of depth_pyramid.csh.
+    static constexpr size_t cull_group_size = 64;
+    static constexpr Diligent::Uint32 pyramid_group_size = 8;
 
-    Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_ContainerTextureSRV;
-    Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_ContainerSpecularTextureSRV;
+    render_mode mode = render_mode::per_draw;
+    bool occlusion_culling = true;
+
+    // Pipeline ids of the draw list keys.
+    enum class draw_pipeline : Diligent::Uint32 {
+        container,
+        model,
+        light_cube
+    };
 
-    std::tuple<Resource<DirectionalLight>, Resource<PointLight>, Resource<SpotLight>> lights;
+    static constexpr size_t min_container_count = 10;
+    static constexpr size_t max_container_count = 1000000;
+    size_t container_count = min_container_count;
 
-    Diligent::RefCntAutoPtr<Diligent::IPipelineState>         PSO_use;
-    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> SRB_use;
-    std::variant<std::reference_wrapper<Resource<DirectionalLight>>, std::reference_wrapper<Resource<PointLight>>, std::reference_wrapper<Resource<SpotLight>>> light_use = std::ref(std::get<0>(lights));
+    static constexpr size_t max_light_count = 10000;
+    size_t light_count = 1;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv, true));
 
         app.run();
     }
@@ -1,10 +1,9 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
+#include "../Common/benchmark.hpp"
+#include "../Common/cube_mesh.hpp"
+#include "../Common/baked_texture.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -14,6 +13,8 @@
 
 #include "DiligentTools/TextureLoader/interface/TextureUtilities.h"
 
+#include "../Common/ring_buffer.hpp"
+
 #include "glm/glm.hpp"
 #include <glm/gtc/type_ptr.hpp>
 
@@ -68,10 +69,7 @@ class application {
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        if (app->m_pSwapChain)
-        {
-            app->m_pSwapChain->Resize(width, height);
-        }
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -118,8 +116,8 @@ class application {
     }
 
     void initialize_glfw() {
-        constexpr auto width = 800;
-        constexpr auto height = 600;
+        const auto width = static_cast<int> (m_Options.width);
+        const auto height = static_cast<int> (m_Options.height);
 
         if (auto res = glfwInit(); res == GLFW_FALSE) {
             throw std::runtime_error("GLFW failed to initialize.");
@@ -147,27 +145,37 @@ class application {
 
         EngineVkCreateInfo engine_ci;
 
+        if (m_Benchmark.enabled()) {
+            engine_ci.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+        }
+
         auto vk_factory = Diligent::GetEngineFactoryVk();
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
 
-        auto handle = glfwGetWin32Window(window);
-
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
+        SwapChainDesc SCDesc;
+        SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
+        SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-            SwapChainDesc SCDesc;
-            SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
-            SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
         }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
+        }
+
+        m_PipelineCache.create(m_pDevice, "LightingMaps");
+        m_Benchmark.create(m_pDevice);
 
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
@@ -185,8 +193,8 @@ class application {
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
-        auto pDSV = m_pSwapChain->GetDepthBufferDSV();
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
+        auto pDSV = m_RenderTarget.depth_buffer_dsv();
         m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
         const glm::vec4 ClearColor = { 0.1f, 0.1f, 0.1f, 1.0f };
         m_pImmediateContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
@@ -195,73 +203,72 @@ class application {
         {
             m_pImmediateContext->SetPipelineState(m_pCubePSO);
 
-            Diligent::Uint64 offset = 0;
-            std::array pBuffs = { m_CubeVertexBuffer.RawPtr() };
-            m_pImmediateContext->SetVertexBuffers(0, pBuffs.size(), pBuffs.data(), &offset, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION, Diligent::SET_VERTEX_BUFFERS_FLAG_RESET);
+            m_CubeMesh.bind(m_pImmediateContext);
 
             glm::mat4 light_model(1.0f);
-            light_model = glm::rotate(light_model, static_cast<float> (glfwGetTime ()) * glm::radians(50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            light_model = glm::rotate(light_model, static_cast<float> (m_Loop.time()) * glm::radians(50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
             light_model = glm::translate(light_model, glm::vec3(10.2f, 1.0f, 12.0f));
             const glm::vec4 light_pos = (light_model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
-            {
-                Diligent::MapHelper<Light> CBLight(m_pImmediateContext, m_PSLight, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-
-                CBLight->position = glm::vec3(light_pos.x, light_pos.y, light_pos.z);
 
-                CBLight->ambient = glm::vec3(0.5f, 0.5f, 0.5f);
-                CBLight->diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
-                CBLight->specular = glm::vec3(1.0f, 1.0f, 1.0f);
-            }
+            m_FrameRing.reset();
 
+            Diligent::Uint32 light_offset;
             {
-                Diligent::MapHelper<Camera::CB> CBCamera(m_pImmediateContext, m_PSCamera, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
+                Light light;
+                light.position = glm::vec3(light_pos.x, light_pos.y, light_pos.z);
 
-                *CBCamera = camera.create_buffer();
+                light.ambient = glm::vec3(0.5f, 0.5f, 0.5f);
+                light.diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+                light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+                light_offset = m_FrameRing.push(light);
             }
 
+            const auto camera_offset = m_FrameRing.push(camera.create_buffer());
+
             Constants c;
             {
-                const auto& SwapChainDesc = m_pSwapChain->GetDesc();
+                const auto& SwapChainDesc = m_RenderTarget.desc();
                 const float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
                 c.view = glm::transpose(glm::lookAt(camera.eye, camera.eye + camera.front, camera.up));
                 c.projection = glm::transpose(glm::perspective(glm::radians(static_cast<float> (camera.fov)), aspect, 0.1f, 100.0f));
             }
 
-            Diligent::DrawAttribs DrawAttrs;
-            DrawAttrs.NumVertices = 36;
-            DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
+            const auto DrawAttrs = cube_mesh::draw_attribs();
 
-            const auto render_cube = [&](const glm::mat4& model) {
-                {
-                    c.model = glm::transpose(model);
-                    c.inverse_transpose_model = glm::transpose(glm::transpose(glm::inverse(model)));
+            const auto material_offset = m_FrameRing.push(Material{ 64.0f });
 
-                    Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-                    *CBConstants = c;
-                }
-                {
-                    Diligent::MapHelper<Material> CBMaterial(m_pImmediateContext, m_PSMaterial, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-                    CBMaterial->shininess = 64.0f;
-                }
+            const auto push_cube = [&](const glm::mat4& model) {
+                c.model = glm::transpose(model);
+                c.inverse_transpose_model = glm::transpose(glm::transpose(glm::inverse(model)));
 
-                m_pImmediateContext->CommitShaderResources(m_pCubeSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-                m_pImmediateContext->Draw(DrawAttrs);
+                return m_FrameRing.push(c);
             };
 
-            render_cube(glm::mat4(1.0f));
+            const auto cube_constants_offset = push_cube(glm::mat4(1.0f));
 
-            m_pImmediateContext->SetPipelineState(m_pLightCubePSO);
             c.model = glm::transpose(glm::scale(light_model, glm::vec3(0.2f)));
             c.inverse_transpose_model = glm::transpose(glm::inverse(glm::transpose(c.model)));
-            Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-            *CBConstants = c;
+            const auto light_cube_constants_offset = m_FrameRing.push(c);
+
+            m_FrameRing.upload(m_pImmediateContext);
+
+            m_pCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_PIXEL, "Lights")->SetBufferOffset(light_offset);
+            m_pCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_PIXEL, "Materials")->SetBufferOffset(material_offset);
+            m_pCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_PIXEL, "Camera")->SetBufferOffset(camera_offset);
+
+            m_pCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_VERTEX, "Constants")->SetBufferOffset(cube_constants_offset);
+            m_pImmediateContext->CommitShaderResources(m_pCubeSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+            m_pImmediateContext->DrawIndexed(DrawAttrs);
 
+            m_pImmediateContext->SetPipelineState(m_pLightCubePSO);
+            m_pLightCubeSRB->GetVariableByName(Diligent::SHADER_TYPE_VERTEX, "Constants")->SetBufferOffset(light_cube_constants_offset);
             m_pImmediateContext->CommitShaderResources(m_pLightCubeSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-            m_pImmediateContext->Draw(DrawAttrs);
+            m_pImmediateContext->DrawIndexed(DrawAttrs);
         }
 
+        m_Benchmark.end_frame(m_pImmediateContext);
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
     void create_pipeline_states() {
@@ -271,8 +278,8 @@ class application {
         PSOCreateInfo.PSODesc.Name = "Cube PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
-        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_RenderTarget.desc().DepthBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = true;
         PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_NONE;
@@ -284,24 +291,25 @@ class application {
         m_pEngineFactory->CreateDefaultShaderSourceStreamFactory(nullptr, &pShaderSourceFactory);
         ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
 
-        std::array LayoutElems =
+        PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = packed_vertex::layout.data();
+        PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = packed_vertex::layout.size();
+
+        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+
+        std::array LightCubeVars =
         {
-            LayoutElement{0, 0, 3, VT_FLOAT32, False},
-            LayoutElement{1, 0, 3, VT_FLOAT32, False},
-            LayoutElement{2, 0, 2, VT_FLOAT32, False}
+            ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Constants", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
         };
 
-        PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = LayoutElems.data();
-        PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = LayoutElems.size();
-
-        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables = LightCubeVars.data();
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = LightCubeVars.size();
 
         RefCntAutoPtr<IShader> pLightCubeVS;
         {
             ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
             ShaderCI.Desc.Name = "Light Cube vertex shader";
             ShaderCI.FilePath = "light_cube.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubeVS);
+            m_PipelineCache.create_shader(ShaderCI, &pLightCubeVS);
         }
 
         RefCntAutoPtr<IShader> pLightCubePS;
@@ -309,19 +317,23 @@ class application {
             ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
             ShaderCI.Desc.Name = "Light Cube pixel shader";
             ShaderCI.FilePath = "light_cube.psh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubePS);
+            m_PipelineCache.create_shader(ShaderCI, &pLightCubePS);
         }
 
         PSOCreateInfo.PSODesc.Name = "Light Cube PSO";
 
         PSOCreateInfo.pVS = pLightCubeVS;
         PSOCreateInfo.pPS = pLightCubePS;
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pLightCubePSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pLightCubePSO);
 
         std::array CombinedVars =
         {
             ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "diffuse_texture", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
           , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "specular_texture", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+          , ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Constants", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Lights", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Materials", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+          , ShaderResourceVariableDesc{SHADER_TYPE_PIXEL, "Camera", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
         };
 
         PSOCreateInfo.PSODesc.ResourceLayout.Variables = CombinedVars.data();
@@ -347,7 +359,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Colors vertex shader";
             ShaderCI.FilePath = "colors.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+            m_PipelineCache.create_shader(ShaderCI, &pVS);
         }
 
         RefCntAutoPtr<IShader> pCombinedPS;
@@ -356,26 +368,25 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Colors pixel shader";
             ShaderCI.FilePath = "colors.psh";
-            m_pDevice->CreateShader(ShaderCI, &pCombinedPS);
+            m_PipelineCache.create_shader(ShaderCI, &pCombinedPS);
         }
 
         PSOCreateInfo.pVS = pVS;
         PSOCreateInfo.pPS = pCombinedPS;
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pCubePSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pCubePSO);
 
         create_uniform_buffers();
 
-
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
-        m_pLightCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
-
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Lights")->Set(m_PSLight);
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Materials")->Set(m_PSMaterial);
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Camera")->Set(m_PSCamera);
-
         m_pCubePSO->CreateShaderResourceBinding(&m_pCubeSRB, true);
         m_pLightCubePSO->CreateShaderResourceBinding(&m_pLightCubeSRB, true);
 
+        m_FrameRing.bind<Constants>(*m_pCubeSRB, SHADER_TYPE_VERTEX, "Constants");
+        m_FrameRing.bind<Light>(*m_pCubeSRB, SHADER_TYPE_PIXEL, "Lights");
+        m_FrameRing.bind<Material>(*m_pCubeSRB, SHADER_TYPE_PIXEL, "Materials");
+        m_FrameRing.bind<Camera::CB>(*m_pCubeSRB, SHADER_TYPE_PIXEL, "Camera");
+
+        m_FrameRing.bind<Constants>(*m_pLightCubeSRB, SHADER_TYPE_VERTEX, "Constants");
+
     }
 
     void load_container_texture() {
@@ -384,7 +395,7 @@ class application {
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB = true;
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\container2.png)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("container2.png"), loadInfo, m_pDevice, &Tex);
 
         m_ContainerTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -395,9 +406,9 @@ class application {
         using namespace Diligent;
 
         TextureLoadInfo loadInfo;
-        loadInfo.IsSRGB = true;
+        loadInfo.IsSRGB = false; // a specular mask, not color
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\container2_specular.png)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("container2_specular.png"), loadInfo, m_pDevice, &Tex);
 
         m_ContainerSpecularTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -410,100 +421,19 @@ class application {
     }
 
     void create_uniform_buffers() {
-        using namespace Diligent;
-
-        BufferDesc CBDesc;
-        CBDesc.Usage = USAGE_DYNAMIC;
-        CBDesc.BindFlags = BIND_UNIFORM_BUFFER;
-        CBDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
-
-        CBDesc.Name = "VS constants CB";
-        CBDesc.Size = sizeof(Constants);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_VSConstants);
-
-        CBDesc.Name = "PS Light CB";
-        CBDesc.Size = sizeof(Light);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSLight);
-
-        CBDesc.Name = "PS Material CB";
-        CBDesc.Size = sizeof(Material);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSMaterial);
-
-        CBDesc.Name = "PS Camera CB";
-        CBDesc.Size = sizeof(Camera::CB);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSCamera);
-
+        m_FrameRing.create(*m_pDevice, 64 << 10, "Frame constants ring");
     }
 
     void create_cube_buffer() {
-
-        struct cube_vertex {
-            glm::vec3 pos;
-            glm::vec3 normal;
-            glm::vec2 uv;
-        };
-
-        std::array vertices = {
-            //face front
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f,  0.0f, -1.0f), .uv = glm::vec2(0.0f,  0.0f)},
-            //face back                                              
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f,  0.0f,  1.0f), .uv = glm::vec2(0.0f,  0.0f)},
-            //face right
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-            //face left
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f, -0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(1.0f,  0.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-            //face top                                               
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f,  0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f, -0.5f, -0.5f), .normal = glm::vec3(0.0f, -1.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-            //face bottom                                            
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(1.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( 0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f,  0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(-0.5f,  0.5f, -0.5f), .normal = glm::vec3(0.0f,  1.0f,  0.0f), .uv = glm::vec2(0.0f,  1.0f)}       
-        };
-
-        using namespace Diligent;
-        BufferDesc VertBuffDesc;
-        VertBuffDesc.Name = "Cube vertex buffer";
-        VertBuffDesc.Usage = USAGE_IMMUTABLE;
-        VertBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
-        VertBuffDesc.Size = vertices.size() * sizeof(decltype(vertices)::value_type);
-        BufferData VBData;
-        VBData.pData = vertices.data();
-        VBData.DataSize = vertices.size() * sizeof(decltype(vertices)::value_type);
-        m_pDevice->CreateBuffer(VertBuffDesc, &VBData, &m_CubeVertexBuffer);
-
+        m_CubeMesh.create(m_pDevice);
     }
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options)
+        , m_Benchmark(Options) {
         init();
     }
 
@@ -513,45 +443,58 @@ public:
 
     void run() {
         create_pipeline_states();
+        m_PipelineCache.save();
         load_textures();
         create_cube_buffer();
 
         float delta_time = 0.0f;	// Time between current frame and last frame
         float last_frame = 0.0f; // Time of last frame
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
+            m_Benchmark.begin_frame(m_pImmediateContext);
 
-            float current_frame = glfwGetTime();
+            float current_frame = m_Loop.time();
             delta_time = current_frame - last_frame;
             last_frame = current_frame;
 
-            glfwPollEvents();
-            process_input(delta_time);
+            if (!m_Options.headless) {
+                glfwPollEvents();
+                if (!m_Benchmark.enabled()) {
+                    process_input(delta_time);
+                }
+            }
+            if (m_Benchmark.enabled()) {
+                frame_benchmark::place_camera(camera, m_Loop.time());
+            }
 
             render();
         }
+
+        m_Benchmark.finish("LightingMaps", m_Options, m_pImmediateContext);
     }
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+    frame_benchmark m_Benchmark;
+
+    GLFWwindow* window = nullptr;
     bool show_cursor = false;
     Camera camera;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
 
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_CubeVertexBuffer;
+    cube_mesh                                                 m_CubeMesh;
 
     Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pCubePSO;
     Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pCubeSRB;
 
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_VSConstants;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSLight;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSMaterial;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSCamera;
+    frame_ring_buffer                                         m_FrameRing;
 
     Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pLightCubePSO;
     Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pLightCubeSRB;
@@ -560,10 +503,10 @@ private:
     Diligent::RefCntAutoPtr<Diligent::ITextureView>           m_ContainerSpecularTextureSRV;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
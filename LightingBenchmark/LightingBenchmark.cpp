@@ -0,0 +1,117 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs every lighting sample in benchmark mode and collects their reports into one JSON file.
+//
+//   LightingBenchmark [--out FILE] [--source DIR] [sample options...]
+//
+// Each sample runs with --benchmark (Common/benchmark.hpp), so it flies the same scripted camera
+// on a fixed clock and reports min/avg/p50/p95/p99/max of its frame, CPU and GPU times. Everything
+// after the LightingBenchmark options is passed on to every sample, e.g.
+//
+//   LightingBenchmark --out release.json --headless --frames 1200 --width 1920 --height 1080
+//
+// The samples are looked for next to this executable, and run from their source directories,
+// where they find their shaders. --source names the solution directory if it isn't two levels up
+// from the executable, as in the default x64\<Configuration> output layout or CMake's build/bin.
+// FILE defaults to lighting_benchmark.json and holds a "runs" array with one report per sample; a
+// sample that fails is recorded with its exit code instead.
+struct sample {
+    const char* executable;
+    const char* directory;
+};
+
+constexpr sample lighting_samples[] = {
+    { "Colors", "Colors" },
+    { "BasicLighting", "Basic Lighting" },
+    { "Materials", "Materials" },
+    { "LightingMaps", "Lighting Maps" },
+    { "LightCasters", "LightCasters" },
+};
+
+std::string quoted(const std::string& Text) {
+    return "\"" + Text + "\"";
+}
+
+std::string read_file(const std::filesystem::path& Path) {
+    std::ifstream File(Path);
+    std::stringstream Contents;
+    Contents << File.rdbuf();
+    return Contents.str();
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        const auto BinaryDir = std::filesystem::absolute(argv[0]).parent_path();
+        auto SourceDir = BinaryDir.parent_path().parent_path();
+        std::filesystem::path OutPath = "lighting_benchmark.json";
+        std::string SampleArgs;
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg = argv[i];
+            if ((arg == "--out" || arg == "--source") && i + 1 < argc) {
+                (arg == "--out" ? OutPath : SourceDir) = std::filesystem::absolute(argv[++i]);
+            }
+            else if (arg == "--benchmark") {
+                throw std::runtime_error("--benchmark is set per sample; use --out for the combined report.");
+            }
+            else {
+                SampleArgs += " " + quoted(argv[i]);
+            }
+        }
+        OutPath = std::filesystem::absolute(OutPath);
+
+        std::vector<std::string> Runs;
+        for (const auto& Sample : lighting_samples) {
+            auto Executable = BinaryDir / Sample.executable;
+#ifdef _WIN32
+            Executable += ".exe";
+#endif
+            const auto Report = std::filesystem::temp_directory_path() / (std::string(Sample.executable) + "_benchmark.json");
+            std::filesystem::remove(Report);
+
+            std::cout << "Running " << Sample.executable << std::endl;
+            std::filesystem::current_path(SourceDir / Sample.directory);
+
+            auto Command = quoted(Executable.string()) + SampleArgs + " --benchmark " + quoted(Report.string());
+#ifdef _WIN32
+            // cmd strips the outer quotes of the whole line when it starts with one.
+            Command = quoted(Command);
+#endif
+            const int Result = std::system(Command.c_str());
+
+            if (Result != 0 || !std::filesystem::exists(Report)) {
+                std::cerr << Sample.executable << " failed with exit code " << Result << "\n";
+                Runs.push_back("{ \"sample\": \"" + std::string(Sample.executable) + "\", \"exit_code\": " + std::to_string(Result) + " }\n");
+                continue;
+            }
+            Runs.push_back(read_file(Report));
+            std::filesystem::remove(Report);
+        }
+
+        std::ofstream Out(OutPath);
+        if (!Out) {
+            throw std::runtime_error("Failed to open " + OutPath.string() + " for writing.");
+        }
+        Out << "{ \"runs\": [\n";
+        for (size_t i = 0; i < Runs.size(); ++i) {
+            Out << (i ? ",\n" : "") << Runs[i];
+        }
+        Out << "] }\n";
+
+        std::cout << "Report written to " << OutPath.string() << "\n";
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -1,10 +1,8 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
+#include "../Common/benchmark.hpp"
+#include "../Common/cube_mesh.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -14,24 +12,47 @@
 
 #include "DiligentTools/TextureLoader/interface/TextureUtilities.h"
 
+#include "../Common/ring_buffer.hpp"
+#include "../Common/constant_buffer.hpp"
+#include "../Common/frustum_culling.hpp"
+#include "../Common/transform_batch.hpp"
+#include "../Common/thread_pool.hpp"
+#include "../Common/shader_hot_reload.hpp"
+#include "../Common/render_graph.hpp"
+#include "../Common/draw_list.hpp"
+
 #include "glm/glm.hpp"
 #include <glm/gtc/type_ptr.hpp>
 
 #include "vulkan/vulkan.hpp"
 
 #include <array>
+#include <cstddef>
 #include <iostream>
+#include <memory>
 #include <optional>
-//used in 
-struct Constants
+#include <string>
+#include <vector>
+// The "Frame" constants of constants.fxh: the camera, uploaded once per frame when it moved.
+struct FrameConstants
 {
-    glm::mat4 model = glm::mat4(1.0f);
     glm::mat4 view = glm::mat4(1.0f);
     glm::mat4 projection = glm::mat4(1.0f);
-    glm::mat4 inverse_transpose_model;
+    alignas(16) glm::vec3 view_position;
+};
+
+// The "Object" constants of colors.vsh, pushed into the frame ring per draw. Matrices are stored
+// transposed, as transform_batch writes them.
+struct ObjectConstants
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::mat4 inverse_transpose_model = glm::mat4(1.0f);
+    // Row of the material table the cube is shaded with.
+    Diligent::Uint32 material_index = 0;
 };
 
 
+// Also the element layout of the material table's structured buffer.
 struct Material {
     alignas(16) glm::vec3 ambient;
     alignas(16) glm::vec3 diffuse;
@@ -115,10 +136,6 @@ struct Light {
 
 struct Camera
 {
-    struct CB {
-        alignas(16) glm::vec3 view_position;
-    };
-
     glm::vec3 eye       = glm::vec3(0.0f, 0.0f, 3.0f);
     glm::vec3 front     = glm::vec3(0.0f, 0.0f, -1.0f);
     glm::vec3 up        = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -130,20 +147,21 @@ struct Camera
     std::optional<float> last_y;
 
     double fov = 45.0;
+};
 
-    CB create_buffer() const {
-        return CB{ .view_position = eye };
-    }
+// The cube pipeline, with an SRB for the immediate context and one for each deferred context.
+struct cube_pipeline
+{
+    Diligent::RefCntAutoPtr<Diligent::IPipelineState>                      pso;
+    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding>              srb;
+    std::vector<Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding>> recorder_srbs;
 };
 
 class application {
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
 
-        if (app->m_pSwapChain)
-        {
-            app->m_pSwapChain->Resize(width, height);
-        }
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -160,6 +178,21 @@ class application {
             case GLFW_KEY_2:
                 app->mode = render_mode::many_cubes;
                 break;
+            case GLFW_KEY_3:
+                app->mode = render_mode::cube_grid;
+                break;
+            case GLFW_KEY_EQUAL:
+                app->cube_grid_size = std::min<size_t>(app->cube_grid_size * 2, 1024);
+                std::cout << app->cube_grid_size << "x" << app->cube_grid_size << " cubes\n";
+                break;
+            case GLFW_KEY_MINUS:
+                app->cube_grid_size = std::max<size_t>(app->cube_grid_size / 2, 8);
+                std::cout << app->cube_grid_size << "x" << app->cube_grid_size << " cubes\n";
+                break;
+            case GLFW_KEY_T:
+                app->parallel_recording = !app->parallel_recording;
+                std::cout << (app->parallel_recording ? "Recording on " + std::to_string(app->m_Recorders.size()) + " deferred contexts\n" : std::string("Recording on the immediate context\n"));
+                break;
             case GLFW_KEY_LEFT_SHIFT:
             {
                 app->show_cursor = !app->show_cursor;
@@ -220,8 +253,8 @@ class application {
     }
 
     void initialize_glfw() {
-        constexpr auto width = 800;
-        constexpr auto height = 600;
+        const auto width = static_cast<int> (m_Options.width);
+        const auto height = static_cast<int> (m_Options.height);
 
         if (auto res = glfwInit(); res == GLFW_FALSE) {
             throw std::runtime_error("GLFW failed to initialize.");
@@ -248,28 +281,53 @@ class application {
         using namespace Diligent;
 
         EngineVkCreateInfo engine_ci;
+        // The cube grid pushes an ObjectConstants slice per visible cube, across all recording
+        // contexts, which outgrows the default 8MB dynamic heap quickly.
+        engine_ci.DynamicHeapSize = 128 << 20;
+        // One deferred context per thread of the worker pool, the main thread included.
+        engine_ci.NumDeferredContexts = static_cast<Uint32> (m_WorkerPool.size());
+
+        if (m_Benchmark.enabled()) {
+            engine_ci.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+        }
 
         auto vk_factory = Diligent::GetEngineFactoryVk();
 
-        vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
+        std::vector<IDeviceContext*> contexts(1 + engine_ci.NumDeferredContexts);
+        vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, contexts.data());
+        if (!m_pDevice) {
+            throw std::runtime_error("Failed to create the Vulkan device.");
+        }
 
-        auto handle = glfwGetWin32Window(window);
+        m_pImmediateContext.Attach(contexts[0]);
+        m_Recorders.resize(engine_ci.NumDeferredContexts);
+        for (size_t i = 0; i < m_Recorders.size(); ++i) {
+            m_Recorders[i].context.Attach(contexts[1 + i]);
+        }
 
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
+        SwapChainDesc SCDesc;
+        SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
+        SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-            SwapChainDesc SCDesc;
-            SCDesc.ColorBufferFormat = Diligent::TEXTURE_FORMAT::TEX_FORMAT_BGRA8_UNORM;
-            SCDesc.DepthBufferFormat = TEX_FORMAT_D32_FLOAT;
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
+        }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
         }
 
+        m_PipelineCache.create(m_pDevice, "Materials");
+        m_Benchmark.create(m_pDevice);
+
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
@@ -286,379 +344,611 @@ class application {
             camera.eye += glm::normalize(glm::cross(camera.front, camera.up)) * camera_speed;
     }
 
-    void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
-        auto pDSV = m_pSwapChain->GetDepthBufferDSV();
-        m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-        const glm::vec4 ClearColor = { 0.1f, 0.1f, 0.1f, 1.0f };
-        m_pImmediateContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-        m_pImmediateContext->ClearDepthStencil(pDSV, Diligent::CLEAR_DEPTH_FLAG, 1.f, 0, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    // Records the draws of m_VisibleCubes[First, Last) into pContext, with their object constants
+    // pushed into Ring as many at a time as fit. Each upload discards the ring's previous contents,
+    // which the draws recorded before it keep reading. The frame and pass constants are already on
+    // the GPU and bound to the pipeline.
+    void record_cubes(Diligent::IDeviceContext* pContext, frame_ring_buffer& Ring, Diligent::IShaderResourceBinding& SRB, std::vector<Diligent::Uint32>& Draws,
+        size_t First, size_t Last, Diligent::RESOURCE_STATE_TRANSITION_MODE Mode) {
+        const auto DrawAttrs = cube_mesh::draw_attribs();
 
-        {
-            m_pImmediateContext->SetPipelineState(m_pCubePSO);
+        auto* pObjectVar = SRB.GetVariableByName(Diligent::SHADER_TYPE_VERTEX, "Object");
 
-            Diligent::Uint64 offset = 0;
-            std::array pBuffs = { m_CubeVertexBuffer.RawPtr() };
-            m_pImmediateContext->SetVertexBuffers(0, pBuffs.size(), pBuffs.data(), &offset, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION, Diligent::SET_VERTEX_BUFFERS_FLAG_RESET);
+        size_t next_visible = First;
+        do {
+            Ring.reset();
 
-            glm::mat4 light_model(1.0f);
-            light_model = glm::rotate(light_model, static_cast<float> (glfwGetTime ()) * glm::radians(50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            light_model = glm::translate(light_model, glm::vec3(10.2f, 1.0f, 12.0f));
-            const glm::vec4 light_pos = (light_model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
-            {
-                Diligent::MapHelper<Light> CBLight(m_pImmediateContext, m_PSLight, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
+            Draws.clear();
+            for (; next_visible < Last && Ring.can_push<ObjectConstants>(); ++next_visible) {
+                Draws.push_back(Ring.push(m_CubeObjects[m_VisibleCubes[next_visible]]));
+            }
 
-                CBLight->position = glm::vec3(light_pos.x, light_pos.y, light_pos.z);
+            Ring.upload(pContext);
 
-                if (mode == render_mode::coral_cube && single_cube_material_index == MaterialsDictionary::materials.size() - 1) {
-                    CBLight->ambient = glm::vec3(0.2f, 0.2f, 0.2f);
-                    CBLight->diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
-                    CBLight->specular = glm::vec3(1.0f, 1.0f, 1.0f);
-                }
-                else {
-                    CBLight->ambient = glm::vec3(1.0f);
-                    CBLight->diffuse = glm::vec3(1.0f);
-                    CBLight->specular = glm::vec3(1.0f);
-                }
+            for (const auto object_offset : Draws) {
+                pObjectVar->SetBufferOffset(object_offset);
 
+                pContext->CommitShaderResources(&SRB, Mode);
+                pContext->DrawIndexed(DrawAttrs);
             }
+        } while (next_visible < Last);
+    }
 
-            {
-                Diligent::MapHelper<Camera::CB> CBCamera(m_pImmediateContext, m_PSCamera, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
+    // Splits the visible cubes into contiguous runs, one per deferred context, records the runs on
+    // the worker pool and executes the command lists on the immediate context in order, so the
+    // result matches recording everything on the immediate context.
+    void record_cubes_in_parallel() {
+        using namespace Diligent;
 
-                *CBCamera = camera.create_buffer();
-            }
+        const size_t visible_count = m_VisibleCubes.size();
+        const size_t recorder_count = std::min(m_Recorders.size(), (visible_count + min_cubes_per_recorder - 1) / min_cubes_per_recorder);
 
-            Constants c;
-            {
-                const auto& SwapChainDesc = m_pSwapChain->GetDesc();
-                const float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
-                c.view = glm::transpose(glm::lookAt(camera.eye, camera.eye + camera.front, camera.up));
-                c.projection = glm::transpose(glm::perspective(glm::radians(static_cast<float> (camera.fov)), aspect, 0.1f, 100.0f));
-            }
+        auto* pRTV = m_RenderTarget.back_buffer_rtv();
+        auto* pDSV = m_RenderTarget.depth_buffer_dsv();
 
-            Diligent::DrawAttribs DrawAttrs;
-            DrawAttrs.NumVertices = 36;
-            DrawAttrs.Flags = Diligent::DRAW_FLAG_VERIFY_ALL;
+        m_WorkerPool.run(recorder_count, [&](size_t index) {
+            auto& recorder = m_Recorders[index];
+            auto* pContext = recorder.context.RawPtr();
 
-            const auto render_cube = [&](const glm::mat4& model, const Material& material) {
-                {
-                    c.model = glm::transpose(model);
-                    c.inverse_transpose_model = glm::transpose(glm::transpose(glm::inverse(model)));
+            // The render graph already moved the render targets and the cube mesh into the states
+            // these draws need; deferred contexts only verify them.
+            pContext->Begin(0);
+            pContext->SetRenderTargets(1, &pRTV, pDSV, render_graph::pass_mode);
+            pContext->SetPipelineState(m_pCubePSO);
+            m_CubeMesh.bind(pContext, render_graph::pass_mode);
 
-                    Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-                    *CBConstants = c;
-                }
-                {
-                    Diligent::MapHelper<Material> CBMaterial(m_pImmediateContext, m_PSMaterial, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-                    *CBMaterial = material;
-                    CBMaterial->shininess *= 128.0f;
-                }
+            record_cubes(pContext, recorder.ring, *recorder.srb, recorder.draws,
+                visible_count * index / recorder_count, visible_count * (index + 1) / recorder_count, render_graph::pass_mode);
 
-                m_pImmediateContext->CommitShaderResources(m_pCubeSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-                m_pImmediateContext->Draw(DrawAttrs);
-            };
+            pContext->FinishCommandList(&recorder.commands);
+        });
+
+        std::vector<ICommandList*> command_lists;
+        for (size_t i = 0; i < recorder_count; ++i) {
+            command_lists.push_back(m_Recorders[i].commands);
+        }
+        if (!command_lists.empty()) {
+            m_pImmediateContext->ExecuteCommandLists(static_cast<Uint32> (command_lists.size()), command_lists.data());
+        }
 
-            Material material{ .ambient = glm::vec3(1.0f, 0.5f, 0.31f), .diffuse = glm::vec3(1.0f, 0.5f, 0.31f), .specular = glm::vec3(0.5f, 0.5f, 0.5f) , .shininess = 32.0f };
+        // Releases the dynamic memory the rings were mapped to once the GPU is done with the frame.
+        for (size_t i = 0; i < recorder_count; ++i) {
+            m_Recorders[i].commands.Release();
+            m_Recorders[i].context->FinishFrame();
+        }
 
+        // Executing command lists resets the immediate context's state. The scene pass already
+        // moved everything into place, so this only verifies too.
+        m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, render_graph::pass_mode);
+        m_CubeMesh.bind(m_pImmediateContext, render_graph::pass_mode);
+    }
 
-            switch (mode)
-            {
-            case render_mode::coral_cube:
-            {
-                render_cube(glm::mat4(1.0f), MaterialsDictionary::materials.at(single_cube_material_index).material);
+    void render() {
+        using namespace Diligent;
+
+        glm::mat4 light_model(1.0f);
+        light_model = glm::rotate(light_model, static_cast<float> (m_Loop.time()) * glm::radians(50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        light_model = glm::translate(light_model, glm::vec3(10.2f, 1.0f, 12.0f));
+        const glm::vec4 light_pos = (light_model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+        {
+            Light light{};
+            light.position = glm::vec3(light_pos.x, light_pos.y, light_pos.z);
+
+            if (mode == render_mode::coral_cube && single_cube_material_index == MaterialsDictionary::materials.size() - 1) {
+                light.ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+                light.diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+                light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
             }
-                break;
-            case render_mode::many_cubes:
-            {   
-                for (int i = -2; i <= 2; ++i) {
-                    for (int j = -2; j <= 2; ++j) {
+            else {
+                light.ambient = glm::vec3(1.0f);
+                light.diffuse = glm::vec3(1.0f);
+                light.specular = glm::vec3(1.0f);
+            }
+            m_LightConstants.update(m_pImmediateContext, light);
+        }
 
+        frustum view_frustum;
+        {
+            const auto& SwapChainDesc = m_RenderTarget.desc();
+            const float aspect = static_cast<float> (SwapChainDesc.Width) / static_cast<float> (SwapChainDesc.Height);
+            const glm::mat4 view = glm::lookAt(camera.eye, camera.eye + camera.front, camera.up);
+            const glm::mat4 projection = glm::perspective(glm::radians(static_cast<float> (camera.fov)), aspect, 0.1f, 100.0f);
+
+            FrameConstants frame{};
+            frame.view = glm::transpose(view);
+            frame.projection = glm::transpose(projection);
+            frame.view_position = camera.eye;
+            m_FrameConstants.update(m_pImmediateContext, frame);
+
+            view_frustum = frustum::from_matrix(projection * view);
+        }
 
-                        const auto& m = MaterialsDictionary::materials[5 * i + j + 12];
+        m_CubeMaterials.clear();
+        m_CubeTransforms.clear();
+        m_CubeBounds.clear();
 
-                        glm::mat4 model = glm::mat4(1.0f);
-                        model = glm::translate(model, glm::vec3(i * 3.0f , j * 3.0f,  0.0f));
+        // Only queues the cube; the ones inside the view frustum get recorded below.
+        const auto render_cube = [&](const glm::vec3& position, size_t material_index) {
+            m_CubeMaterials.push_back(static_cast<Uint32> (material_index));
+            m_CubeTransforms.add(position);
+            m_CubeBounds.add(position, glm::vec3(0.5f));
+        };
 
-                        render_cube(model, m.material);
+        const size_t coral_index = MaterialsDictionary::materials.size() - 1;
+
+
+        switch (mode)
+        {
+        case render_mode::coral_cube:
+        {
+            render_cube(glm::vec3(0.0f), single_cube_material_index);
+        }
+            break;
+        case render_mode::many_cubes:
+        {   
+            for (int i = -2; i <= 2; ++i) {
+                for (int j = -2; j <= 2; ++j) {
+
+
+                    render_cube(glm::vec3(i * 3.0f, j * 3.0f, 0.0f), 5 * i + j + 12);
 
-                    }
                 }
             }
-                break;
+        }
+            break;
+        case render_mode::cube_grid:
+        {
+            // A floor of cubes around the origin, for stressing draw recording.
+            const float half_extent = static_cast<float> (cube_grid_size) * 0.5f;
+            m_CubeTransforms.reserve(cube_grid_size * cube_grid_size + 1);
+            for (size_t i = 0; i < cube_grid_size; ++i) {
+                for (size_t j = 0; j < cube_grid_size; ++j) {
+                    render_cube(glm::vec3((i - half_extent) * 2.0f, -3.0f, (j - half_extent) * 2.0f), (i + j) % MaterialsDictionary::materials.size());
+                }
             }
+        }
+            break;
+        }
+
 
 
 
+        
 
-            
+        render_cube(glm::vec3(0.0f), coral_index);
 
-            render_cube(glm::mat4(1.0f), material);
+        m_CubeObjects.resize(m_CubeTransforms.size());
+        m_CubeTransforms.write_matrices(0, m_CubeTransforms.size(), m_CubeObjects.data(), sizeof(ObjectConstants),
+            offsetof(ObjectConstants, model), offsetof(ObjectConstants, inverse_transpose_model));
+        for (size_t i = 0; i < m_CubeObjects.size(); ++i) {
+            m_CubeObjects[i].material_index = m_CubeMaterials[i];
+        }
 
-            m_pImmediateContext->SetPipelineState(m_pLightCubePSO);
-            c.model = glm::transpose(glm::scale(light_model, glm::vec3(0.2f)));
-            c.inverse_transpose_model = glm::transpose(glm::inverse(glm::transpose(c.model)));
-            Diligent::MapHelper<Constants> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
-            *CBConstants = c;
+        m_CubeBounds.cull(view_frustum, m_VisibleCubes);
+
+        // The material table makes switching materials free, so cubes only sort front to back.
+        // The light cube has its own pipeline and comes after them.
+        {
+            const auto view_depth = [&](const glm::vec3& position) {
+                return draw_list::quantize_depth(glm::dot(position - camera.eye, camera.front), 0.1f, 100.0f);
+            };
 
-            m_pImmediateContext->CommitShaderResources(m_pLightCubeSRB, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-            m_pImmediateContext->Draw(DrawAttrs);
+            m_DrawList.clear();
+            m_DrawList.reserve(m_VisibleCubes.size() + 1);
+            for (const auto cube : m_VisibleCubes) {
+                m_DrawList.submit(draw_list::make_key(0, static_cast<Uint32> (draw_pipeline::cube), 0, 0, view_depth(m_CubeBounds.center(cube))), cube);
+            }
+            m_DrawList.submit(draw_list::make_key(0, static_cast<Uint32> (draw_pipeline::light_cube), 0, 0, view_depth(glm::vec3(light_pos))), 0);
+            m_DrawList.sort();
         }
 
+        // Everything the scene pass touches, so the graph can move it into place with one batch
+        // of transitions and the draws only verify.
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
+        auto pDSV = m_RenderTarget.depth_buffer_dsv();
+
+        m_Graph.reset();
+        const auto BackBuffer = m_Graph.import_texture(pRTV->GetTexture());
+        const auto DepthBuffer = m_Graph.import_texture(pDSV->GetTexture());
+        const auto Vertices = m_Graph.import_buffer(m_CubeMesh.vertex_buffer());
+        const auto Indices = m_Graph.import_buffer(m_CubeMesh.index_buffer());
+        const auto FrameCB = m_Graph.import_buffer(m_FrameConstants.buffer());
+        const auto LightCB = m_Graph.import_buffer(m_LightConstants.buffer());
+        const auto MaterialTable = m_Graph.import_buffer(m_pMaterialTable);
+
+        m_Graph.add_pass("Scene", {
+            render_graph::write(BackBuffer, RESOURCE_STATE_RENDER_TARGET),
+            render_graph::write(DepthBuffer, RESOURCE_STATE_DEPTH_WRITE),
+            render_graph::read(Vertices, RESOURCE_STATE_VERTEX_BUFFER),
+            render_graph::read(Indices, RESOURCE_STATE_INDEX_BUFFER),
+            render_graph::read(FrameCB, RESOURCE_STATE_CONSTANT_BUFFER),
+            render_graph::read(LightCB, RESOURCE_STATE_CONSTANT_BUFFER),
+            render_graph::read(MaterialTable, RESOURCE_STATE_SHADER_RESOURCE),
+        }, [&](IDeviceContext* pContext) {
+            pContext->SetRenderTargets(1, &pRTV, pDSV, render_graph::pass_mode);
+            const glm::vec4 ClearColor = { 0.1f, 0.1f, 0.1f, 1.0f };
+            pContext->ClearRenderTarget(pRTV, glm::value_ptr(ClearColor), render_graph::pass_mode);
+            pContext->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 1.f, 0, render_graph::pass_mode);
+
+            m_CubeMesh.bind(pContext, render_graph::pass_mode);
+
+            m_DrawList.for_each_run([&](Uint64 Key, size_t First, size_t Last) {
+                switch (static_cast<draw_pipeline> (draw_list::pipeline(Key)))
+                {
+                case draw_pipeline::cube:
+                {
+                    // The run's cubes in key order, which the recorders split between them.
+                    m_VisibleCubes.clear();
+                    for (size_t i = First; i < Last; ++i) {
+                        m_VisibleCubes.push_back(m_DrawList[i].index);
+                    }
+
+                    pContext->SetPipelineState(m_pCubePSO);
+                    if (parallel_recording && !m_Recorders.empty()) {
+                        record_cubes_in_parallel();
+                    }
+                    else {
+                        record_cubes(pContext, m_FrameRing, *m_pCubeSRB, m_CubeDraws, 0, m_VisibleCubes.size(), render_graph::pass_mode);
+                    }
+                }
+                    break;
+                case draw_pipeline::light_cube:
+                {
+                    m_FrameRing.reset();
+                    ObjectConstants light_cube;
+                    light_cube.model = glm::transpose(glm::scale(light_model, glm::vec3(0.2f)));
+                    const auto light_cube_offset = m_FrameRing.push(light_cube);
+                    m_FrameRing.upload(pContext);
+
+                    pContext->SetPipelineState(m_pLightCubePSO);
+                    m_pLightCubeSRB->GetVariableByName(SHADER_TYPE_VERTEX, "Object")->SetBufferOffset(light_cube_offset);
+                    pContext->CommitShaderResources(m_pLightCubeSRB, render_graph::pass_mode);
+                    pContext->DrawIndexed(cube_mesh::draw_attribs());
+                }
+                    break;
+                }
+            });
+        });
+
+        m_Graph.execute(m_pImmediateContext);
+
+        m_Benchmark.end_frame(m_pImmediateContext);
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
-    void create_pipeline_states() {
+    Diligent::GraphicsPipelineStateCreateInfo pipeline_create_info() const {
         using namespace Diligent;
         GraphicsPipelineStateCreateInfo PSOCreateInfo;
 
-        PSOCreateInfo.PSODesc.Name = "Cube PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
-        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.DSVFormat = m_RenderTarget.desc().DepthBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = true;
         PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_NONE;
 
-        ShaderCreateInfo ShaderCI;
-        ShaderCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
+        PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = packed_vertex::layout.data();
+        PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = packed_vertex::layout.size();
+
+        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+        return PSOCreateInfo;
+    }
+
+    Diligent::RefCntAutoPtr<Diligent::IShader> create_shader(Diligent::SHADER_TYPE Type, const char* Name, const char* FilePath) {
+        using namespace Diligent;
 
         RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
         m_pEngineFactory->CreateDefaultShaderSourceStreamFactory(nullptr, &pShaderSourceFactory);
-        ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
-
-        RefCntAutoPtr<IShader> pVS;
-        {
-            ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
-            ShaderCI.EntryPoint = "main";
-            ShaderCI.Desc.Name = "Colors vertex shader";
-            ShaderCI.FilePath = "colors.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
-        }
 
-        RefCntAutoPtr<IShader> pCombinedPS;
-        {
-            ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
-            ShaderCI.EntryPoint = "main";
-            ShaderCI.Desc.Name = "Colors pixel shader";
-            ShaderCI.FilePath = "colors.psh";
-            m_pDevice->CreateShader(ShaderCI, &pCombinedPS);
+        ShaderCreateInfo ShaderCI;
+        ShaderCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
+        ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
+        ShaderCI.Desc.ShaderType = Type;
+        ShaderCI.EntryPoint = "main";
+        ShaderCI.Desc.Name = Name;
+        ShaderCI.FilePath = FilePath;
+
+        RefCntAutoPtr<IShader> pShader;
+        m_PipelineCache.create_shader(ShaderCI, &pShader);
+        if (!pShader) {
+            throw std::runtime_error(std::string("Failed to compile ") + FilePath + ".");
         }
+        return pShader;
+    }
 
-        std::array LayoutElems =
-        {
-            LayoutElement{0, 0, 3, VT_FLOAT32, False},
-            LayoutElement{1, 0, 3, VT_FLOAT32, False}
-        };
+    // The cube pipeline, with one SRB for the immediate context and one per recorder. Runs at
+    // startup and, on shader edits, on the hot reload thread, so it only touches what it returns.
+    cube_pipeline create_cube_pipeline() {
+        using namespace Diligent;
+        auto PSOCreateInfo = pipeline_create_info();
 
-        PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = LayoutElems.data();
-        PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = LayoutElems.size();
+        const auto pVS = create_shader(SHADER_TYPE_VERTEX, "Colors vertex shader", "colors.vsh");
+        const auto pCombinedPS = create_shader(SHADER_TYPE_PIXEL, "Colors pixel shader", "colors.psh");
 
+        PSOCreateInfo.PSODesc.Name = "Cube PSO";
         PSOCreateInfo.pVS = pVS;
         PSOCreateInfo.pPS = pCombinedPS;
 
-        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+        // Only Object comes from the frame ring; Frame and Lights stay static.
+        std::array CubeVars =
+        {
+            ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Object", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+        };
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pCubePSO);
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables = CubeVars.data();
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = CubeVars.size();
 
-        RefCntAutoPtr<IShader> pLightCubeVS;
-        {
-            ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
-            ShaderCI.Desc.Name = "Light Cube vertex shader";
-            ShaderCI.FilePath = "light_cube.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubeVS);
+        cube_pipeline Pipeline;
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &Pipeline.pso);
+        if (!Pipeline.pso) {
+            throw std::runtime_error("Failed to create the cube pipeline.");
         }
+        // Static, so every SRB below starts out bound to them.
+        Pipeline.pso->GetStaticVariableByName(SHADER_TYPE_PIXEL, "MaterialTable")->Set(m_pMaterialTable->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+        m_FrameConstants.bind(*Pipeline.pso, SHADER_TYPE_VERTEX, "Frame");
+        m_FrameConstants.bind(*Pipeline.pso, SHADER_TYPE_PIXEL, "Frame");
+        m_LightConstants.bind(*Pipeline.pso, SHADER_TYPE_PIXEL, "Lights");
+
+        const auto CreateSRB = [&](frame_ring_buffer& Ring, RefCntAutoPtr<IShaderResourceBinding>& SRB) {
+            Pipeline.pso->CreateShaderResourceBinding(&SRB, true);
+            Ring.bind<ObjectConstants>(*SRB, SHADER_TYPE_VERTEX, "Object");
+        };
 
-        RefCntAutoPtr<IShader> pLightCubePS;
-        {
-            ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
-            ShaderCI.Desc.Name = "Light Cube pixel shader";
-            ShaderCI.FilePath = "light_cube.psh";
-            m_pDevice->CreateShader(ShaderCI, &pLightCubePS);
+        CreateSRB(m_FrameRing, Pipeline.srb);
+        // Every recorder moves its SRB's buffer offsets per draw, so they can't share one.
+        Pipeline.recorder_srbs.resize(m_Recorders.size());
+        for (size_t i = 0; i < m_Recorders.size(); ++i) {
+            CreateSRB(m_Recorders[i].ring, Pipeline.recorder_srbs[i]);
         }
+        return Pipeline;
+    }
+
+    void create_light_cube_pipeline(Diligent::RefCntAutoPtr<Diligent::IPipelineState>& PSO, Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding>& SRB) {
+        using namespace Diligent;
+        auto PSOCreateInfo = pipeline_create_info();
+
+        std::array LightCubeVars =
+        {
+            ShaderResourceVariableDesc{SHADER_TYPE_VERTEX, "Object", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC}
+        };
+
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables = LightCubeVars.data();
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = LightCubeVars.size();
+
+        const auto pLightCubeVS = create_shader(SHADER_TYPE_VERTEX, "Light Cube vertex shader", "light_cube.vsh");
+        const auto pLightCubePS = create_shader(SHADER_TYPE_PIXEL, "Light Cube pixel shader", "light_cube.psh");
 
         PSOCreateInfo.PSODesc.Name = "Light Cube PSO";
         PSOCreateInfo.pVS = pLightCubeVS;
         PSOCreateInfo.pPS = pLightCubePS;
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pLightCubePSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &PSO);
+        if (!PSO) {
+            throw std::runtime_error("Failed to create the light cube pipeline.");
+        }
+        m_FrameConstants.bind(*PSO, SHADER_TYPE_VERTEX, "Frame");
 
+        PSO->CreateShaderResourceBinding(&SRB, true);
+        m_FrameRing.bind<ObjectConstants>(*SRB, SHADER_TYPE_VERTEX, "Object");
+    }
 
+    void create_pipeline_states() {
         create_uniform_buffers();
+        create_material_table();
 
+        use_cube_pipeline(create_cube_pipeline());
+        create_light_cube_pipeline(m_pLightCubePSO, m_pLightCubeSRB);
+    }
 
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
-        m_pLightCubePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
-
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Lights")->Set(m_PSLight);
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Materials")->Set(m_PSMaterial);
-        m_pCubePSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "Camera")->Set(m_PSCamera);
+    void use_cube_pipeline(cube_pipeline Pipeline) {
+        m_pCubePSO = std::move(Pipeline.pso);
+        m_pCubeSRB = std::move(Pipeline.srb);
+        for (size_t i = 0; i < m_Recorders.size(); ++i) {
+            m_Recorders[i].srb = std::move(Pipeline.recorder_srbs[i]);
+        }
+    }
 
-        m_pCubePSO->CreateShaderResourceBinding(&m_pCubeSRB, true);
-        m_pLightCubePSO->CreateShaderResourceBinding(&m_pLightCubeSRB, true);
+    // Rebuilt pipelines are swapped in between frames, while no recorder is running.
+    void watch_shaders() {
+        m_ShaderReload.watch({ "colors.vsh", "colors.psh" }, [this]() -> shader_hot_reload::swap_function {
+            auto New = std::make_shared<cube_pipeline>(create_cube_pipeline());
+            return [this, New]() {
+                use_cube_pipeline(std::move(*New));
+                std::cout << "Reloaded colors.psh\n";
+            };
+        });
+
+        m_ShaderReload.watch({ "light_cube.vsh", "light_cube.psh" }, [this]() -> shader_hot_reload::swap_function {
+            auto New = std::make_shared<std::pair<Diligent::RefCntAutoPtr<Diligent::IPipelineState>, Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding>>>();
+            create_light_cube_pipeline(New->first, New->second);
+            return [this, New]() {
+                m_pLightCubePSO = New->first;
+                m_pLightCubeSRB = New->second;
+                std::cout << "Reloaded light_cube.psh\n";
+            };
+        });
 
+        m_ShaderReload.start();
     }
 
     void create_uniform_buffers() {
-        using namespace Diligent;
-
-        BufferDesc CBDesc;
-        CBDesc.Usage = USAGE_DYNAMIC;
-        CBDesc.BindFlags = BIND_UNIFORM_BUFFER;
-        CBDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
-
-        CBDesc.Name = "VS constants CB";
-        CBDesc.Size = sizeof(Constants);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_VSConstants);
-
-        CBDesc.Name = "PS Light CB";
-        CBDesc.Size = sizeof(Light);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSLight);
+        m_FrameConstants.create(*m_pDevice, "Frame constants");
+        m_LightConstants.create(*m_pDevice, "Light constants");
+        m_FrameRing.create(*m_pDevice, 1 << 20, "Object constants ring");
+        for (auto& recorder : m_Recorders) {
+            recorder.ring.create(*m_pDevice, 256 << 10, "Recorder object constants ring");
+        }
+    }
 
-        CBDesc.Name = "PS Material CB";
-        CBDesc.Size = sizeof(Material);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSMaterial);
+    // Every material of the dictionary, uploaded once. Cubes pick theirs by index, so a draw
+    // uploads no material data however many materials there are.
+    void create_material_table() {
+        using namespace Diligent;
 
-        CBDesc.Name = "PS Camera CB";
-        CBDesc.Size = sizeof(Camera::CB);
-        m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PSCamera);
+        std::vector<Material> table;
+        table.reserve(MaterialsDictionary::materials.size());
+        for (const auto& entry : MaterialsDictionary::materials) {
+            table.push_back(entry.material);
+            table.back().shininess *= 128.0f;
+        }
 
+        BufferDesc TableDesc;
+        TableDesc.Name = "Material table";
+        TableDesc.Usage = USAGE_IMMUTABLE;
+        TableDesc.BindFlags = BIND_SHADER_RESOURCE;
+        TableDesc.Mode = BUFFER_MODE_STRUCTURED;
+        TableDesc.ElementByteStride = sizeof(Material);
+        TableDesc.Size = table.size() * sizeof(Material);
+        BufferData TableData;
+        TableData.pData = table.data();
+        TableData.DataSize = table.size() * sizeof(Material);
+
+        m_pDevice->CreateBuffer(TableDesc, &TableData, &m_pMaterialTable);
+        if (!m_pMaterialTable) {
+            throw std::runtime_error("Failed to create the material table.");
+        }
     }
 
     void create_cube_buffer() {
-
-        struct cube_vertex {
-            glm::vec3 pos;
-            glm::vec3 normal;
-        };
-
-        std::array vertices = {
-            //face front
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f,  0.0f, -1.0f)},
-            //face back                                                                  
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f,  0.0f,  1.0f)},
-            //face right
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f,  0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f, -0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f,  0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f,  0.5f), .normal = glm::vec3(-1.0f,  0.0f,  0.0f)},
-            //face left
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f, -0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f, -0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f, -0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f,  0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 1.0f,  0.0f,  0.0f)},
-            //face top                                                                   
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f,  0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f, -0.5f, -0.5f), .normal = glm::vec3( 0.0f, -1.0f,  0.0f)},
-            //face bottom                                                                
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3(  0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f,  0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)},
-                cube_vertex{.pos = glm::vec3( -0.5f,  0.5f, -0.5f), .normal = glm::vec3( 0.0f,  1.0f,  0.0f)}
-        };
-
-        using namespace Diligent;
-        BufferDesc VertBuffDesc;
-        VertBuffDesc.Name = "Cube vertex buffer";
-        VertBuffDesc.Usage = USAGE_IMMUTABLE;
-        VertBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
-        VertBuffDesc.Size = vertices.size() * sizeof(decltype(vertices)::value_type);
-        BufferData VBData;
-        VBData.pData = vertices.data();
-        VBData.DataSize = vertices.size() * sizeof(decltype(vertices)::value_type);
-        m_pDevice->CreateBuffer(VertBuffDesc, &VBData, &m_CubeVertexBuffer);
-
+        m_CubeMesh.create(m_pDevice);
     }
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options)
+        , m_Benchmark(Options) {
         init();
     }
 
     ~application() {
+        // A rebuild in flight uses the device and the rings below.
+        m_ShaderReload.stop();
         glfwTerminate();
     }
 
     void run() {
         create_pipeline_states();
+        m_PipelineCache.save();
         create_cube_buffer();
 
+        if (!m_Options.headless) {
+            watch_shaders();
+        }
+
         float delta_time = 0.0f;	// Time between current frame and last frame
         float last_frame = 0.0f; // Time of last frame
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
+            m_Benchmark.begin_frame(m_pImmediateContext);
 
-            float current_frame = glfwGetTime();
+            float current_frame = m_Loop.time();
             delta_time = current_frame - last_frame;
             last_frame = current_frame;
 
-            glfwPollEvents();
-            process_input(delta_time);
+            m_ShaderReload.apply();
+
+            if (!m_Options.headless) {
+                glfwPollEvents();
+                if (!m_Benchmark.enabled()) {
+                    process_input(delta_time);
+                }
+            }
+            if (m_Benchmark.enabled()) {
+                frame_benchmark::place_camera(camera, m_Loop.time());
+            }
 
             render();
         }
+
+        m_Benchmark.finish("Materials", m_Options, m_pImmediateContext);
     }
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+    frame_benchmark m_Benchmark;
+
+    GLFWwindow* window = nullptr;
     bool show_cursor = false;
     Camera camera;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
 
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_CubeVertexBuffer;
+    cube_mesh                                                 m_CubeMesh;
 
     Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pCubePSO;
     Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pCubeSRB;
 
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_VSConstants;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSLight;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSMaterial;
-    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_PSCamera;
+    constant_buffer<FrameConstants>                           m_FrameConstants;
+    constant_buffer<Light>                                    m_LightConstants;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_pMaterialTable;
+
+    frame_ring_buffer                                         m_FrameRing;
+    render_graph                                              m_Graph;
+    // Ring offsets of the object constants of the draws in the current batch.
+    std::vector<Diligent::Uint32>                             m_CubeDraws;
+
+    // A deferred context and what it records with. Dynamic buffers are mapped per context, so
+    // each one uploads its object constants through its own ring.
+    struct recorder {
+        Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         context;
+        frame_ring_buffer                                         ring;
+        Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> srb;
+        std::vector<Diligent::Uint32>                             draws;
+        Diligent::RefCntAutoPtr<Diligent::ICommandList>           commands;
+    };
+
+    // Fewer visible cubes than this per context aren't worth a command list.
+    static constexpr size_t min_cubes_per_recorder = 256;
+
+    thread_pool                                               m_WorkerPool;
+    std::vector<recorder>                                     m_Recorders;
+
+    std::vector<Diligent::Uint32>                             m_CubeMaterials;
+    transform_batch                                           m_CubeTransforms;
+    std::vector<ObjectConstants>                              m_CubeObjects;
+    aabb_culler                                               m_CubeBounds;
+    std::vector<Diligent::Uint32>                             m_VisibleCubes;
+    draw_list                                                 m_DrawList;
 
     Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pLightCubePSO;
     Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_pLightCubeSRB;
 
+    shader_hot_reload                                         m_ShaderReload;
+
     enum class render_mode {
         coral_cube,
-        many_cubes
+        many_cubes,
+        cube_grid
     };
 
     render_mode mode = render_mode::coral_cube;
 
+    // Pipeline ids of the draw list keys.
+    enum class draw_pipeline : Diligent::Uint32 {
+        cube,
+        light_cube
+    };
+
+    size_t cube_grid_size = 128;
+    bool parallel_recording = true;
+
     size_t single_cube_material_index = MaterialsDictionary::materials.size() - 1;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
@@ -0,0 +1,220 @@
+#define VULKAN_SUPPORTED
+#include "DiligentCore/Graphics/Archiver/interface/ArchiverFactory.h"
+#include "DiligentCore/Graphics/Archiver/interface/ArchiverFactoryLoader.h"
+#include "DiligentCore/Graphics/Archiver/interface/SerializationDevice.h"
+#include "DiligentCore/Graphics/Archiver/interface/SerializedShader.h"
+
+#include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
+
+#include "../Common/spirv_bytecode.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Compiles the shaders a sample lists in its shaders.txt to SPIR-V, ahead of time.
+//
+//   ShaderCompiler <sample directory>...
+//
+// Every line of shaders.txt names a stage, a source file and the macros of one permutation:
+//
+//   # stage  file         macros
+//   vs       colors.vsh
+//   vs       colors.vsh   INSTANCED=1
+//   ps       spot_light.psh
+//
+// The output goes to <sample directory>/spirv, where pipeline_cache::create_shader picks it up.
+// Shaders whose .spv is newer than the source and its includes are skipped, and any compile error
+// fails the build.
+struct shader_entry {
+    Diligent::SHADER_TYPE type;
+    std::string           file;
+    shader_macro_list     macros;
+    int                   line;
+};
+
+std::vector<shader_entry> read_manifest(const std::filesystem::path& Path) {
+    std::ifstream Manifest(Path);
+    if (!Manifest) {
+        throw std::runtime_error("Failed to open " + Path.string() + ".");
+    }
+
+    std::vector<shader_entry> Entries;
+    std::string Line;
+    for (int LineNumber = 1; std::getline(Manifest, Line); ++LineNumber) {
+        if (const auto Comment = Line.find('#'); Comment != std::string::npos) {
+            Line.erase(Comment);
+        }
+
+        std::istringstream Words(Line);
+        std::string Stage;
+        if (!(Words >> Stage)) {
+            continue;
+        }
+
+        shader_entry Entry;
+        Entry.line = LineNumber;
+        if (Stage == "vs")
+            Entry.type = Diligent::SHADER_TYPE_VERTEX;
+        else if (Stage == "ps")
+            Entry.type = Diligent::SHADER_TYPE_PIXEL;
+        else if (Stage == "cs")
+            Entry.type = Diligent::SHADER_TYPE_COMPUTE;
+        else
+            throw std::runtime_error(Path.string() + "(" + std::to_string(LineNumber) + "): unknown shader stage " + Stage + ".");
+
+        if (!(Words >> Entry.file)) {
+            throw std::runtime_error(Path.string() + "(" + std::to_string(LineNumber) + "): missing shader file.");
+        }
+
+        std::string Macro;
+        while (Words >> Macro) {
+            const auto Equals = Macro.find('=');
+            if (Equals == std::string::npos) {
+                Entry.macros.emplace_back(Macro, "1");
+            }
+            else {
+                Entry.macros.emplace_back(Macro.substr(0, Equals), Macro.substr(Equals + 1));
+            }
+        }
+
+        Entries.push_back(std::move(Entry));
+    }
+
+    return Entries;
+}
+
+class shader_compiler {
+public:
+    shader_compiler() {
+        using namespace Diligent;
+
+#if EXPLICITLY_LOAD_ARCHIVER_FACTORY_DLL
+        m_pFactory = LoadArchiverFactory();
+#else
+        m_pFactory = GetArchiverFactory();
+#endif
+        if (!m_pFactory) {
+            throw std::runtime_error("Failed to load the archiver factory.");
+        }
+
+        SerializationDeviceCreateInfo DeviceCI;
+        m_pFactory->CreateSerializationDevice(DeviceCI, &m_pDevice);
+        if (!m_pDevice) {
+            throw std::runtime_error("Failed to create the serialization device.");
+        }
+    }
+
+    // Returns the number of shaders that failed to compile.
+    int compile_directory(const std::filesystem::path& Directory) {
+        using namespace Diligent;
+
+        const auto SearchDirectory = Directory.string();
+        RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
+        m_pFactory->CreateDefaultShaderSourceStreamFactory(SearchDirectory.c_str(), &pShaderSourceFactory);
+
+        std::filesystem::create_directories(Directory / "spirv");
+
+        int Failures = 0;
+        for (const auto& Entry : read_manifest(Directory / "shaders.txt")) {
+            const auto Source = Directory / Entry.file;
+            const auto Output = spirv_path(Directory, Entry.file, Entry.macros);
+
+            std::error_code Error;
+            if (std::filesystem::last_write_time(Output, Error) >= shader_source_time(Source) && !Error) {
+                continue;
+            }
+
+            std::cout << Output.string() << std::endl;
+
+            std::vector<ShaderMacro> Macros;
+            for (const auto& [Name, Definition] : Entry.macros) {
+                Macros.push_back({ Name.c_str(), Definition.c_str() });
+            }
+
+            ShaderCreateInfo ShaderCI;
+            ShaderCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
+            ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
+            ShaderCI.Desc.ShaderType = Entry.type;
+            ShaderCI.Desc.Name = Entry.file.c_str();
+            ShaderCI.EntryPoint = "main";
+            ShaderCI.FilePath = Entry.file.c_str();
+            ShaderCI.Macros = { Macros.data(), static_cast<Uint32> (Macros.size()) };
+
+            const auto ByteCode = compile(ShaderCI);
+            if (ByteCode.empty()) {
+                // glslang has already logged the errors.
+                std::cerr << Source.string() << ": error: failed to compile (shaders.txt line " << Entry.line << ")" << std::endl;
+                std::filesystem::remove(Output, Error);
+                ++Failures;
+                continue;
+            }
+
+            std::ofstream File(Output, std::ios::binary | std::ios::trunc);
+            File.write(reinterpret_cast<const char*> (ByteCode.data()), ByteCode.size());
+        }
+
+        return Failures;
+    }
+
+private:
+    std::vector<Diligent::Uint8> compile(const Diligent::ShaderCreateInfo& ShaderCI) {
+        using namespace Diligent;
+
+        ShaderArchiveInfo ArchiveInfo;
+        ArchiveInfo.DeviceFlags = ARCHIVE_DEVICE_DATA_FLAG_VULKAN;
+
+        RefCntAutoPtr<IShader> pShader;
+        m_pDevice->CreateShader(ShaderCI, ArchiveInfo, &pShader);
+        RefCntAutoPtr<ISerializedShader> pSerializedShader{ pShader, IID_SerializedShader };
+        if (!pSerializedShader) {
+            return {};
+        }
+
+        auto* pVkShader = pSerializedShader->GetDeviceShader(RENDER_DEVICE_TYPE_VULKAN);
+        if (pVkShader == nullptr) {
+            return {};
+        }
+
+        const void* pByteCode = nullptr;
+        Uint64 ByteCodeSize = 0;
+        pVkShader->GetBytecode(&pByteCode, ByteCodeSize);
+
+        const auto* pBytes = static_cast<const Uint8*> (pByteCode);
+        return std::vector<Uint8>(pBytes, pBytes + ByteCodeSize);
+    }
+
+    Diligent::IArchiverFactory*                            m_pFactory = nullptr;
+    Diligent::RefCntAutoPtr<Diligent::ISerializationDevice> m_pDevice;
+};
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: ShaderCompiler <sample directory>..." << std::endl;
+        return -1;
+    }
+
+    try {
+        shader_compiler Compiler;
+
+        int Failures = 0;
+        for (int i = 1; i < argc; ++i) {
+            Failures += Compiler.compile_directory(argv[i]);
+        }
+
+        if (Failures > 0) {
+            std::cerr << Failures << " shader(s) failed to compile." << std::endl;
+            return -1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -1,10 +1,6 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -22,7 +18,7 @@ class application {
 
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
-        app->m_pSwapChain->Resize(width, height);
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -50,7 +46,7 @@ class application {
         }
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        window = glfwCreateWindow(800, 600, "LearnDiligent", nullptr, nullptr);
+        window = glfwCreateWindow(static_cast<int> (m_Options.width), static_cast<int> (m_Options.height), "LearnDiligent", nullptr, nullptr);
 
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, &application::framebuffer_size_callback);
@@ -68,24 +64,30 @@ class application {
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
 
-        auto handle = glfwGetWin32Window(window);
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
+        }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
         }
 
+        m_PipelineCache.create(m_pDevice, "Shaders");
+
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
 
         m_pImmediateContext->SetRenderTargets(1, &pRTV, nullptr, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
@@ -99,7 +101,7 @@ class application {
             {
                 Diligent::MapHelper<glm::vec4> CBConstants(m_pImmediateContext, m_VSConstants, Diligent::MAP_WRITE, Diligent::MAP_FLAG_DISCARD);
 
-                float timeValue = glfwGetTime();
+                float timeValue = m_Loop.time();
                 float greenValue = (sin(timeValue) / 2.0f) + 0.5f;
                 *CBConstants = glm::vec4(0.0f, greenValue, 0.0f, 1.0f);
             }
@@ -127,7 +129,7 @@ class application {
        
 
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
     void create_pipeline_state() {
@@ -138,7 +140,7 @@ class application {
         PSOCreateInfo.PSODesc.Name = "Triangle PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_NONE;
 
@@ -155,7 +157,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Triangle vertex shader";
             ShaderCI.FilePath = "triangle.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+            m_PipelineCache.create_shader(ShaderCI, &pVS);
 
             BufferDesc CBDesc;
             CBDesc.Name = "VS constants CB";
@@ -173,7 +175,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Triangle pixel shader";
             ShaderCI.FilePath = "triangle.psh";
-            m_pDevice->CreateShader(ShaderCI, &pPS);
+            m_PipelineCache.create_shader(ShaderCI, &pPS);
         }
 
         std::array LayoutElems =
@@ -191,7 +193,7 @@ class application {
         // Define variable type that will be used by default
         PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pPSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pPSO);
 
         m_pPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
 
@@ -205,7 +207,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Triangle colored vertex shader";
             ShaderCI.FilePath = "triangle_colored_vertex.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pColoredVertexVS);
+            m_PipelineCache.create_shader(ShaderCI, &pColoredVertexVS);
         }
 
         PSOCreateInfo.pVS = pColoredVertexVS;
@@ -220,7 +222,7 @@ class application {
         PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = ColoredVertexLayoutElems.data();
         PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = ColoredVertexLayoutElems.size();
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pColoredVertexPSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pColoredVertexPSO);
     }
 
     void create_triangle_buffer() {
@@ -262,7 +264,9 @@ class application {
     }
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options) {
         init();
     }
 
@@ -273,26 +277,33 @@ public:
     void run() {
 
         create_pipeline_state();
+        m_PipelineCache.save();
         create_triangle_buffer();
         create_triangle_colored_vertex_buffer();
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
 
             render();
 
-            glfwPollEvents();
+            if (!m_Options.headless) {
+                glfwPollEvents();
+            }
         }
     }
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+
+    GLFWwindow* window = nullptr;
     bool MonocolorMode = true;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
                                                               
     Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pPSO;
     Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_TriangleVertexBuffer;
@@ -303,10 +314,10 @@ private:
     Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_TriangleColoredVertexBuffer;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
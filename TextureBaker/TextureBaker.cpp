@@ -0,0 +1,346 @@
+#include "../Common/baked_texture.hpp"
+
+#include "DiligentTools/TextureLoader/interface/Image.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Bakes every .png and .jpg in a directory into a BCn-compressed, fully mipmapped DDS file in
+// its baked subfolder, where load_texture picks it up.
+//
+//   TextureBaker <assets directory>
+//
+// Images are sRGB color unless is_linear_texture says they hold data. Color is box filtered in
+// linear light and written as BCn_UNORM_SRGB; data is filtered as stored and written as BCn_UNORM.
+// Opaque images become BC1, images with any transparency BC3. Outputs that are up to date and
+// baked for the right color space are skipped.
+struct rgba {
+    std::uint8_t r, g, b, a;
+};
+
+struct image {
+    Diligent::Uint32  width = 0;
+    Diligent::Uint32  height = 0;
+    std::vector<rgba> pixels;
+
+    const rgba& at(Diligent::Uint32 x, Diligent::Uint32 y) const {
+        return pixels[size_t{ std::min(y, height - 1) } * width + std::min(x, width - 1)];
+    }
+};
+
+image decode_image(const std::filesystem::path& Path) {
+    using namespace Diligent;
+
+    RefCntAutoPtr<Image> pImage;
+    CreateImageFromFile(Path.string().c_str(), &pImage);
+    if (!pImage) {
+        throw std::runtime_error("Failed to decode " + Path.string() + ".");
+    }
+
+    const auto& Desc = pImage->GetDesc();
+    if (Desc.ComponentType != VT_UINT8) {
+        throw std::runtime_error(Path.string() + " is not an 8-bit image.");
+    }
+
+    image Result;
+    Result.width = Desc.Width;
+    Result.height = Desc.Height;
+    Result.pixels.resize(size_t{ Desc.Width } * Desc.Height);
+
+    const auto* pData = static_cast<const std::uint8_t*> (pImage->GetData()->GetConstDataPtr());
+    for (Uint32 y = 0; y < Desc.Height; ++y) {
+        const auto* pRow = pData + size_t{ y } * Desc.RowStride;
+        for (Uint32 x = 0; x < Desc.Width; ++x) {
+            const auto* pTexel = pRow + size_t{ x } * Desc.NumComponents;
+            auto& Pixel = Result.pixels[size_t{ y } * Desc.Width + x];
+            switch (Desc.NumComponents) {
+                case 1: Pixel = { pTexel[0], pTexel[0], pTexel[0], 255 }; break;
+                case 2: Pixel = { pTexel[0], pTexel[0], pTexel[0], pTexel[1] }; break;
+                case 3: Pixel = { pTexel[0], pTexel[1], pTexel[2], 255 }; break;
+                default: Pixel = { pTexel[0], pTexel[1], pTexel[2], pTexel[3] }; break;
+            }
+        }
+    }
+
+    return Result;
+}
+
+float srgb_to_linear(std::uint8_t Value) {
+    const float c = Value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+std::uint8_t linear_to_srgb(float Value) {
+    const float c = Value <= 0.0031308f ? Value * 12.92f : 1.055f * std::pow(Value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<std::uint8_t> (std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Color channels of sRGB images are averaged in linear light, those of linear images as they are.
+image downsample(const image& Source, bool SRGB) {
+    image Result;
+    Result.width = std::max(1u, Source.width / 2);
+    Result.height = std::max(1u, Source.height / 2);
+    Result.pixels.resize(size_t{ Result.width } * Result.height);
+
+    for (Diligent::Uint32 y = 0; y < Result.height; ++y) {
+        for (Diligent::Uint32 x = 0; x < Result.width; ++x) {
+            const std::array Taps = { Source.at(2 * x, 2 * y), Source.at(2 * x + 1, 2 * y), Source.at(2 * x, 2 * y + 1), Source.at(2 * x + 1, 2 * y + 1) };
+
+            float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+            for (const auto& Tap : Taps) {
+                r += SRGB ? srgb_to_linear(Tap.r) : Tap.r;
+                g += SRGB ? srgb_to_linear(Tap.g) : Tap.g;
+                b += SRGB ? srgb_to_linear(Tap.b) : Tap.b;
+                a += Tap.a;
+            }
+
+            const auto Average = [&](float Sum) {
+                return SRGB ? linear_to_srgb(Sum / 4) : static_cast<std::uint8_t> (Sum / 4 + 0.5f);
+            };
+            Result.pixels[size_t{ y } * Result.width + x] = { Average(r), Average(g), Average(b), static_cast<std::uint8_t> (a / 4 + 0.5f) };
+        }
+    }
+
+    return Result;
+}
+
+std::uint16_t pack_565(const std::array<float, 3>& Color) {
+    const auto r = static_cast<std::uint16_t> (std::clamp(Color[0], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    const auto g = static_cast<std::uint16_t> (std::clamp(Color[1], 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+    const auto b = static_cast<std::uint16_t> (std::clamp(Color[2], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    return static_cast<std::uint16_t> (r << 11 | g << 5 | b);
+}
+
+std::array<float, 3> unpack_565(std::uint16_t Color) {
+    return { ((Color >> 11) & 31) * 255.0f / 31.0f, ((Color >> 5) & 63) * 255.0f / 63.0f, (Color & 31) * 255.0f / 31.0f };
+}
+
+// Four-color BC1 block. Endpoints are the extremes of the block's colors along their principal
+// axis, which keeps gradients that don't follow the RGB diagonals.
+void encode_bc1(const std::array<rgba, 16>& Block, std::uint8_t* pOut) {
+    std::array<float, 3> Mean = {};
+    for (const auto& Pixel : Block) {
+        Mean[0] += Pixel.r / 16.0f;
+        Mean[1] += Pixel.g / 16.0f;
+        Mean[2] += Pixel.b / 16.0f;
+    }
+
+    float Covariance[6] = {};
+    for (const auto& Pixel : Block) {
+        const float r = Pixel.r - Mean[0], g = Pixel.g - Mean[1], b = Pixel.b - Mean[2];
+        Covariance[0] += r * r; Covariance[1] += r * g; Covariance[2] += r * b;
+        Covariance[3] += g * g; Covariance[4] += g * b; Covariance[5] += b * b;
+    }
+
+    std::array<float, 3> Axis = { 1.0f, 1.0f, 1.0f };
+    for (int i = 0; i < 8; ++i) {
+        const std::array<float, 3> Next = {
+            Covariance[0] * Axis[0] + Covariance[1] * Axis[1] + Covariance[2] * Axis[2],
+            Covariance[1] * Axis[0] + Covariance[3] * Axis[1] + Covariance[4] * Axis[2],
+            Covariance[2] * Axis[0] + Covariance[4] * Axis[1] + Covariance[5] * Axis[2]
+        };
+        const float Length = std::max({ std::abs(Next[0]), std::abs(Next[1]), std::abs(Next[2]) });
+        if (Length < 1e-6f) {
+            break;
+        }
+        Axis = { Next[0] / Length, Next[1] / Length, Next[2] / Length };
+    }
+
+    float MinT = 0.0f, MaxT = 0.0f;
+    for (const auto& Pixel : Block) {
+        const float t = (Pixel.r - Mean[0]) * Axis[0] + (Pixel.g - Mean[1]) * Axis[1] + (Pixel.b - Mean[2]) * Axis[2];
+        MinT = std::min(MinT, t);
+        MaxT = std::max(MaxT, t);
+    }
+
+    const float AxisLength2 = Axis[0] * Axis[0] + Axis[1] * Axis[1] + Axis[2] * Axis[2];
+    std::array<float, 3> Low, High;
+    for (int c = 0; c < 3; ++c) {
+        Low[c] = Mean[c] + Axis[c] * MinT / AxisLength2;
+        High[c] = Mean[c] + Axis[c] * MaxT / AxisLength2;
+    }
+
+    auto Color0 = pack_565(High);
+    auto Color1 = pack_565(Low);
+    if (Color0 < Color1) {
+        std::swap(Color0, Color1);
+    }
+
+    std::uint32_t Indices = 0;
+    if (Color0 != Color1) {
+        const auto c0 = unpack_565(Color0), c1 = unpack_565(Color1);
+        std::array<std::array<float, 3>, 4> Palette;
+        for (int c = 0; c < 3; ++c) {
+            Palette[0][c] = c0[c];
+            Palette[1][c] = c1[c];
+            Palette[2][c] = (2.0f * c0[c] + c1[c]) / 3.0f;
+            Palette[3][c] = (c0[c] + 2.0f * c1[c]) / 3.0f;
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            std::uint32_t Best = 0;
+            float BestError = 1e30f;
+            for (std::uint32_t p = 0; p < 4; ++p) {
+                const float dr = Block[i].r - Palette[p][0], dg = Block[i].g - Palette[p][1], db = Block[i].b - Palette[p][2];
+                const float Error = dr * dr + dg * dg + db * db;
+                if (Error < BestError) {
+                    BestError = Error;
+                    Best = p;
+                }
+            }
+            Indices |= Best << (2 * i);
+        }
+    }
+
+    std::memcpy(pOut, &Color0, 2);
+    std::memcpy(pOut + 2, &Color1, 2);
+    std::memcpy(pOut + 4, &Indices, 4);
+}
+
+// Eight-value BC3/BC4 alpha block between the block's minimum and maximum alpha.
+void encode_bc4(const std::array<rgba, 16>& Block, std::uint8_t* pOut) {
+    std::uint8_t Min = 255, Max = 0;
+    for (const auto& Pixel : Block) {
+        Min = std::min(Min, Pixel.a);
+        Max = std::max(Max, Pixel.a);
+    }
+
+    std::uint64_t Bits = std::uint64_t{ Max } | std::uint64_t{ Min } << 8;
+    if (Max != Min) {
+        std::array<float, 8> Palette = { float(Max), float(Min) };
+        for (int p = 1; p < 7; ++p) {
+            Palette[p + 1] = ((7 - p) * Max + p * Min) / 7.0f;
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            std::uint64_t Best = 0;
+            float BestError = 1e30f;
+            for (std::uint64_t p = 0; p < 8; ++p) {
+                const float Error = std::abs(Block[i].a - Palette[p]);
+                if (Error < BestError) {
+                    BestError = Error;
+                    Best = p;
+                }
+            }
+            Bits |= Best << (16 + 3 * i);
+        }
+    }
+
+    std::memcpy(pOut, &Bits, 8);
+}
+
+std::vector<std::uint8_t> compress(const image& Mip, const dds::format_info& Format) {
+    const bool HasAlpha = Format.block_bytes == 16;
+
+    std::vector<std::uint8_t> Blocks(size_t{ dds::row_pitch(Format, Mip.width) } * dds::row_count(Format, Mip.height));
+    auto* pOut = Blocks.data();
+    for (Diligent::Uint32 by = 0; by < Mip.height; by += 4) {
+        for (Diligent::Uint32 bx = 0; bx < Mip.width; bx += 4) {
+            std::array<rgba, 16> Block;
+            for (Diligent::Uint32 i = 0; i < 16; ++i) {
+                Block[i] = Mip.at(bx + i % 4, by + i / 4);
+            }
+
+            if (HasAlpha) {
+                encode_bc4(Block, pOut);
+                pOut += 8;
+            }
+            encode_bc1(Block, pOut);
+            pOut += 8;
+        }
+    }
+
+    return Blocks;
+}
+
+// The color space an existing output was baked for, or none when it can't be read.
+std::optional<bool> baked_srgb(const std::filesystem::path& Output) {
+    std::ifstream File(Output, std::ios::binary);
+    File.seekg(sizeof(dds::magic) + sizeof(dds::header));
+
+    dds::header_dx10 HeaderDX10;
+    if (!File.read(reinterpret_cast<char*> (&HeaderDX10), sizeof(HeaderDX10))) {
+        return std::nullopt;
+    }
+    const auto* pFormat = dds::find_format(HeaderDX10.dxgi_format);
+    return pFormat != nullptr ? std::optional<bool>(pFormat->srgb) : std::nullopt;
+}
+
+void bake(const std::filesystem::path& Source, const std::filesystem::path& Output, bool SRGB) {
+    using namespace Diligent;
+
+    auto Mip = decode_image(Source);
+
+    const bool Opaque = std::all_of(Mip.pixels.begin(), Mip.pixels.end(), [](const rgba& Pixel) { return Pixel.a == 255; });
+    const auto& Format = *dds::find_format(Opaque ? (SRGB ? TEX_FORMAT_BC1_UNORM_SRGB : TEX_FORMAT_BC1_UNORM)
+                                                  : (SRGB ? TEX_FORMAT_BC3_UNORM_SRGB : TEX_FORMAT_BC3_UNORM));
+
+    dds::header Header;
+    Header.width = Mip.width;
+    Header.height = Mip.height;
+    Header.linear_size = dds::row_pitch(Format, Mip.width) * dds::row_count(Format, Mip.height);
+    Header.mip_map_count = 1 + static_cast<Diligent::Uint32> (std::log2(std::max(Mip.width, Mip.height)));
+
+    dds::header_dx10 HeaderDX10;
+    HeaderDX10.dxgi_format = Format.dxgi_format;
+
+    std::filesystem::create_directories(Output.parent_path());
+    std::ofstream File(Output, std::ios::binary | std::ios::trunc);
+    File.write(reinterpret_cast<const char*> (&dds::magic), sizeof(dds::magic));
+    File.write(reinterpret_cast<const char*> (&Header), sizeof(Header));
+    File.write(reinterpret_cast<const char*> (&HeaderDX10), sizeof(HeaderDX10));
+
+    for (Diligent::Uint32 Level = 0; Level < Header.mip_map_count; ++Level) {
+        if (Level > 0) {
+            Mip = downsample(Mip, SRGB);
+        }
+        const auto Blocks = compress(Mip, Format);
+        File.write(reinterpret_cast<const char*> (Blocks.data()), Blocks.size());
+    }
+
+    if (!File) {
+        throw std::runtime_error("Failed to write " + Output.string() + ".");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "Usage: TextureBaker <assets directory>" << std::endl;
+        return -1;
+    }
+
+    try {
+        for (const auto& Entry : std::filesystem::directory_iterator(argv[1])) {
+            const auto Extension = Entry.path().extension();
+            if (!Entry.is_regular_file() || (Extension != ".png" && Extension != ".jpg")) {
+                continue;
+            }
+
+            const auto Output = baked_texture_path(Entry.path());
+            const bool SRGB = !is_linear_texture(Entry.path());
+            std::error_code Error;
+            if (std::filesystem::last_write_time(Output, Error) >= Entry.last_write_time() && !Error && baked_srgb(Output) == SRGB) {
+                continue;
+            }
+
+            std::cout << Output.string() << (SRGB ? "" : " (linear)") << std::endl;
+            bake(Entry.path(), Output, SRGB);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
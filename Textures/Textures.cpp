@@ -1,10 +1,7 @@
-#include "GLFW/glfw3.h"
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include "GLFW/glfw3native.h"
+#include "../Common/headless.hpp"
+#include "../Common/pipeline_cache.hpp"
+#include "../Common/baked_texture.hpp"
 
-#define PLATFORM_WIN32 1
-#define VULKAN_SUPPORTED
-#include "DiligentCore/Graphics/GraphicsEngineVulkan/interface/EngineFactoryVk.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/RenderDevice.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/DeviceContext.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
@@ -24,7 +21,7 @@ class application {
 
     static void  framebuffer_size_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<application*> (glfwGetWindowUserPointer(window));
-        app->m_pSwapChain->Resize(width, height);
+        app->m_RenderTarget.resize(width, height);
     }
 
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -61,7 +58,7 @@ class application {
         }
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        window = glfwCreateWindow(800, 600, "LearnDiligent", nullptr, nullptr);
+        window = glfwCreateWindow(static_cast<int> (m_Options.width), static_cast<int> (m_Options.height), "LearnDiligent", nullptr, nullptr);
 
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, &application::framebuffer_size_callback);
@@ -80,24 +77,30 @@ class application {
 
         vk_factory->CreateDeviceAndContextsVk(engine_ci, &m_pDevice, &m_pImmediateContext);
 
-        auto handle = glfwGetWin32Window(window);
+        SCDesc.Width = m_Options.width;
+        SCDesc.Height = m_Options.height;
 
-        if (!m_pSwapChain && handle != nullptr)
-        {
-            Win32NativeWindow Window{ handle };
-            vk_factory->CreateSwapChainVk(m_pDevice, m_pImmediateContext, SCDesc, Window, &m_pSwapChain);
+        if (m_Options.headless) {
+            m_RenderTarget.create_offscreen(m_pDevice, m_pImmediateContext, SCDesc, m_Options);
+        }
+        else {
+            m_RenderTarget.create_swap_chain(*vk_factory, m_pDevice, m_pImmediateContext, SCDesc, native_window(window), m_Options);
         }
 
+        m_PipelineCache.create(m_pDevice, "Textures");
+
         m_pEngineFactory = vk_factory;
     }
 
     void init() {
-        initialize_glfw();
+        if (!m_Options.headless) {
+            initialize_glfw();
+        }
         initialize_diligent_engine();
     }
 
     void render() {
-        auto pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
+        auto pRTV = m_RenderTarget.back_buffer_rtv();
 
         m_pImmediateContext->SetRenderTargets(1, &pRTV, nullptr, Diligent::RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
@@ -187,7 +190,7 @@ class application {
         }
 
         m_pImmediateContext->Flush();
-        m_pSwapChain->Present();
+        m_RenderTarget.present();
     }
 
     void create_pipeline_state() {
@@ -198,7 +201,7 @@ class application {
         PSOCreateInfo.PSODesc.Name = "Texture PSO";
         PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
         PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
+        PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_RenderTarget.desc().ColorBufferFormat;
         PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_NONE;
 
@@ -215,7 +218,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Texture vertex shader";
             ShaderCI.FilePath = "texture.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pVS);
+            m_PipelineCache.create_shader(ShaderCI, &pVS);
         }
 
         // Create a pixel shader
@@ -225,7 +228,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Texture pixel shader";
             ShaderCI.FilePath = "texture.psh";
-            m_pDevice->CreateShader(ShaderCI, &pPS);
+            m_PipelineCache.create_shader(ShaderCI, &pPS);
         }
 
         std::array LayoutElems =
@@ -265,7 +268,7 @@ class application {
         PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers = ImtblSamplers.data();
         PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = ImtblSamplers.size();
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pPSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pPSO);
 
         m_pPSO->CreateShaderResourceBinding(&m_pSRB, true);
         m_pPSO->CreateShaderResourceBinding(&m_pContainerSRB, true);
@@ -277,7 +280,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Rainbow Texture vertex shader";
             ShaderCI.FilePath = "rainbow_texture.vsh";
-            m_pDevice->CreateShader(ShaderCI, &pRainbowVS);
+            m_PipelineCache.create_shader(ShaderCI, &pRainbowVS);
         }
 
         RefCntAutoPtr<IShader> pRainbowPS;
@@ -286,7 +289,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Rainbow Texture pixel shader";
             ShaderCI.FilePath = "rainbow_texture.psh";
-            m_pDevice->CreateShader(ShaderCI, &pRainbowPS);
+            m_PipelineCache.create_shader(ShaderCI, &pRainbowPS);
         }
 
         std::array RainbowLayoutElems =
@@ -302,7 +305,7 @@ class application {
         PSOCreateInfo.pVS = pRainbowVS;
         PSOCreateInfo.pPS = pRainbowPS;
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pRainbowPSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pRainbowPSO);
         m_pRainbowPSO->CreateShaderResourceBinding(&m_pRainbowSRB, true);
         //CombinedPSO
 
@@ -312,7 +315,7 @@ class application {
             ShaderCI.EntryPoint = "main";
             ShaderCI.Desc.Name = "Combined Texture pixel shader";
             ShaderCI.FilePath = "combined_texture.psh";
-            m_pDevice->CreateShader(ShaderCI, &pCombinedPS);
+            m_PipelineCache.create_shader(ShaderCI, &pCombinedPS);
         }
 
         PSOCreateInfo.pVS = pVS;
@@ -338,7 +341,7 @@ class application {
         PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers = CombinedImtblSamplers.data();
         PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = CombinedImtblSamplers.size();
 
-        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pCombinedPSO);
+        m_PipelineCache.create_graphics_pipeline_state(PSOCreateInfo, &m_pCombinedPSO);
         m_pCombinedPSO->CreateShaderResourceBinding(&m_pCombinedSRB, true);
     }
 
@@ -434,7 +437,7 @@ class application {
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB = true;
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\wall.jpg)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("wall.jpg"), loadInfo, m_pDevice, &Tex);
         // Get shader resource view from the texture
         m_WallTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -448,7 +451,7 @@ class application {
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB = true;
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\container.jpg)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("container.jpg"), loadInfo, m_pDevice, &Tex);
         // Get shader resource view from the texture
         m_ContainerTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -465,7 +468,7 @@ class application {
         loadInfo.IsSRGB = true;
 
         RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(R"(..\assets\awesomeface.png)", loadInfo, m_pDevice, &Tex);
+        load_texture(asset_path("awesomeface.png"), loadInfo, m_pDevice, &Tex);
         // Get shader resource view from the texture
         m_FaceTextureSRV = Tex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
 
@@ -481,7 +484,9 @@ class application {
 
 public:
 
-    application() {
+    explicit application(const launch_options& Options)
+        : m_Options(Options)
+        , m_Loop(Options) {
         init();
     }
 
@@ -492,26 +497,33 @@ public:
     void run() {
 
         create_pipeline_state();
+        m_PipelineCache.save();
         create_triangle_buffer();
         create_quad_buffers();
         load_textures();
 
-        while (!glfwWindowShouldClose(window)) {
+        while (m_Loop.begin_frame(window)) {
 
             render();
 
-            glfwPollEvents();
+            if (!m_Options.headless) {
+                glfwPollEvents();
+            }
         }
     }
 
 private:
 
-    GLFWwindow* window;
+    launch_options m_Options;
+    frame_loop m_Loop;
+
+    GLFWwindow* window = nullptr;
 
     Diligent::RefCntAutoPtr<Diligent::IEngineFactory>         m_pEngineFactory;
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>          m_pDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>         m_pImmediateContext;
-    Diligent::RefCntAutoPtr<Diligent::ISwapChain>             m_pSwapChain;
+    render_target                                             m_RenderTarget;
+    pipeline_cache                                            m_PipelineCache;
 
     Diligent::RefCntAutoPtr<Diligent::IPipelineState>         m_pPSO;
     Diligent::RefCntAutoPtr<Diligent::IBuffer>                m_TriangleVertexBuffer;
@@ -542,10 +554,10 @@ private:
     transform_mode mode = transform_mode::textured_triangle;
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
-        application app;
+        application app(launch_options::parse(argc, argv));
 
         app.run();
     }
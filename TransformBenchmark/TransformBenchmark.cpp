@@ -0,0 +1,119 @@
+#include "../Common/transform_batch.hpp"
+
+#include "glm/glm.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times the batched transform kernel (Common/transform_batch.hpp) against the per-object glm path
+// the samples used before it: translate * rotate * scale, then a general inverse for the normal
+// matrix, both transposed for the shaders.
+//
+//   TransformBenchmark [object count] [repetitions]
+//
+// Both paths write into the same InstanceData layout the instanced samples upload. The best of
+// the repetitions is reported per path, along with the largest difference between their outputs.
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::mat4 inverse_transpose_model;
+};
+
+struct object_transform {
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+template <typename Function>
+double best_ns_per_object(size_t ObjectCount, int Repetitions, Function&& Body) {
+    double Best = std::numeric_limits<double>::max();
+    for (int i = 0; i < Repetitions; ++i) {
+        const auto Start = std::chrono::steady_clock::now();
+        Body();
+        const std::chrono::duration<double, std::nano> Elapsed = std::chrono::steady_clock::now() - Start;
+        Best = std::min(Best, Elapsed.count() / static_cast<double> (ObjectCount));
+    }
+    return Best;
+}
+
+float max_difference(const std::vector<InstanceData>& A, const std::vector<InstanceData>& B) {
+    float Difference = 0.0f;
+    for (size_t i = 0; i < A.size(); ++i) {
+        for (int Column = 0; Column < 4; ++Column) {
+            for (int Row = 0; Row < 4; ++Row) {
+                Difference = std::max(Difference, std::abs(A[i].model[Column][Row] - B[i].model[Column][Row]));
+                // Only the upper 3x3 of the normal matrix reaches the shaders.
+                if (Column < 3 && Row < 3) {
+                    Difference = std::max(Difference, std::abs(A[i].inverse_transpose_model[Column][Row] - B[i].inverse_transpose_model[Column][Row]));
+                }
+            }
+        }
+    }
+    return Difference;
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        const size_t ObjectCount = argc > 1 ? std::stoul(argv[1]) : 100000;
+        const int Repetitions = argc > 2 ? std::stoi(argv[2]) : 20;
+
+        std::mt19937 Random(42);
+        std::uniform_real_distribution<float> Position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> Angle(0.0f, 6.2831853f);
+        std::uniform_real_distribution<float> Axis(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> Scale(0.25f, 4.0f);
+
+        std::vector<object_transform> Objects(ObjectCount);
+        for (auto& Object : Objects) {
+            Object.position = glm::vec3(Position(Random), Position(Random), Position(Random));
+            Object.rotation = glm::angleAxis(Angle(Random), glm::normalize(glm::vec3(Axis(Random), Axis(Random), Axis(Random)) + glm::vec3(0.0f, 0.0f, 1e-3f)));
+            Object.scale = glm::vec3(Scale(Random), Scale(Random), Scale(Random));
+        }
+
+        transform_batch Batch;
+        Batch.reserve(ObjectCount);
+        for (const auto& Object : Objects) {
+            Batch.add(Object.position, Object.rotation, Object.scale);
+        }
+
+        std::vector<InstanceData> Reference(ObjectCount);
+        const double GlmTime = best_ns_per_object(ObjectCount, Repetitions, [&]() {
+            for (size_t i = 0; i < ObjectCount; ++i) {
+                const auto& Object = Objects[i];
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), Object.position);
+                model = model * glm::mat4_cast(Object.rotation);
+                model = glm::scale(model, Object.scale);
+                Reference[i].model = glm::transpose(model);
+                Reference[i].inverse_transpose_model = glm::transpose(glm::transpose(glm::inverse(model)));
+            }
+        });
+
+        std::vector<InstanceData> Batched(ObjectCount);
+        const double BatchTime = best_ns_per_object(ObjectCount, Repetitions, [&]() {
+            Batch.write_matrices(0, ObjectCount, Batched.data(), sizeof(InstanceData),
+                offsetof(InstanceData, model), offsetof(InstanceData, inverse_transpose_model));
+        });
+
+        std::cout << ObjectCount << " objects, best of " << Repetitions << " runs\n"
+                  << "  glm per object:   " << GlmTime << " ns/object\n"
+                  << "  transform_batch:  " << BatchTime << " ns/object (" << transform_batch::lane_count << " lanes)\n"
+                  << "  speedup:          " << GlmTime / BatchTime << "x\n"
+                  << "  max difference:   " << max_difference(Reference, Batched) << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}